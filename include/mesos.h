@@ -11,6 +11,8 @@
 // compiler that doesn't suck.
 
 
+// If both cpus and mem are 0 (as an initializer that leaves them out
+// makes them), they are taken from the "cpus" and "mem" params instead.
 struct mesos_task_desc {
   task_id tid;
   slave_id sid;
@@ -18,6 +20,8 @@ struct mesos_task_desc {
   const char *params;
   const void *arg;
   size_t arg_len;
+  int32_t cpus;
+  int64_t mem;
 };
 
 struct mesos_task_status {
@@ -31,6 +35,8 @@ struct mesos_slot {
   slave_id sid;
   const char *host;
   const char *params;
+  int32_t cpus;
+  int64_t mem;
 };
 
 struct mesos_framework_message {
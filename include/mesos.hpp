@@ -31,27 +31,52 @@ struct bytes
 };
 
 
+/**
+ * A task to launch on a slave. The resources it needs go in 'cpus' and
+ * 'mem'; 'params' is left for anything else the framework wants to pass
+ * to its executor. For compatibility, a resource that is left at -1 is
+ * read from the "cpus" or "mem" entry of 'params' instead (once, by the
+ * scheduler driver, before the task is sent to the master). Resources
+ * other than CPUs and memory, such as "disk" (in MB) and "net" (in
+ * Mbit/s), are given in 'params'.
+ */
 struct TaskDescription
 {
-  TaskDescription() {}
+  TaskDescription() : cpus(-1), mem(-1) {}
+
+  TaskDescription(TaskID _taskId, SlaveID _slaveId, const std::string& _name,
+                  int32_t _cpus, int64_t _mem,
+                  const std::map<std::string, std::string>& _params,
+                  const bytes& _data)
+    : taskId(_taskId), slaveId(_slaveId), name(_name), cpus(_cpus),
+      mem(_mem), params(_params), data(_data) {}
+
+  TaskDescription(TaskID _taskId, SlaveID _slaveId, const std::string& _name,
+                  int32_t _cpus, int64_t _mem, const bytes& _data)
+    : taskId(_taskId), slaveId(_slaveId), name(_name), cpus(_cpus),
+      mem(_mem), data(_data) {}
 
   TaskDescription(TaskID _taskId, SlaveID _slaveId, const std::string& _name,
                   const std::map<std::string, std::string>& _params,
                   const bytes& _data)
-    : taskId(_taskId), slaveId(_slaveId), name(_name),
+    : taskId(_taskId), slaveId(_slaveId), name(_name), cpus(-1), mem(-1),
       params(_params), data(_data) {}
 
   TaskDescription(TaskID _taskId, SlaveID _slaveId, const std::string& _name,
                   const std::map<std::string, std::string>& _params)
-    : taskId(_taskId), slaveId(_slaveId), name(_name), params(_params) {}
+    : taskId(_taskId), slaveId(_slaveId), name(_name), cpus(-1), mem(-1),
+      params(_params) {}
 
   TaskDescription(TaskID _taskId, SlaveID _slaveId, const std::string& _name,
                   const bytes& _data)
-    : taskId(_taskId), slaveId(_slaveId), name(_name), data(_data) {}
+    : taskId(_taskId), slaveId(_slaveId), name(_name), cpus(-1), mem(-1),
+      data(_data) {}
 
   TaskID taskId;
   SlaveID slaveId;
   std::string name;
+  int32_t cpus;
+  int64_t mem;
   std::map<std::string, std::string> params;
   bytes data;
 };
@@ -70,17 +95,34 @@ struct TaskStatus
 };
 
 
+/**
+ * The resources offered on one slave. The scheduler driver also copies
+ * 'cpus' and 'mem' into the "cpus" and "mem" entries of 'params' for
+ * frameworks that still read them from there. Resources other than CPUs
+ * and memory that the slave offers, such as "disk" and "net", are only
+ * given in 'params'.
+ */
 struct SlaveOffer
 {
-  SlaveOffer() {}
+  SlaveOffer() : cpus(0), mem(0) {}
+
+  SlaveOffer(SlaveID _slaveId,
+             const std::string& _host,
+             int32_t _cpus,
+             int64_t _mem,
+             const std::map<std::string, std::string>& _params)
+    : slaveId(_slaveId), host(_host), cpus(_cpus), mem(_mem),
+      params(_params) {}
 
   SlaveOffer(SlaveID _slaveId,
              const std::string& _host,
              const std::map<std::string, std::string>& _params)
-    : slaveId(_slaveId), host(_host), params(_params) {}
+    : slaveId(_slaveId), host(_host), cpus(0), mem(0), params(_params) {}
 
   SlaveID slaveId;
   std::string host;
+  int32_t cpus;
+  int64_t mem;
   std::map<std::string, std::string> params;
 };
 
@@ -2,6 +2,7 @@
 #define MESOS_EXEC_HPP
 
 #include <string>
+#include <vector>
 
 #include <mesos.hpp>
 
@@ -73,6 +74,7 @@ public:
 
   // Communication methods from executor to Mesos
   virtual int sendStatusUpdate(const TaskStatus& status) { return -1; }
+  virtual int sendStatusUpdates(const std::vector<TaskStatus>& statuses) { return -1; }
   virtual int sendFrameworkMessage(const FrameworkMessage& message) { return -1; }
 };
 
@@ -96,6 +98,8 @@ public:
   virtual int run(); // Start and then join driver
 
   virtual int sendStatusUpdate(const TaskStatus& status);
+  // Send several updates in one message (in order)
+  virtual int sendStatusUpdates(const std::vector<TaskStatus>& statuses);
   virtual int sendFrameworkMessage(const FrameworkMessage& message);
 
   // Executor getter; required by some of the SWIG proxies
@@ -37,6 +37,10 @@ public:
                              const std::vector<SlaveOffer>& offers) {}
   virtual void offerRescinded(SchedulerDriver* d, OfferID offerId) {}
   virtual void statusUpdate(SchedulerDriver* d, const TaskStatus& status) {}
+  // Several updates that arrived together, in the order they happened
+  // (by default each one is passed to statusUpdate)
+  virtual void statusUpdates(SchedulerDriver* d,
+                             const std::vector<TaskStatus>& statuses);
   virtual void frameworkMessage(SchedulerDriver* d,
                                 const FrameworkMessage& message) {}
   virtual void slaveLost(SchedulerDriver* d, SlaveID slaveId) {}
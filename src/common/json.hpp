@@ -0,0 +1,55 @@
+#ifndef __JSON_HPP__
+#define __JSON_HPP__
+
+#include <stdio.h>
+
+#include <string>
+
+#include <mesos_types.hpp>
+
+
+namespace mesos { namespace internal {
+
+// Quote a string for JSON output, escaping whatever needs escaping
+inline std::string jsonString(const std::string& str)
+{
+  std::string out = "\"";
+  for (size_t i = 0; i < str.size(); i++) {
+    char c = str[i];
+    switch (c) {
+      case '"': out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\n': out += "\\n"; break;
+      case '\r': out += "\\r"; break;
+      case '\t': out += "\\t"; break;
+      default:
+        if ((unsigned char) c < 0x20) {
+          char buf[8];
+          snprintf(buf, sizeof(buf), "\\u%04x", c);
+          out += buf;
+        } else {
+          out += c;
+        }
+    }
+  }
+  return out + "\"";
+}
+
+
+// Name of a task state, as used in JSON output
+inline const char * taskStateName(TaskState state)
+{
+  switch (state) {
+    case TASK_STARTING: return "TASK_STARTING";
+    case TASK_RUNNING: return "TASK_RUNNING";
+    case TASK_FINISHED: return "TASK_FINISHED";
+    case TASK_FAILED: return "TASK_FAILED";
+    case TASK_KILLED: return "TASK_KILLED";
+    case TASK_LOST: return "TASK_LOST";
+    default: return "TASK_UNKNOWN";
+  }
+}
+
+}} /* namespace mesos::internal */
+
+#endif /* __JSON_HPP__ */
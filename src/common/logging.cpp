@@ -1,20 +1,273 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
 #include <sys/stat.h>
 
+#include <algorithm>
+#include <vector>
+
 #include <glog/logging.h>
 
 #include "fatal.hpp"
+#include "foreach.hpp"
+#include "lock.hpp"
 #include "logging.hpp"
 
+using std::find;
+using std::ostream;
 using std::string;
+using std::vector;
 
 using namespace mesos::internal;
 
 
+int LogRateLimiter::rate = 0;
+
+int64_t LogRateLimiter::total = 0;
+
+
+namespace {
+
+// Writes the lines given to the glog loggers of several severities on
+// a thread of its own, so that whoever logs only copies the line into
+// a ring buffer. glog calls loggers with its log mutex held, so there
+// is only ever one thread adding lines and the buffer needs no lock.
+// The writer sleeps on a condition variable while the buffer is empty,
+// and whoever adds a line only takes the mutex to wake it up.
+class LogWriter
+{
+public:
+  LogWriter(size_t capacity, bool _echo)
+    : entries(capacity), head(0), tail(0), dropped(0), echo(_echo),
+      sleeping(false), stopped(false)
+  {
+    pthread_mutex_init(&mutex, 0);
+    pthread_cond_init(&cond, 0);
+    if (pthread_create(&thread, 0, run, this) != 0)
+      fatal("failed to create log writer thread");
+  }
+
+  // Queue a line for 'logger'. Lines that have to be flushed wait for
+  // room and then for the writer to get to them, while other lines are
+  // dropped if the buffer is full.
+  void add(google::base::Logger *logger, bool flush, bool echoed,
+           time_t timestamp, const char *message, int length)
+  {
+    if (head - tail >= entries.size()) {
+      if (!flush) {
+        __sync_fetch_and_add(&dropped, 1);
+        return;
+      }
+      while (head - tail >= entries.size())
+        sched_yield();
+    }
+
+    Entry& entry = entries[head % entries.size()];
+    entry.logger = logger;
+    entry.flush = flush;
+    entry.echo = echoed && echo;
+    entry.timestamp = timestamp;
+    entry.message.assign(message, length); // Reuses the entry's buffer
+
+    __sync_synchronize();
+    head++;
+
+    // The writer sets 'sleeping' before it looks at 'head' one last
+    // time, so either it sees this line or we see that it's asleep
+    __sync_synchronize();
+    if (sleeping)
+      wake();
+
+    if (flush)
+      drain();
+  }
+
+  // Wait until every line queued so far has been written
+  void drain()
+  {
+    uint64_t end = head;
+    while (tail < end)
+      sched_yield();
+  }
+
+  // Write what's left and stop the thread
+  void stop()
+  {
+    {
+      Lock lock(&mutex);
+      stopped = true;
+      pthread_cond_signal(&cond);
+    }
+    pthread_join(thread, NULL);
+    pthread_mutex_destroy(&mutex);
+    pthread_cond_destroy(&cond);
+  }
+
+  int64_t droppedLines() const { return dropped; }
+
+private:
+  struct Entry
+  {
+    google::base::Logger *logger;
+    bool flush;
+    bool echo;
+    time_t timestamp;
+    string message;
+  };
+
+  void wake()
+  {
+    Lock lock(&mutex);
+    pthread_cond_signal(&cond);
+  }
+
+  // Sleep until there's a line to write or we're stopped
+  void sleep()
+  {
+    Lock lock(&mutex);
+    sleeping = true;
+    __sync_synchronize();
+    while (tail == head && !stopped)
+      pthread_cond_wait(&cond, &mutex);
+    sleeping = false;
+  }
+
+  static void * run(void *arg)
+  {
+    LogWriter *writer = (LogWriter *) arg;
+    vector<google::base::Logger *> written;
+    int64_t reported = 0;
+
+    while (true) {
+      // Read 'stopped' before 'head' so the last lines aren't missed
+      bool stopped = writer->stopped;
+      __sync_synchronize();
+      uint64_t head = writer->head;
+
+      if (writer->tail == head) {
+        // Flush once the buffer runs dry rather than after every line
+        foreach (google::base::Logger *logger, written)
+          logger->Flush();
+        written.clear();
+        if (stopped)
+          return NULL;
+        writer->sleep();
+        continue;
+      }
+
+      int64_t dropped = writer->dropped;
+      if (dropped > reported) {
+        fprintf(stderr, "Dropped %lld log lines because the log buffer "
+                "was full\n", (long long) (dropped - reported));
+        reported = dropped;
+      }
+
+      while (writer->tail < head) {
+        Entry& entry = writer->entries[writer->tail % writer->entries.size()];
+        entry.logger->Write(entry.flush, entry.timestamp,
+                            entry.message.data(), entry.message.size());
+        if (entry.echo)
+          fwrite(entry.message.data(), 1, entry.message.size(), stderr);
+        if (find(written.begin(), written.end(), entry.logger) ==
+            written.end())
+          written.push_back(entry.logger);
+        __sync_synchronize();
+        writer->tail++;
+      }
+    }
+  }
+
+  vector<Entry> entries;
+  volatile uint64_t head; // Next entry to fill, only changed by add()
+  volatile uint64_t tail; // Next entry to write, only changed by run()
+  volatile int64_t dropped;
+  const bool echo;
+  volatile bool sleeping;
+  volatile bool stopped;
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+};
+
+
+// Stands in for glog's logger of one severity, handing its lines to
+// the writer instead
+class AsyncLogger : public google::base::Logger
+{
+public:
+  AsyncLogger(LogWriter *_writer, google::base::Logger *_logger, bool _echo)
+    : writer(_writer), logger(_logger), echo(_echo) {}
+
+  virtual void Write(bool flush, time_t timestamp, const char *message,
+                     int length)
+  {
+    writer->add(logger, flush, echo, timestamp, message, length);
+  }
+
+  virtual void Flush()
+  {
+    writer->drain();
+    logger->Flush();
+  }
+
+  virtual google::uint32 LogSize() { return logger->LogSize(); }
+
+private:
+  LogWriter *writer;
+  google::base::Logger *logger;
+  const bool echo;
+};
+
+
+LogWriter *writer = NULL;
+
+// The loggers glog had before we put AsyncLoggers in their place
+google::base::Logger *loggers[google::NUM_SEVERITIES];
+
+
+void stopWriter()
+{
+  // Give glog its loggers back first, so that nothing gets queued once
+  // the writer has stopped
+  for (int severity = google::INFO; severity < google::FATAL; severity++)
+    google::base::SetLogger(severity, loggers[severity]);
+  if (FLAGS_stderrthreshold == google::NUM_SEVERITIES)
+    google::SetStderrLogging(google::INFO);
+  writer->stop();
+}
+
+} /* namespace */
+
+
+ostream& mesos::internal::operator << (ostream& stream,
+                                       const SuppressedLines& lines)
+{
+  if (lines.count > 0)
+    stream << "(" << lines.count << " similar lines suppressed) ";
+  return stream;
+}
+
+
 void Logging::registerOptions(Configurator* conf)
 {
   conf->addOption<bool>("quiet", 'q', "Disable logging to stderr", false);
   conf->addOption<string>("log_dir",
                           "Where to put logs (default: MESOS_HOME/logs)");
+  conf->addOption<bool>("log_async",
+                        "Write logs from a background thread rather than\n"
+                        "from the threads that log",
+                        false);
+  conf->addOption<int>("log_buffer_lines",
+                       "Log lines to buffer with --log_async (when full,\n"
+                       "INFO lines are dropped and counted)",
+                       16384);
+  conf->addOption<int>("log_rate_limit",
+                       "Most lines per second to log from each busy call\n"
+                       "site, e.g. for every offer or status update\n"
+                       "(0 means no limit)",
+                       0);
 }
 
 
@@ -31,10 +284,34 @@ void Logging::init(const char* programName, const Params& conf)
   FLAGS_logbufsecs = 1;
   google::InitGoogleLogging(programName);
 
-  if (!isQuiet(conf))
+  bool quiet = isQuiet(conf);
+  bool async = conf.get<bool>("log_async", false);
+
+  if (async) {
+    int lines = conf.get<int>("log_buffer_lines", 16384);
+    if (lines <= 0)
+      fatal("--log_buffer_lines must be positive");
+
+    // Every line goes to the INFO logger, so that one also echoes lines
+    // to stderr in place of glog (the FATAL log file is left to glog;
+    // a FATAL line flushes the others before glog aborts)
+    writer = new LogWriter(lines, !quiet);
+    for (int severity = google::INFO; severity < google::FATAL; severity++) {
+      loggers[severity] = google::base::GetLogger(severity);
+      google::base::SetLogger(severity,
+          new AsyncLogger(writer, loggers[severity], severity == google::INFO));
+    }
+    if (!quiet)
+      FLAGS_stderrthreshold = google::NUM_SEVERITIES;
+    atexit(stopWriter);
+  } else if (!quiet) {
     google::SetStderrLogging(google::INFO);
+  }
+
+  LogRateLimiter::rate = conf.get<int>("log_rate_limit", 0);
 
-  LOG(INFO) << "Logging to " << FLAGS_log_dir;
+  LOG(INFO) << "Logging to " << FLAGS_log_dir
+            << (async ? " from a background thread" : "");
 }
 
 
@@ -53,3 +330,15 @@ bool Logging::isQuiet(const Params& conf)
 {
   return conf.get<bool>("quiet", false);
 }
+
+
+int64_t Logging::suppressedLines()
+{
+  return LogRateLimiter::total;
+}
+
+
+int64_t Logging::droppedLines()
+{
+  return writer != NULL ? writer->droppedLines() : 0;
+}
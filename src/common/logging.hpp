@@ -1,6 +1,12 @@
 #ifndef __LOGGING_HPP__
 #define __LOGGING_HPP__
 
+#include <time.h>
+
+#include <ostream>
+
+#include <glog/logging.h>
+
 #include "configurator/configurator.hpp"
 
 
@@ -17,8 +23,80 @@ public:
   static void init(const char* programName, const Params& conf);
   static string getLogDir(const Params& conf);
   static bool isQuiet(const Params& conf);
+
+  // Lines left out by LOG_RATE_LIMITED since the process started
+  static int64_t suppressedLines();
+
+  // Lines thrown away because the asynchronous log buffer was full
+  static int64_t droppedLines();
+};
+
+
+/**
+ * Per-call-site state for LOG_RATE_LIMITED. This has no constructor so
+ * that a static one is zero-initialized without a guard. Call sites can
+ * be reached from more than one thread, so every field is only touched
+ * with atomic operations; threads that cross into a new second together
+ * can let through a line or two more than 'rate' between them.
+ */
+struct LogRateLimiter
+{
+  // Returns 0 if a line should be left out, and otherwise one more than
+  // the number of lines left out since the last one that wasn't
+  int admit()
+  {
+    if (rate <= 0)
+      return 1;
+    time_t now = time(NULL);
+    time_t last = second;
+    if (now != last && __sync_bool_compare_and_swap(&second, last, now))
+      __sync_lock_test_and_set(&lines, 0);
+    if (__sync_add_and_fetch(&lines, 1) > rate) {
+      __sync_fetch_and_add(&suppressed, 1);
+      __sync_fetch_and_add(&total, 1);
+      return 0;
+    }
+    return 1 + __sync_lock_test_and_set(&suppressed, 0);
+  }
+
+  // Most lines per second to log from each call site (0 means no limit)
+  static int rate;
+
+  // Lines left out at all call sites
+  static int64_t total;
+
+  time_t second;
+  int lines;
+  int suppressed;
+};
+
+
+// Writes "(N similar lines suppressed) " if N is positive
+struct SuppressedLines
+{
+  explicit SuppressedLines(int _count) : count(_count) {}
+  int count;
 };
 
+std::ostream& operator << (std::ostream& stream, const SuppressedLines& lines);
+
 }} /* namespace mesos::internal */
 
+
+// Like LOG(severity), but logs at most --log_rate_limit lines per
+// second from this call site and mentions how many it left out in the
+// next line that gets through. Meant for lines written once per offer,
+// task or status update. Like LOG_IF, this is a single statement, so it
+// can be the body of an if or an else without braces.
+#define LOG_RATE_LIMITED(severity)                                      \
+  for (int logAdmitted = LOG_RATE_LIMITER_ADMIT(); logAdmitted > 0;     \
+       logAdmitted = 0)                                                 \
+    LOG(severity) << mesos::internal::SuppressedLines(logAdmitted - 1)
+
+// The call site's limiter is declared in a (GNU) statement expression,
+// so that declaring it doesn't take a statement of its own
+#define LOG_RATE_LIMITER_ADMIT()                                        \
+  ({ static mesos::internal::LogRateLimiter logRateLimiter;             \
+     logRateLimiter.admit(); })
+
 #endif
@@ -0,0 +1,62 @@
+#include <stdlib.h>
+
+#include <limits>
+
+#include <boost/lexical_cast.hpp>
+
+#include "resources.hpp"
+
+using boost::lexical_cast;
+
+using std::map;
+using std::numeric_limits;
+using std::string;
+
+using namespace mesos::internal;
+
+
+namespace {
+
+const char *names[NUM_RESOURCES] = { "cpus", "mem", "disk", "net" };
+
+const char *labels[NUM_RESOURCES] = { "CPUs", "MEM", "DISK", "NET" };
+
+} /* namespace */
+
+
+void Resources::readParams(const map<string, string>& params)
+{
+  for (int i = DISK; i < NUM_RESOURCES; i++) {
+    map<string, string>::const_iterator it = params.find(names[i]);
+    if (it == params.end())
+      continue;
+    // Anything that isn't a number becomes -1, so the task gets rejected
+    char *end;
+    long amount = strtol(it->second.c_str(), &end, 10);
+    if (it->second.empty() || *end != '\0' ||
+        amount < numeric_limits<int32_t>::min() ||
+        amount > numeric_limits<int32_t>::max())
+      amount = -1;
+    amounts[i] = (int32_t) amount;
+  }
+}
+
+
+void Resources::writeParams(map<string, string> *params) const
+{
+  for (int i = DISK; i < NUM_RESOURCES; i++)
+    if (amounts[i] != 0)
+      (*params)[names[i]] = lexical_cast<string>(amounts[i]);
+}
+
+
+const char * Resources::name(int index)
+{
+  return index >= 0 && index < NUM_RESOURCES ? names[index] : "";
+}
+
+
+const char * Resources::label(int index)
+{
+  return index >= 0 && index < NUM_RESOURCES ? labels[index] : "";
+}
@@ -1,6 +1,12 @@
 #ifndef __RESOURCES_HPP__
 #define __RESOURCES_HPP__
 
+#include <stdint.h>
+
+#include <map>
+#include <ostream>
+#include <string>
+
 namespace mesos { namespace internal {
 
 // Some memory unit constants.
@@ -8,44 +14,163 @@ const int32_t Megabyte = 1;
 const int32_t Gigabyte = 1024 * Megabyte;
 
 
-// A resource vector.
+// Resources tracked by Resources, in the order of Resources::amounts.
+// The order is also the one they go on the wire in, so new resources
+// only go at the end, before NUM_RESOURCES.
+enum ResourceIndex {
+  CPUS,
+  MEM,
+  DISK, // In MB
+  NET,  // In Mbit/s
+  NUM_RESOURCES
+};
+
+// Room for resources in each Resources (more than NUM_RESOURCES, so
+// that resources can be added without changing the size of the loops)
+const int MAX_RESOURCES = 8;
+
+
+// A resource vector. The arithmetic and comparisons below run over all
+// MAX_RESOURCES amounts, unused ones being zero, so that they are loops
+// with a fixed trip count the compiler can unroll and vectorize.
 struct Resources {
-  int32_t cpus;
-  int32_t mem;
+  int32_t amounts[MAX_RESOURCES]; // Indexed by ResourceIndex
+
+  Resources()
+  {
+    for (int i = 0; i < MAX_RESOURCES; i++)
+      amounts[i] = 0;
+  }
+
+  Resources(int32_t _cpus, int32_t _mem)
+  {
+    for (int i = 0; i < MAX_RESOURCES; i++)
+      amounts[i] = 0;
+    amounts[CPUS] = _cpus;
+    amounts[MEM] = _mem;
+  }
+
+  Resources(int32_t _cpus, int32_t _mem, int32_t _disk, int32_t _net)
+  {
+    for (int i = 0; i < MAX_RESOURCES; i++)
+      amounts[i] = 0;
+    amounts[CPUS] = _cpus;
+    amounts[MEM] = _mem;
+    amounts[DISK] = _disk;
+    amounts[NET] = _net;
+  }
+
+  int32_t& cpus() { return amounts[CPUS]; }
+  int32_t cpus() const { return amounts[CPUS]; }
+
+  int32_t& mem() { return amounts[MEM]; }
+  int32_t mem() const { return amounts[MEM]; }
+
+  int32_t& disk() { return amounts[DISK]; }
+  int32_t disk() const { return amounts[DISK]; }
+
+  int32_t& net() { return amounts[NET]; }
+  int32_t net() const { return amounts[NET]; }
 
-  Resources(): cpus(0), mem(0) {}
-  
-  Resources(int32_t _cpus, int32_t _mem): cpus(_cpus), mem(_mem) {}
-  
   Resources operator + (const Resources& r) const
   {
-    return Resources(cpus + r.cpus, mem + r.mem);
+    Resources sum;
+    for (int i = 0; i < MAX_RESOURCES; i++)
+      sum.amounts[i] = amounts[i] + r.amounts[i];
+    return sum;
   }
-  
+
   Resources operator - (const Resources& r) const
   {
-    return Resources(cpus - r.cpus, mem - r.mem);
+    Resources dif;
+    for (int i = 0; i < MAX_RESOURCES; i++)
+      dif.amounts[i] = amounts[i] - r.amounts[i];
+    return dif;
   }
-  
+
   Resources& operator += (const Resources& r)
   {
-    cpus += r.cpus;
-    mem += r.mem;
+    for (int i = 0; i < MAX_RESOURCES; i++)
+      amounts[i] += r.amounts[i];
     return *this;
   }
 
   Resources& operator -= (const Resources& r)
   {
-    cpus -= r.cpus;
-    mem -= r.mem;
+    for (int i = 0; i < MAX_RESOURCES; i++)
+      amounts[i] -= r.amounts[i];
     return *this;
   }
+
+  // Whether there's no more of any resource here than in 'r'
+  bool fitsIn(const Resources& r) const
+  {
+    int over = 0;
+    for (int i = 0; i < MAX_RESOURCES; i++)
+      over |= amounts[i] > r.amounts[i];
+    return over == 0;
+  }
+
+  bool isZero() const
+  {
+    int nonZero = 0;
+    for (int i = 0; i < MAX_RESOURCES; i++)
+      nonZero |= amounts[i] != 0;
+    return nonZero == 0;
+  }
+
+  bool anyPositive() const
+  {
+    int positive = 0;
+    for (int i = 0; i < MAX_RESOURCES; i++)
+      positive |= amounts[i] > 0;
+    return positive != 0;
+  }
+
+  bool anyNegative() const
+  {
+    int negative = 0;
+    for (int i = 0; i < MAX_RESOURCES; i++)
+      negative |= amounts[i] < 0;
+    return negative != 0;
+  }
+
+  // The largest share of any resource in 'total' that this is, leaving
+  // out resources that 'total' has none of
+  double dominantShare(const Resources& total) const
+  {
+    double share = 0;
+    for (int i = 0; i < MAX_RESOURCES; i++) {
+      double s = total.amounts[i] > 0
+        ? amounts[i] / (double) total.amounts[i] : 0;
+      share = s > share ? s : share;
+    }
+    return share;
+  }
+
+  // Set the resources other than CPUs and memory (which tasks and offers
+  // have fields for) from their amounts in 'params', e.g. "disk"
+  void readParams(const std::map<std::string, std::string>& params);
+
+  // Add the resources other than CPUs and memory that aren't zero to
+  // 'params', the way readParams() reads them
+  void writeParams(std::map<std::string, std::string> *params) const;
+
+  // Name of the resource at 'index' in params and options, e.g. "disk"
+  static const char * name(int index);
+
+  // Name of the resource at 'index' when printing, e.g. "DISK"
+  static const char * label(int index);
 };
 
 
 inline std::ostream& operator << (std::ostream& stream, const Resources& res)
 {
-  stream << "<" << res.cpus << " CPUs, " << res.mem << " MEM>";
+  stream << "<" << res.cpus() << " CPUs, " << res.mem() << " MEM";
+  for (int i = DISK; i < NUM_RESOURCES; i++)
+    if (res.amounts[i] != 0)
+      stream << ", " << res.amounts[i] << " " << Resources::label(i);
+  stream << ">";
   return stream;
 }
 
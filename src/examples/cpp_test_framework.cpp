@@ -45,18 +45,12 @@ public:
     cout << "." << flush;
     vector<TaskDescription> tasks;
     foreach (const SlaveOffer &offer, offers) {
-      // This is kind of ugly because operator[] isn't a const function
-      int32_t cpus = lexical_cast<int32_t>(offer.params.find("cpus")->second);
-      int32_t mem = lexical_cast<int64_t>(offer.params.find("mem")->second);
-      if ((tasksLaunched < totalTasks) && (cpus >= 1 && mem >= 32)) {
+      if ((tasksLaunched < totalTasks) && (offer.cpus >= 1 && offer.mem >= 32)) {
         TaskID tid = tasksLaunched++;
 
         cout << endl << "Starting task " << tid << endl;
         string name = "Task " + lexical_cast<string>(tid);
-        map<string, string> taskParams;
-        taskParams["cpus"] = "1";
-        taskParams["mem"] = "32";
-        TaskDescription desc(tid, offer.slaveId, name, taskParams, "");
+        TaskDescription desc(tid, offer.slaveId, name, 1, 32, "");
         tasks.push_back(desc);
       }
     }
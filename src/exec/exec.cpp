@@ -21,6 +21,7 @@
 using std::cerr;
 using std::endl;
 using std::string;
+using std::vector;
 
 using boost::bind;
 using boost::ref;
@@ -303,6 +304,22 @@ int MesosExecutorDriver::sendStatusUpdate(const TaskStatus &status)
 }
 
 
+int MesosExecutorDriver::sendStatusUpdates(const vector<TaskStatus> &statuses)
+{
+  Lock lock(&mutex);
+
+  if (!running) {
+    //executor->error(this, EINVAL, "Executor has exited");
+    return -1;
+  }
+
+  process->send(process->slave,
+                pack<E2S_STATUS_UPDATES>(process->fid, statuses));
+
+  return 0;
+}
+
+
 int MesosExecutorDriver::sendFrameworkMessage(const FrameworkMessage &message)
 {
   Lock lock(&mutex);
@@ -360,7 +377,9 @@ public:
                            task.name.c_str(),
                            paramsStr.c_str(),
                            task.data.data(),
-                           task.data.size() };
+                           task.data.size(),
+                           task.cpus,
+                           task.mem };
     exec->launch_task(exec, &td);
   }
 
@@ -175,6 +175,12 @@ TaskDescription construct(JNIEnv *env, jobject jobj)
   jstring jstr = (jstring) env->GetObjectField(jobj, name);
   desc.name = construct<string>(env, jstr);
 
+  jfieldID cpus = env->GetFieldID(clazz, "cpus", "I");
+  desc.cpus = env->GetIntField(jobj, cpus);
+
+  jfieldID mem = env->GetFieldID(clazz, "mem", "J");
+  desc.mem = env->GetLongField(jobj, mem);
+
   jfieldID params = env->GetFieldID(clazz, "params", "Ljava/util/Map;");
   jobject jparams = env->GetObjectField(jobj, params);
   desc.params = construct< map<string, string> >(env, jparams);
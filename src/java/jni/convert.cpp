@@ -162,14 +162,15 @@ jobject convert(JNIEnv *env, const TaskDescription &desc)
   jobject jparams = convert< map<string, string> >(env, desc.params);
   jobject jdata = convert<bytes>(env, desc.data);
 
-  // ... desc = TaskDescription(taskId, slaveId, params, data);
+  // ... desc = TaskDescription(taskId, slaveId, name, cpus, mem, params, data);
   jclass clazz = env->FindClass("mesos/TaskDescription");
 
   jmethodID _init_ = env->GetMethodID(clazz, "<init>",
-    "(Lmesos/TaskID;Lmesos/SlaveID;Ljava/lang/String;Ljava/util/Map;[B)V");
+    "(Lmesos/TaskID;Lmesos/SlaveID;Ljava/lang/String;IJLjava/util/Map;[B)V");
 
-  jobject jdesc = env->NewObject(clazz, _init_, jtaskId, jslaveId,
-                                 jname, jparams, jdata);
+  jobject jdesc = env->NewObject(clazz, _init_, jtaskId, jslaveId, jname,
+                                 (jint) desc.cpus, (jlong) desc.mem,
+                                 jparams, jdata);
 
   return jdesc;
 }
@@ -201,13 +202,15 @@ jobject convert(JNIEnv *env, const SlaveOffer &offer)
   jobject jhost = convert<string>(env, offer.host);
   jobject jparams = convert< map<string, string> >(env, offer.params);
 
-  // SlaveOffer offer = new SlaveOffer(slaveId, host, params);
+  // SlaveOffer offer = new SlaveOffer(slaveId, host, cpus, mem, params);
   jclass clazz = env->FindClass("mesos/SlaveOffer");
 
   jmethodID _init_ = env->GetMethodID(clazz, "<init>",
-    "(Lmesos/SlaveID;Ljava/lang/String;Ljava/util/Map;)V");
+    "(Lmesos/SlaveID;Ljava/lang/String;IJLjava/util/Map;)V");
 
-  jobject joffer = env->NewObject(clazz, _init_, jslaveId, jhost, jparams);
+  jobject joffer = env->NewObject(clazz, _init_, jslaveId, jhost,
+                                  (jint) offer.cpus, (jlong) offer.mem,
+                                  jparams);
 
   return joffer;
 }
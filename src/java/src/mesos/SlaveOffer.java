@@ -4,12 +4,18 @@ import java.util.Map;
 
 
 public class SlaveOffer {
-  public SlaveOffer(SlaveID slaveId, String host, Map<String, String> params) {
+  public SlaveOffer(SlaveID slaveId, String host, int cpus, long mem, Map<String, String> params) {
     this.slaveId = slaveId;
     this.host = host;
+    this.cpus = cpus;
+    this.mem = mem;
     this.params = params;
   }
 
+  public SlaveOffer(SlaveID slaveId, String host, Map<String, String> params) {
+    this(slaveId, host, 0, 0, params);
+  }
+
   @Override
   public boolean equals(Object that) {
     if (that == this)
@@ -22,6 +28,8 @@ public class SlaveOffer {
 
     return slaveId.equals(other.slaveId) &&
       host.equals(other.host) &&
+      cpus == other.cpus &&
+      mem == other.mem &&
       params.equals(other.params);
   }
 
@@ -30,6 +38,8 @@ public class SlaveOffer {
     int hash = 1;
     hash = hash * 31 + (slaveId != null ? slaveId.hashCode() : 0);
     hash = hash * 31 + (host != null ? host.hashCode() : 0);
+    hash = hash * 31 + cpus;
+    hash = hash * 31 + (int) (mem ^ (mem >>> 32));
     hash = hash * 31 + (params != null ? params.hashCode() : 0);
     return hash;
   }
@@ -39,11 +49,15 @@ public class SlaveOffer {
     return "SlaveOffer {\n" +
       "  .slaveId = " + slaveId + "\n" +
       "  .host = " + host + "\n" +
+      "  .cpus = " + cpus + "\n" +
+      "  .mem = " + mem + "\n" +
       "  .params = " + params + "\n" +
       "}";
   }
 
   public final SlaveID slaveId;
   public final String host;
+  public final int cpus;
+  public final long mem;
   public final Map<String, String> params;
 }
@@ -5,14 +5,25 @@ import java.util.Map;
 
 
 public class TaskDescription {
-  public TaskDescription(TaskID taskId, SlaveID slaveId, String name, Map<String, String> params, byte[] data) {
+  public TaskDescription(TaskID taskId, SlaveID slaveId, String name, int cpus, long mem, Map<String, String> params, byte[] data) {
     this.taskId = taskId;
     this.slaveId = slaveId;
     this.name = name;
+    this.cpus = cpus;
+    this.mem = mem;
     this.params = params;
     this.data = data;
   }
 
+  public TaskDescription(TaskID taskId, SlaveID slaveId, String name, int cpus, long mem, byte[] data) {
+      this(taskId, slaveId, name, cpus, mem, Collections.<String, String>emptyMap(), data);
+  }
+
+  // Resources left at -1 are taken from the "cpus" and "mem" params
+  public TaskDescription(TaskID taskId, SlaveID slaveId, String name, Map<String, String> params, byte[] data) {
+      this(taskId, slaveId, name, -1, -1, params, data);
+  }
+
   public TaskDescription(TaskID taskId, SlaveID slaveId, String name, byte[] data) {
       this(taskId, slaveId, name, Collections.<String, String>emptyMap(), data);
   }
@@ -34,6 +45,8 @@ public class TaskDescription {
     return taskId.equals(other.taskId) &&
       slaveId.equals(other.slaveId) &&
       name.equals(other.name) &&
+      cpus == other.cpus &&
+      mem == other.mem &&
       params.equals(other.params) &&
       data.equals(other.data);
   }
@@ -44,6 +57,8 @@ public class TaskDescription {
     hash = hash * 31 + (taskId != null ? taskId.hashCode() : 0);
     hash = hash * 31 + (slaveId != null ? slaveId.hashCode() : 0);
     hash = hash * 31 + (name != null ? name.hashCode() : 0);
+    hash = hash * 31 + cpus;
+    hash = hash * 31 + (int) (mem ^ (mem >>> 32));
     hash = hash * 31 + (params != null ? params.hashCode() : 0);
     hash = hash * 31 + (data != null ? data.hashCode() : 0);
     return hash;
@@ -55,6 +70,8 @@ public class TaskDescription {
       "  .taskId = " + taskId + "\n" +
       "  .slaveId = " + slaveId + "\n" +
       "  .name = " + name + "\n" +
+      "  .cpus = " + cpus + "\n" +
+      "  .mem = " + mem + "\n" +
       "  .params = " + params + "\n" +
       "  .data = " + data + "\n" +
       "}";
@@ -63,6 +80,8 @@ public class TaskDescription {
   public final TaskID taskId;
   public final SlaveID slaveId;
   public final String name;
+  public final int cpus;
+  public final long mem;
   public final Map<String, String> params;
   public final byte[] data;
 }
@@ -0,0 +1,179 @@
+#include <algorithm>
+
+#include <glog/logging.h>
+
+#include "allocation.hpp"
+
+#include "common/foreach.hpp"
+#include "common/lock.hpp"
+
+#include "messaging/messages.hpp"
+
+using std::make_pair;
+
+using namespace mesos;
+using namespace mesos::internal;
+using namespace mesos::internal::master;
+
+
+namespace {
+
+// The offers that an allocation pass has decided on so far.
+class Pass
+{
+public:
+  Pass(const AllocationRequest& _request)
+    : request(_request), taken(_request.free.size(), false),
+      left(_request.free.size()), offers(_request.frameworks.size()),
+      next(_request.frameworks.size(), 0),
+      excluded(_request.frameworks.size(), NULL),
+      resources(_request.resources)
+  {
+    resources.resize(request.frameworks.size());
+    for (size_t i = 0; i < request.frameworks.size(); i++) {
+      unordered_map<FrameworkID, unordered_set<SlaveID> >::const_iterator it =
+        request.excluded.find(request.frameworks[i]);
+      if (it != request.excluded.end())
+        excluded[i] = &it->second;
+    }
+  }
+
+  // Whether every slave has been offered
+  bool done() const { return left == 0; }
+
+  // The dominant share framework i would have with its offer
+  double share(size_t i) const
+  {
+    return resources[i].dominantShare(request.total);
+  }
+
+  // Add the next slave that framework i can have to its offer, if any
+  bool offerNext(size_t i)
+  {
+    if (request.maxSlavesPerOffer > 0 &&
+        offers[i].size() >= request.maxSlavesPerOffer)
+      return false;
+
+    // Slaves before next[i] are taken or excluded, so start from there
+    while (next[i] < request.free.size()) {
+      size_t j = next[i]++;
+      const SlaveID& slaveId = request.free[j].first;
+      if (taken[j] || (excluded[i] != NULL && excluded[i]->count(slaveId) > 0))
+        continue;
+      taken[j] = true;
+      left--;
+      offers[i].push_back(request.free[j]);
+      resources[i] += request.free[j].second;
+      return true;
+    }
+    return false;
+  }
+
+  void finish(Allocation *allocation)
+  {
+    for (size_t i = 0; i < offers.size(); i++)
+      if (offers[i].size() > 0)
+        allocation->offers.push_back(make_pair(request.frameworks[i],
+                                               offers[i]));
+  }
+
+private:
+  const AllocationRequest& request;
+  vector<bool> taken;
+  size_t left;
+  vector<vector<pair<SlaveID, Resources> > > offers;
+  vector<size_t> next;
+  vector<const unordered_set<SlaveID>*> excluded;
+  vector<Resources> resources;
+};
+
+} /* namespace */
+
+
+void mesos::internal::master::allocate(const AllocationRequest& request,
+                                       Allocation *allocation)
+{
+  Pass pass(request);
+  size_t numFrameworks = request.frameworks.size();
+
+  if (!request.spread) {
+    for (size_t i = 0; i < numFrameworks && !pass.done(); i++)
+      while (pass.offerNext(i));
+  } else if (numFrameworks > 0) {
+    double fairShare = 1.0 / numFrameworks;
+    for (int bounded = 1; bounded >= 0; bounded--) {
+      bool progress = true;
+      while (progress && !pass.done()) {
+        progress = false;
+        for (size_t i = 0; i < numFrameworks; i++)
+          if (!bounded || pass.share(i) < fairShare)
+            progress = pass.offerNext(i) || progress;
+      }
+    }
+  }
+
+  pass.finish(allocation);
+}
+
+
+AllocationThread::AllocationThread(const PID& _master)
+  : master(_master), stopped(false)
+{
+  pthread_mutex_init(&mutex, 0);
+  pthread_cond_init(&cond, 0);
+
+  if (pthread_create(&thread, 0, run, this) != 0)
+    LOG(FATAL) << "Failed to create allocation thread";
+}
+
+
+AllocationThread::~AllocationThread()
+{
+  {
+    Lock lock(&mutex);
+    stopped = true;
+    pthread_cond_signal(&cond);
+  }
+
+  pthread_join(thread, NULL);
+
+  foreach (AllocationRequest *request, requests)
+    delete request;
+
+  pthread_mutex_destroy(&mutex);
+  pthread_cond_destroy(&cond);
+}
+
+
+void AllocationThread::allocate(AllocationRequest *request)
+{
+  Lock lock(&mutex);
+  requests.push_back(request);
+  pthread_cond_signal(&cond);
+}
+
+
+void * AllocationThread::run(void *arg)
+{
+  AllocationThread *thread = (AllocationThread *) arg;
+
+  while (true) {
+    vector<AllocationRequest *> requests;
+
+    {
+      Lock lock(&thread->mutex);
+      while (thread->requests.empty() && !thread->stopped)
+        pthread_cond_wait(&thread->cond, &thread->mutex);
+      if (thread->stopped)
+        return NULL;
+      requests.swap(thread->requests);
+    }
+
+    foreach (AllocationRequest *request, requests) {
+      Allocation *allocation = new Allocation();
+      mesos::internal::master::allocate(*request, allocation);
+      delete request;
+      MesosProcess::post(thread->master, pack<M2M_ALLOCATION>(allocation));
+    }
+  }
+}
@@ -0,0 +1,100 @@
+#ifndef __MASTER_ALLOCATION_HPP__
+#define __MASTER_ALLOCATION_HPP__
+
+#include <pthread.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+
+#include <process.hpp>
+
+#include <mesos_types.hpp>
+
+#include "common/resources.hpp"
+
+
+namespace mesos { namespace internal { namespace master {
+
+using std::pair;
+using std::vector;
+using boost::unordered_map;
+using boost::unordered_set;
+
+
+// A copy of everything an allocation pass looks at. Everything is named
+// by ID rather than by pointer so that a pass can run on another thread
+// while the master keeps changing (and deleting) its objects.
+struct AllocationRequest
+{
+  // Frameworks to offer to, in order, and the resources each one has
+  vector<FrameworkID> frameworks;
+  vector<Resources> resources;
+
+  // Resources in the whole cluster, to compute shares against
+  Resources total;
+
+  // Free resources on each slave that can be offered
+  vector<pair<SlaveID, Resources> > free;
+
+  // Slaves that each framework has refused or filtered
+  unordered_map<FrameworkID, unordered_set<SlaveID> > excluded;
+
+  // Whether to split the slaves across frameworks, and how many slaves
+  // an offer can have at most (0 means no limit)
+  bool spread;
+  size_t maxSlavesPerOffer;
+
+  AllocationRequest() : spread(false), maxSlavesPerOffer(0) {}
+};
+
+
+// The offers decided on by an allocation pass. These were decided on a
+// snapshot, so before making them the master has to check that each
+// framework and slave is still there and still has the resources free.
+struct Allocation
+{
+  vector<pair<FrameworkID, vector<pair<SlaveID, Resources> > > > offers;
+};
+
+
+// Offer the free resources on each slave to a framework that hasn't
+// refused or filtered the slave. Normally the first framework in order
+// gets every slave it can have; when spreading, frameworks take turns
+// getting one slave at a time, first only those below their fair share
+// (an equal dominant share) and then all of them, so that no slave is
+// left unoffered.
+void allocate(const AllocationRequest& request, Allocation *allocation);
+
+
+// A thread that runs allocation passes so that the master's process
+// can keep handling messages while one is running. Each allocation is
+// handed back to the master as a (local) message of type M2M_ALLOCATION,
+// at which point the master owns it.
+class AllocationThread
+{
+public:
+  AllocationThread(const PID& master);
+
+  ~AllocationThread();
+
+  // Queue an allocation pass (the thread deletes the request).
+  void allocate(AllocationRequest *request);
+
+private:
+  static void * run(void *arg);
+
+  const PID master;
+  pthread_t thread;
+  vector<AllocationRequest *> requests;
+  bool stopped;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+};
+
+}}} /* namespace */
+
+#endif /* __MASTER_ALLOCATION_HPP__ */
@@ -17,9 +17,13 @@ public:
   
   virtual void slaveRemoved(Slave *slave) {}
   
-  virtual void taskAdded(Task *task) {}
+  virtual void taskAdded(TaskRecord *task) {}
   
-  virtual void taskRemoved(Task *task, TaskRemovalReason reason) {}
+  virtual void taskRemoved(TaskRecord *task, TaskRemovalReason reason) {}
+
+  // Called whenever the resources owned by an added framework change,
+  // whether because of tasks or offers.
+  virtual void frameworkResourcesChanged(Framework *framework) {}
 
   virtual void offerReturned(SlotOffer* offer,
                              OfferReturnReason reason,
@@ -27,7 +31,17 @@ public:
 
   virtual void offersRevived(Framework *framework) {}
 
+  virtual void filterExpired(Framework *framework, Slave *slave) {}
+
   virtual void timerTick() {}
+
+  // Called once a master that was recovering its state from the log has
+  // all the slaves it is going to wait for, and may make offers again
+  virtual void recoveryFinished() {}
+
+  // Called with the result of an allocation pass that the allocator
+  // ran on an AllocationThread
+  virtual void allocationFinished(const Allocation& allocation) {}
 };
 
 }}} /* namespace */
@@ -0,0 +1,453 @@
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "allocator.hpp"
+#include "allocator_factory.hpp"
+#include "master.hpp"
+
+#include "configurator/configurator.hpp"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::map;
+using std::max;
+using std::min;
+using std::sort;
+using std::string;
+using std::vector;
+
+using boost::lexical_cast;
+
+using namespace mesos;
+using namespace mesos::internal;
+using namespace mesos::internal::master;
+
+
+namespace {
+
+double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+// Returns true with probability p
+bool chance(double p)
+{
+  return p > 0 && random() < p * RAND_MAX;
+}
+
+
+// A uniformly random integer in [low, high]
+int32_t between(int32_t low, int32_t high)
+{
+  return low + random() % (high - low + 1);
+}
+
+
+// A master for a synthetic cluster that never sends a message: the
+// benchmark plays the part of the slaves and frameworks, replying to
+// offers, finishing tasks and coming and going, and times every call
+// into the allocator. Offers, tasks, frameworks and slaves are kept
+// track of the same way the real master does.
+class BenchmarkMaster : public Master
+{
+public:
+  BenchmarkMaster(const Params& conf)
+    : Master(conf), nextSlave(0), nextFramework(0), offersMade(0),
+      slavesOffered(0), tasksLaunched(0), fairnessSamples(0),
+      fairnessError(0)
+  {
+    allocator = AllocatorFactory::instantiate(allocatorType, this);
+    if (allocator == NULL)
+      LOG(FATAL) << "Unrecognized allocator type: " << allocatorType;
+  }
+
+  virtual OfferID makeOffer(Framework *framework,
+                            const vector<SlaveResources>& resources)
+  {
+    OfferID oid = lexical_cast<string>(nextSlotOfferId++);
+    SlotOffer *offer = new SlotOffer(oid, framework->id, resources, 0);
+    slotOffers[offer->id] = offer;
+    framework->addOffer(offer);
+    foreach (const SlaveResources& r, resources) {
+      r.slave->slotOffers.insert(offer);
+      r.slave->resourcesOffered += r.resources;
+    }
+    offersMade++;
+    slavesOffered += resources.size();
+    return oid;
+  }
+
+  void run()
+  {
+    int numSlaves = conf.get<int>("slaves", 1000);
+    int numFrameworks = conf.get<int>("frameworks", 50);
+    int rounds = conf.get<int>("rounds", 100);
+    double taskChurn = conf.get<double>("task_churn", 0.1);
+    double frameworkChurn = conf.get<double>("framework_churn", 0.01);
+    double slaveLoss = conf.get<double>("slave_loss", 0.001);
+
+    for (int i = 0; i < numSlaves; i++)
+      joinSlave();
+    for (int i = 0; i < numFrameworks; i++)
+      joinFramework();
+
+    for (int round = 0; round < rounds; round++) {
+      // Frameworks launch as many tasks as fit in their offers
+      vector<SlotOffer *> offers;
+      foreachpair (_, SlotOffer *offer, slotOffers)
+        offers.push_back(offer);
+      foreach (SlotOffer *offer, offers)
+        replyToOffer(offer);
+
+      // Some tasks finish
+      vector<TaskRecord *> finished;
+      foreachpair (_, Framework *framework, frameworks)
+        foreachpair (_, TaskRecord *task, framework->tasks)
+          if (chance(taskChurn))
+            finished.push_back(task);
+      foreach (TaskRecord *task, finished)
+        finishTask(task, TRR_TASK_ENDED);
+
+      // Some frameworks leave and are replaced by new ones
+      vector<Framework *> leaving;
+      foreachpair (_, Framework *framework, frameworks)
+        if (chance(frameworkChurn))
+          leaving.push_back(framework);
+      foreach (Framework *framework, leaving) {
+        leaveFramework(framework);
+        joinFramework();
+      }
+
+      // Some slaves are lost and are replaced by new ones
+      vector<Slave *> lost;
+      foreachpair (_, Slave *slave, slaves)
+        if (chance(slaveLoss))
+          lost.push_back(slave);
+      foreach (Slave *slave, lost) {
+        loseSlave(slave);
+        joinSlave();
+      }
+
+      double start = now();
+      allocator->timerTick();
+      record("timer_tick", start);
+
+      sampleFairness();
+    }
+  }
+
+  void report()
+  {
+    double seconds = 0;
+    vector<double> all;
+    foreachpair (_, const vector<double>& latencies, timings) {
+      foreach (double latency, latencies) {
+        seconds += latency;
+        all.push_back(latency);
+      }
+    }
+
+    cout << "{" << endl;
+    cout << "  \"allocator\": \"" << allocatorType << "\"," << endl;
+    cout << "  \"slaves\": " << slaves.size() << "," << endl;
+    cout << "  \"frameworks\": " << frameworks.size() << "," << endl;
+    cout << "  \"seconds\": " << seconds << "," << endl;
+    cout << "  \"offers\": " << offersMade << "," << endl;
+    cout << "  \"slaves_offered\": " << slavesOffered << "," << endl;
+    cout << "  \"offers_per_second\": "
+         << (seconds > 0 ? offersMade / seconds : 0) << "," << endl;
+    cout << "  \"tasks_launched\": " << tasksLaunched << "," << endl;
+    cout << "  \"fairness_error\": "
+         << (fairnessSamples > 0 ? fairnessError / fairnessSamples : 0)
+         << "," << endl;
+    cout << "  \"latency\": ";
+    printPercentiles(all);
+    cout << "," << endl;
+    cout << "  \"events\": [" << endl;
+    size_t i = 0;
+    foreachpair (const string& name, vector<double>& latencies, timings) {
+      cout << "    {\"name\": \"" << name << "\", \"latency\": ";
+      printPercentiles(latencies);
+      cout << "}" << (++i < timings.size() ? "," : "") << endl;
+    }
+    cout << "  ]" << endl;
+    cout << "}" << endl;
+  }
+
+private:
+  void record(const string& name, double start)
+  {
+    timings[name].push_back(now() - start);
+  }
+
+  void printPercentiles(vector<double>& latencies)
+  {
+    sort(latencies.begin(), latencies.end());
+    size_t n = latencies.size();
+    double mean = 0;
+    foreach (double latency, latencies)
+      mean += latency;
+    mean = n > 0 ? mean / n : 0;
+    // Percentiles of seconds, printed in microseconds
+    double q[] = { 0.5, 0.9, 0.99, 1 };
+    const char *names[] = { "p50", "p90", "p99", "max" };
+    cout << "{\"count\": " << n << ", \"mean_us\": " << mean * 1000000;
+    for (int j = 0; j < 4; j++) {
+      double value = n > 0 ? latencies[min(n - 1, (size_t) (q[j] * n))] : 0;
+      cout << ", \"" << names[j] << "_us\": " << value * 1000000;
+    }
+    cout << "}";
+  }
+
+  // Every framework wants as much as it can get, so under a fair
+  // allocator their dominant shares would all be the same; report
+  // how far apart they are
+  void sampleFairness()
+  {
+    if (frameworks.size() < 2)
+      return;
+    Resources total;
+    foreachpair (_, Slave *slave, slaves)
+      total += slave->resources;
+    double lowest = 1, highest = 0;
+    foreachpair (_, Framework *framework, frameworks) {
+      double share = framework->resources.dominantShare(total);
+      lowest = min(lowest, share);
+      highest = max(highest, share);
+    }
+    fairnessError += highest - lowest;
+    fairnessSamples++;
+  }
+
+  void joinSlave()
+  {
+    SlaveID sid = "slave-" + lexical_cast<string>(nextSlave++);
+    Slave *slave = new Slave(PID(), sid, 0);
+    slave->hostname = "host" + sid.s;
+    slave->resources = Resources(conf.get<int>("slave_cpus", 8),
+                                 conf.get<int>("slave_mem", 16 * Gigabyte),
+                                 conf.get<int>("slave_disk", 0), 0);
+    slaves[sid] = slave;
+    double start = now();
+    allocator->slaveAdded(slave);
+    record("slave_added", start);
+  }
+
+  void loseSlave(Slave *slave)
+  {
+    slave->active = false;
+    foreach (TaskRecord *task, slave->taskList())
+      finishTask(task, TRR_SLAVE_LOST);
+    unordered_set<SlotOffer *> offers = slave->slotOffers;
+    foreach (SlotOffer *offer, offers) {
+      vector<SlaveResources> otherSlaveResources;
+      foreach (const SlaveResources& r, offer->resources)
+        if (r.slave != slave)
+          otherSlaveResources.push_back(r);
+      returnOffer(offer, ORR_SLAVE_LOST, otherSlaveResources);
+    }
+    foreachpair (_, Framework *framework, frameworks)
+      framework->slaveFilter.erase(slave);
+    slaves.erase(slave->id);
+    double start = now();
+    allocator->slaveRemoved(slave);
+    record("slave_removed", start);
+    delete slave;
+  }
+
+  void joinFramework()
+  {
+    FrameworkID fid = "framework-" + lexical_cast<string>(nextFramework++);
+    Framework *framework = new Framework(PID(), fid, 0);
+    framework->allocator = allocator;
+    // Mix CPU-heavy and memory-heavy frameworks, and disk-heavy ones
+    // too if the slaves have disk
+    taskSizes[fid] = Resources(between(1, 4),
+                               between(1, 16) * 512 * Megabyte,
+                               conf.get<int>("slave_disk", 0) > 0
+                                 ? between(0, 16) * 1024 : 0,
+                               0);
+    frameworks[fid] = framework;
+    double start = now();
+    allocator->frameworkAdded(framework);
+    record("framework_added", start);
+  }
+
+  void leaveFramework(Framework *framework)
+  {
+    framework->active = false;
+    unordered_map<TaskID, TaskRecord *> tasks = framework->tasks;
+    foreachpair (_, TaskRecord *task, tasks)
+      finishTask(task, TRR_FRAMEWORK_LOST);
+    unordered_set<SlotOffer *> offers = framework->slotOffers;
+    foreach (SlotOffer *offer, offers)
+      returnOffer(offer, ORR_FRAMEWORK_LOST, offer->resources);
+    frameworks.erase(framework->id);
+    taskSizes.erase(framework->id);
+    double start = now();
+    allocator->frameworkRemoved(framework);
+    record("framework_removed", start);
+    delete framework;
+  }
+
+  void replyToOffer(SlotOffer *offer)
+  {
+    Framework *framework = lookupFramework(offer->frameworkId);
+    CHECK(framework != NULL);
+    const Resources& size = taskSizes[framework->id];
+    vector<SlaveResources> resourcesLeft;
+    foreach (const SlaveResources& r, offer->resources) {
+      Resources left = r.resources;
+      while (left.cpus() >= size.cpus() && left.mem() >= size.mem()) {
+        TaskRecord *task = taskTable.add(tasksLaunched, framework->id, size,
+                                         TASK_STARTING, "", r.slave->id);
+        framework->addTask(task);
+        r.slave->addTask(framework->id, task);
+        double start = now();
+        allocator->taskAdded(task);
+        record("task_added", start);
+        tasksLaunched++;
+        left -= size;
+      }
+      resourcesLeft.push_back(SlaveResources(r.slave, left));
+    }
+    returnOffer(offer, ORR_FRAMEWORK_REPLIED, resourcesLeft);
+  }
+
+  void returnOffer(SlotOffer *offer,
+                   OfferReturnReason reason,
+                   const vector<SlaveResources>& resourcesLeft)
+  {
+    foreach (SlaveResources& r, offer->resources) {
+      r.slave->resourcesOffered -= r.resources;
+      r.slave->slotOffers.erase(offer);
+    }
+    Framework *framework = lookupFramework(offer->frameworkId);
+    CHECK(framework != NULL);
+    framework->removeOffer(offer);
+    double start = now();
+    allocator->offerReturned(offer, reason, resourcesLeft);
+    record("offer_returned", start);
+    slotOffers.erase(offer->id);
+    delete offer;
+  }
+
+  void finishTask(TaskRecord *task, TaskRemovalReason reason)
+  {
+    Framework *framework = lookupFramework(taskTable.frameworkId(task));
+    Slave *slave = lookupSlave(taskTable.slaveId(task));
+    CHECK(framework != NULL);
+    CHECK(slave != NULL);
+    framework->removeTask(task->id);
+    slave->removeTask(framework->id, task);
+    double start = now();
+    allocator->taskRemoved(task, reason);
+    record("task_removed", start);
+    taskTable.remove(task);
+  }
+
+  int64_t nextSlave;
+  int64_t nextFramework;
+
+  // The resources each of a framework's tasks uses
+  unordered_map<FrameworkID, Resources> taskSizes;
+
+  // Seconds spent in each kind of allocator call
+  map<string, vector<double> > timings;
+
+  int64_t offersMade;
+  int64_t slavesOffered;
+  int64_t tasksLaunched;
+  int64_t fairnessSamples;
+  double fairnessError;
+};
+
+} /* namespace */
+
+
+void usage(const char* progName, const Configurator& conf)
+{
+  cerr << "Usage: " << progName << " [--slaves=NUM] [--frameworks=NUM] [...]"
+       << endl
+       << endl
+       << "Drives an allocator through a synthetic cluster and prints" << endl
+       << "allocation latencies, offer throughput and fairness as JSON." << endl
+       << "Master options (e.g. --allocator) configure the allocator." << endl
+       << endl
+       << "Supported options:" << endl
+       << conf.getUsage();
+}
+
+
+int main(int argc, char **argv)
+{
+  Configurator conf;
+  conf.addOption<int>("slaves", "Number of slaves", 1000);
+  conf.addOption<int>("frameworks", "Number of frameworks", 50);
+  conf.addOption<int>("rounds",
+                      "Number of rounds of replies, churn and timer ticks",
+                      100);
+  conf.addOption<int>("slave_cpus", "CPUs on each slave", 8);
+  conf.addOption<int>("slave_mem", "MB of memory on each slave",
+                      16 * Gigabyte);
+  conf.addOption<int>("slave_disk", "MB of disk on each slave", 0);
+  conf.addOption<double>("task_churn",
+                         "Chance that a task finishes in a round",
+                         0.1);
+  conf.addOption<double>("framework_churn",
+                         "Chance that a framework is replaced in a round",
+                         0.01);
+  conf.addOption<double>("slave_loss",
+                         "Chance that a slave is lost (and replaced) in\n"
+                         "a round",
+                         0.001);
+  conf.addOption<int>("seed", "Random seed", 0);
+  conf.addOption<bool>("log", "Log to stderr, including the allocator's\n"
+                       "own logging (which is then part of the timings)",
+                       false);
+  Master::registerOptions(&conf);
+
+  if (argc == 2 && string("--help") == argv[1]) {
+    usage(argv[0], conf);
+    exit(1);
+  }
+
+  Params params;
+  try {
+    params = conf.load(argc, argv, true);
+  } catch (ConfigurationException& e) {
+    cerr << "Configuration error: " << e.what() << endl;
+    exit(1);
+  }
+
+  // Allocation passes have to run synchronously since nothing would
+  // receive the results of passes run on an allocation thread
+  params.set("allocation_thread", false);
+
+  google::InitGoogleLogging(argv[0]);
+  if (params.get<bool>("log", false))
+    google::SetStderrLogging(google::INFO);
+  else
+    FLAGS_minloglevel = google::WARNING;
+
+  srandom(params.get<int>("seed", 0));
+
+  BenchmarkMaster master(params);
+  master.run();
+  master.report();
+
+  return 0;
+}
@@ -0,0 +1,108 @@
+#include <glog/logging.h>
+
+#include "decoder.hpp"
+
+#include "common/foreach.hpp"
+#include "common/lock.hpp"
+
+#include "messaging/messages.hpp"
+
+using std::make_pair;
+
+using namespace mesos;
+using namespace mesos::internal;
+using namespace mesos::internal::master;
+
+
+void mesos::internal::master::decodeOfferReply(const string& body,
+                                               OfferReply *reply)
+{
+  tie(reply->frameworkId, reply->offerId, reply->tasks, reply->params) =
+    unpack<F2M_SLOT_OFFER_REPLY>(body);
+
+  reply->resources.reserve(reply->tasks.size());
+  foreach (const TaskDescription &t, reply->tasks) {
+    Resources res(t.cpus, t.mem);
+    res.readParams(t.params);
+    reply->resources.push_back(res);
+  }
+}
+
+
+DecoderPool::DecoderPool(const PID& _master, int count)
+  : master(_master), stopped(false)
+{
+  pthread_mutex_init(&mutex, 0);
+  pthread_cond_init(&cond, 0);
+
+  for (int i = 0; i < count; i++) {
+    pthread_t thread;
+    if (pthread_create(&thread, 0, run, this) != 0)
+      LOG(FATAL) << "Failed to create decoder thread";
+    threads.push_back(thread);
+  }
+}
+
+
+DecoderPool::~DecoderPool()
+{
+  {
+    Lock lock(&mutex);
+    stopped = true;
+    pthread_cond_broadcast(&cond);
+  }
+
+  foreach (pthread_t thread, threads)
+    pthread_join(thread, NULL);
+
+  pthread_mutex_destroy(&mutex);
+  pthread_cond_destroy(&cond);
+}
+
+
+void DecoderPool::decodeOfferReply(const PID& from, const string& body)
+{
+  Lock lock(&mutex);
+  bodies.push_back(make_pair(from, body));
+  pthread_cond_signal(&cond);
+}
+
+
+void * DecoderPool::run(void *arg)
+{
+  DecoderPool *pool = (DecoderPool *) arg;
+
+  while (true) {
+    pair<PID, string> next;
+
+    {
+      Lock lock(&pool->mutex);
+      // Take the oldest body whose sender has none being decoded
+      deque<pair<PID, string> >::iterator it;
+      while (true) {
+        it = pool->bodies.begin();
+        while (it != pool->bodies.end() && pool->busy.count(it->first) > 0)
+          ++it;
+        if (it != pool->bodies.end() || pool->stopped)
+          break;
+        pthread_cond_wait(&pool->cond, &pool->mutex);
+      }
+      if (it == pool->bodies.end())
+        return NULL;
+      next = *it;
+      pool->bodies.erase(it);
+      pool->busy.insert(next.first);
+    }
+
+    OfferReply *reply = new OfferReply();
+    mesos::internal::master::decodeOfferReply(next.second, reply);
+    reply->from = next.first;
+    MesosProcess::post(pool->master, pack<M2M_DECODED_OFFER_REPLY>(reply));
+
+    {
+      Lock lock(&pool->mutex);
+      pool->busy.erase(next.first);
+      pthread_cond_broadcast(&pool->cond);
+    }
+  }
+}
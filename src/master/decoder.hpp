@@ -0,0 +1,78 @@
+#ifndef __MASTER_DECODER_HPP__
+#define __MASTER_DECODER_HPP__
+
+#include <pthread.h>
+
+#include <deque>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <process.hpp>
+
+#include <mesos.hpp>
+#include <mesos_types.hpp>
+
+#include "common/params.hpp"
+#include "common/resources.hpp"
+
+
+namespace mesos { namespace internal { namespace master {
+
+using std::deque;
+using std::pair;
+using std::set;
+using std::string;
+using std::vector;
+
+
+// A fully decoded F2M_SLOT_OFFER_REPLY, including the parsed resources
+// of each task (resources[i] belongs to tasks[i]) so that the master
+// never has to look at the params strings of a task again.
+struct OfferReply
+{
+  PID from; // Who sent it (only filled in by DecoderPool)
+  FrameworkID frameworkId;
+  OfferID offerId;
+  vector<TaskDescription> tasks;
+  vector<Resources> resources;
+  Params params;
+};
+
+
+// Unpack the body of an F2M_SLOT_OFFER_REPLY into 'reply'.
+void decodeOfferReply(const string& body, OfferReply *reply);
+
+
+// A pool of threads that decode message bodies on behalf of the master
+// so that its own process only has to run the state-mutating logic.
+// Decoded replies are handed back to the master as (local) messages of
+// type M2M_DECODED_OFFER_REPLY, at which point the master owns them.
+// Replies from the same sender are decoded one at a time, so they are
+// handed back in the order they were queued.
+class DecoderPool
+{
+public:
+  DecoderPool(const PID& master, int threads);
+
+  ~DecoderPool();
+
+  // Queue the body of an F2M_SLOT_OFFER_REPLY from 'from' for decoding.
+  void decodeOfferReply(const PID& from, const string& body);
+
+private:
+  static void * run(void *arg);
+
+  const PID master;
+  vector<pthread_t> threads;
+  deque<pair<PID, string> > bodies;
+  set<PID> busy; // Senders with a reply being decoded
+  bool stopped;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+};
+
+}}} /* namespace */
+
+#endif /* __MASTER_DECODER_HPP__ */
@@ -0,0 +1,240 @@
+#include <iomanip>
+#include <sstream>
+
+#include "http.hpp"
+
+#include "common/json.hpp"
+#include "common/lock.hpp"
+#include "common/logging.hpp"
+
+using std::make_pair;
+using std::ostringstream;
+using std::string;
+using std::tr1::shared_ptr;
+
+using namespace mesos;
+using namespace mesos::internal;
+using namespace mesos::internal::master;
+
+
+namespace {
+
+void writeStats(ostringstream& out, const state::Snapshot& snapshot)
+{
+  int64_t cpus = 0, mem = 0, disk = 0, net = 0;
+  int64_t usedCpus = 0, usedMem = 0, usedDisk = 0, usedNet = 0;
+  int64_t offeredCpus = 0, offeredMem = 0, offeredDisk = 0, offeredNet = 0;
+  int64_t tasks = 0, offers = 0;
+
+  foreach (const shared_ptr<const state::Slave>& s, snapshot.slaves) {
+    cpus += s->cpus;
+    mem += s->mem;
+    disk += s->disk;
+    net += s->net;
+  }
+
+  foreach (const shared_ptr<const state::Framework>& f, snapshot.frameworks) {
+    usedCpus += f->cpus;
+    usedMem += f->mem;
+    usedDisk += f->disk;
+    usedNet += f->net;
+    tasks += f->tasks.size();
+    offers += f->offers.size();
+    foreach (state::SlotOffer *o, f->offers) {
+      foreach (state::SlaveResources *r, o->resources) {
+        offeredCpus += r->cpus;
+        offeredMem += r->mem;
+        offeredDisk += r->disk;
+        offeredNet += r->net;
+      }
+    }
+  }
+
+  out << "\"version\":" << snapshot.version << ","
+      << "\"time\":" << snapshot.time << ","
+      << "\"slaves\":" << snapshot.slaves.size() << ","
+      << "\"frameworks\":" << snapshot.frameworks.size() << ","
+      << "\"tasks\":" << tasks << ","
+      << "\"offers\":" << offers << ","
+      << "\"offers_expired\":" << snapshot.offers_expired << ","
+      << "\"total_cpus\":" << cpus << ","
+      << "\"total_mem\":" << mem << ","
+      << "\"total_disk\":" << disk << ","
+      << "\"total_net\":" << net << ","
+      << "\"used_cpus\":" << usedCpus << ","
+      << "\"used_mem\":" << usedMem << ","
+      << "\"used_disk\":" << usedDisk << ","
+      << "\"used_net\":" << usedNet << ","
+      << "\"offered_cpus\":" << offeredCpus << ","
+      << "\"offered_mem\":" << offeredMem << ","
+      << "\"offered_disk\":" << offeredDisk << ","
+      << "\"offered_net\":" << offeredNet << ","
+      << "\"log_lines_suppressed\":" << Logging::suppressedLines() << ","
+      << "\"log_lines_dropped\":" << Logging::droppedLines() << ","
+      << "\"proc_migrations\":" << ProcessStats::procMigrations() << ","
+      << "\"io_migrations\":" << ProcessStats::ioMigrations();
+}
+
+
+void writeState(ostringstream& out, const state::Snapshot& snapshot)
+{
+  out << "\"build_date\":" << jsonString(snapshot.build_date) << ","
+      << "\"build_user\":" << jsonString(snapshot.build_user) << ","
+      << "\"pid\":" << jsonString(snapshot.pid) << ","
+      << "\"fault_tolerant\":" << (snapshot.isFT ? "true" : "false") << ",";
+
+  out << "\"slaves\":[";
+  bool first = true;
+  foreach (const shared_ptr<const state::Slave>& s, snapshot.slaves) {
+    out << (first ? "" : ",") << "{"
+        << "\"id\":" << jsonString(s->id.s) << ","
+        << "\"host\":" << jsonString(s->host) << ","
+        << "\"public_dns\":" << jsonString(s->public_dns) << ","
+        << "\"cpus\":" << s->cpus << ","
+        << "\"mem\":" << s->mem << ","
+        << "\"disk\":" << s->disk << ","
+        << "\"net\":" << s->net << ","
+        << "\"connect_time\":" << s->connect_time << "}";
+    first = false;
+  }
+  out << "],";
+
+  out << "\"frameworks\":[";
+  first = true;
+  foreach (const shared_ptr<const state::Framework>& f, snapshot.frameworks) {
+    out << (first ? "" : ",") << "{"
+        << "\"id\":" << jsonString(f->id.s) << ","
+        << "\"user\":" << jsonString(f->user) << ","
+        << "\"name\":" << jsonString(f->name) << ","
+        << "\"executor\":" << jsonString(f->executor) << ","
+        << "\"cpus\":" << f->cpus << ","
+        << "\"mem\":" << f->mem << ","
+        << "\"disk\":" << f->disk << ","
+        << "\"net\":" << f->net << ","
+        << "\"connect_time\":" << f->connect_time << ",";
+    first = false;
+
+    out << "\"tasks\":[";
+    bool firstTask = true;
+    foreach (state::Task *t, f->tasks) {
+      out << (firstTask ? "" : ",") << "{"
+          << "\"id\":" << t->id << ","
+          << "\"name\":" << jsonString(t->name) << ","
+          << "\"slave_id\":" << jsonString(t->slave_id.s) << ","
+          << "\"state\":" << jsonString(taskStateName(t->state)) << ","
+          << "\"cpus\":" << t->cpus << ","
+          << "\"mem\":" << t->mem << ","
+          << "\"disk\":" << t->disk << ","
+          << "\"net\":" << t->net << "}";
+      firstTask = false;
+    }
+    out << "],";
+
+    out << "\"offers\":[";
+    bool firstOffer = true;
+    foreach (state::SlotOffer *o, f->offers) {
+      out << (firstOffer ? "" : ",") << "{"
+          << "\"id\":" << jsonString(o->id.s) << ","
+          << "\"age\":" << snapshot.time - o->time << ","
+          << "\"resources\":[";
+      bool firstResources = true;
+      foreach (state::SlaveResources *r, o->resources) {
+        out << (firstResources ? "" : ",") << "{"
+            << "\"slave_id\":" << jsonString(r->slave_id.s) << ","
+            << "\"cpus\":" << r->cpus << ","
+            << "\"mem\":" << r->mem << ","
+            << "\"disk\":" << r->disk << ","
+            << "\"net\":" << r->net << "}";
+        firstResources = false;
+      }
+      out << "]}";
+      firstOffer = false;
+    }
+    out << "]}";
+  }
+  out << "]";
+}
+
+} /* namespace */
+
+
+void mesos::internal::master::respondHttp(const HttpRequest& request,
+                                          const state::Snapshot& snapshot)
+{
+  ostringstream out;
+  out << std::fixed << std::setprecision(3); // For times and ages
+  if (request.path == "/master/state.json") {
+    out << "{";
+    writeState(out, snapshot);
+    out << ",\"stats\":{";
+    writeStats(out, snapshot);
+    out << "}}";
+  } else if (request.path == "/master/stats.json") {
+    out << "{";
+    writeStats(out, snapshot);
+    out << "}";
+  } else {
+    Process::respond(request.id, "404 Not Found", "text/plain", "");
+    return;
+  }
+  Process::respond(request.id, "200 OK", "application/json", out.str());
+}
+
+
+HttpRenderer::HttpRenderer()
+  : stopped(false)
+{
+  pthread_mutex_init(&mutex, 0);
+  pthread_cond_init(&cond, 0);
+
+  if (pthread_create(&thread, 0, run, this) != 0)
+    LOG(FATAL) << "Failed to create HTTP renderer thread";
+}
+
+
+HttpRenderer::~HttpRenderer()
+{
+  {
+    Lock lock(&mutex);
+    stopped = true;
+    pthread_cond_signal(&cond);
+  }
+
+  pthread_join(thread, NULL);
+
+  pthread_mutex_destroy(&mutex);
+  pthread_cond_destroy(&cond);
+}
+
+
+void HttpRenderer::render(const HttpRequest& request,
+                          const shared_ptr<const state::Snapshot>& snapshot)
+{
+  Lock lock(&mutex);
+  requests.push_back(make_pair(request, snapshot));
+  pthread_cond_signal(&cond);
+}
+
+
+void * HttpRenderer::run(void *arg)
+{
+  HttpRenderer *renderer = (HttpRenderer *) arg;
+
+  while (true) {
+    HttpRequest request(NULL, 0);
+    shared_ptr<const state::Snapshot> snapshot;
+
+    {
+      Lock lock(&renderer->mutex);
+      while (renderer->requests.empty() && !renderer->stopped)
+        pthread_cond_wait(&renderer->cond, &renderer->mutex);
+      if (renderer->requests.empty())
+        return NULL;
+      request = renderer->requests.front().first;
+      snapshot = renderer->requests.front().second;
+      renderer->requests.pop_front();
+    }
+
+    respondHttp(request, *snapshot);
+  }
+}
@@ -0,0 +1,52 @@
+#ifndef __MASTER_HTTP_HPP__
+#define __MASTER_HTTP_HPP__
+
+#include <pthread.h>
+
+#include <deque>
+#include <utility>
+
+#include <process.hpp>
+
+#include "state.hpp"
+
+
+namespace mesos { namespace internal { namespace master {
+
+// Answer an HTTP request routed to the master (see Process::route):
+//   /master/state.json  slaves, frameworks, tasks and offers
+//   /master/stats.json  counts and totals only (cheap to scrape)
+// Both are rendered from a state snapshot, so they are at most
+// --snapshot_interval seconds old.
+void respondHttp(const HttpRequest& request, const state::Snapshot& snapshot);
+
+
+// A thread that answers HTTP requests from the snapshot they were
+// handed along with, so that rendering a large state.json doesn't hold
+// up the master's own process (snapshots are immutable, and responses
+// can be sent from any thread).
+class HttpRenderer
+{
+public:
+  HttpRenderer();
+
+  ~HttpRenderer();
+
+  // Queue a request to be answered from 'snapshot'.
+  void render(const HttpRequest& request,
+              const std::tr1::shared_ptr<const state::Snapshot>& snapshot);
+
+private:
+  static void * run(void *arg);
+
+  pthread_t thread;
+  std::deque<std::pair<HttpRequest,
+                       std::tr1::shared_ptr<const state::Snapshot> > > requests;
+  bool stopped;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+};
+
+}}} /* namespace */
+
+#endif /* __MASTER_HTTP_HPP__ */
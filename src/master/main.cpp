@@ -76,7 +76,7 @@ int main(int argc, char **argv)
   MasterDetector *detector = MasterDetector::create(url, pid, true, quiet);
 
 #ifdef MESOS_WEBUI
-  startMasterWebUI(pid, params);
+  startMasterWebUI(master, params);
 #endif
   
   Process::wait(pid);
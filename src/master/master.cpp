@@ -3,6 +3,7 @@
 #include <glog/logging.h>
 
 #include "common/date_utils.hpp"
+#include "common/logging.hpp"
 
 #include "allocator.hpp"
 #include "allocator_factory.hpp"
@@ -22,6 +23,7 @@ using std::setw;
 using std::string;
 using std::vector;
 
+using boost::bad_lexical_cast;
 using boost::lexical_cast;
 using boost::unordered_map;
 using boost::unordered_set;
@@ -38,13 +40,14 @@ class AllocatorTimer : public MesosProcess
 {
 private:
   const PID master;
+  const double interval;
 
 protected:
   void operator () ()
   {
     link(master);
     do {
-      switch (receive(1)) {
+      switch (receive(interval)) {
       case PROCESS_TIMEOUT:
 	send(master, pack<M2M_TIMER_TICK>());
 	break;
@@ -55,7 +58,8 @@ protected:
   }
 
 public:
-  AllocatorTimer(const PID &_master) : master(_master) {}
+  AllocatorTimer(const PID &_master, double _interval)
+    : master(_master), interval(_interval) {}
 };
 
 
@@ -63,7 +67,7 @@ public:
 class SharesPrinter : public MesosProcess
 {
 protected:
-  PID master;
+  Master *master;
 
   void operator () ()
   {
@@ -76,15 +80,16 @@ protected:
     while (true) {
       pause(1);
 
-      send(master, pack<M2M_GET_STATE>());
-      receive();
-      CHECK(msgid() == M2M_GET_STATE_REPLY);
-      state::MasterState *state = unpack<M2M_GET_STATE_REPLY, 0>(body());
+      // Read the latest snapshot rather than asking the master to copy
+      // its state for us
+      std::tr1::shared_ptr<const state::Snapshot> state = master->getSnapshot();
+      if (!state)
+        continue;
 
       uint32_t total_cpus = 0;
       uint32_t total_mem = 0;
 
-      foreach (state::Slave *s, state->slaves) {
+      foreach (const std::tr1::shared_ptr<const state::Slave>& s, state->slaves) {
         total_cpus += s->cpus;
         total_mem += s->mem;
       }
@@ -92,7 +97,8 @@ protected:
       if (state->frameworks.empty()) {
         file << "--------------------------------" << std::endl;
       } else {
-        foreach (state::Framework *f, state->frameworks) {
+        foreach (const std::tr1::shared_ptr<const state::Framework>& f,
+                 state->frameworks) {
           double cpu_share = f->cpus / (double) total_cpus;
           double mem_share = f->mem / (double) total_mem;
           double max_share = max(cpu_share, mem_share);
@@ -101,14 +107,13 @@ protected:
                << cpu_share << "#" << mem_share << "#" << max_share << endl;
         }
       }
-      delete state;
       tick++;
     }
     file.close();
   }
 
 public:
-  SharesPrinter(const PID &_master) : master(_master) {}
+  SharesPrinter(Master *_master) : master(_master) {}
   ~SharesPrinter() {}
 };
 
@@ -116,14 +121,24 @@ public:
 
 
 Master::Master()
-  : nextFrameworkId(0), nextSlaveId(0), nextSlotOfferId(0)
+  : offerTimeout(0), offersExpired(0), snapshotVersion(0),
+    snapshotInterval(1), nextSnapshot(0), recovering(false),
+    recoveryDeadline(0), recoverySlaves(0), slavesRecovered(0),
+    reregistrationRate(0), nextReregistration(0), stateLog(NULL),
+    nextFrameworkId(0), nextSlaveId(0), nextSlotOfferId(0), decoder(NULL),
+    renderer(NULL)
 {
   allocatorType = "simple";
 }
 
 
 Master::Master(const Params& conf_)
-  : conf(conf_), nextFrameworkId(0), nextSlaveId(0), nextSlotOfferId(0)
+  : conf(conf_), offerTimeout(0), offersExpired(0), snapshotVersion(0),
+    snapshotInterval(1), nextSnapshot(0), recovering(false),
+    recoveryDeadline(0), recoverySlaves(0), slavesRecovered(0),
+    reregistrationRate(0), nextReregistration(0), stateLog(NULL),
+    nextFrameworkId(0), nextSlaveId(0), nextSlotOfferId(0), decoder(NULL),
+    renderer(NULL)
 {
   allocatorType = conf.get("allocator", "simple");
 }
@@ -133,11 +148,15 @@ Master::~Master()
 {
   LOG(INFO) << "Shutting down master";
 
+  delete decoder;
+
+  delete renderer;
+
   delete allocator;
 
+  delete stateLog;
+
   foreachpair (_, Framework *framework, frameworks) {
-    foreachpair(_, Task *task, framework->tasks)
-      delete task;
     delete framework;
   }
 
@@ -157,44 +176,166 @@ void Master::registerOptions(Configurator* conf)
   conf->addOption<bool>("root_submissions",
                         "Can root submit frameworks?",
                         true);
+  conf->addOption<int>("decode_threads",
+                       "Number of threads decoding offer replies off of the\n"
+                       "master's thread (0 means decode them on the master's\n"
+                       "thread; otherwise a framework's kills, messages and\n"
+                       "unregistration wait for its replies being decoded)",
+                       0);
+  conf->addOption<double>("allocation_interval",
+                          "Seconds between timer ticks, on which filters\n"
+                          "expire and the allocator looks at every slave",
+                          1.0);
+  conf->addOption<bool>("batch_allocations",
+                        "Only allocate on timer ticks (or once enough\n"
+                        "slaves and frameworks have changed) rather than\n"
+                        "every time resources free up",
+                        false);
+  conf->addOption<int>("allocation_batch_size",
+                       "When batching allocations, allocate early once this\n"
+                       "many slaves and frameworks have changed (0 means\n"
+                       "only allocate on timer ticks)",
+                       0);
+  conf->addOption<double>("offer_timeout",
+                          "Seconds after which offers that frameworks haven't\n"
+                          "replied to are rescinded (0 means never)",
+                          0.0);
+  conf->addOption<int>("max_offers_per_framework",
+                       "Maximum number of offers that a framework can have\n"
+                       "outstanding at a time (0 means no limit)",
+                       MAX_OFFERS_PER_FRAMEWORK);
+  conf->addOption<bool>("allocation_thread",
+                        "Run allocation passes on their own thread, making\n"
+                        "offers once a pass is done if the slaves and\n"
+                        "frameworks involved are still around",
+                        false);
+  conf->addOption<bool>("spread_offers",
+                        "Split the free slaves across frameworks on each\n"
+                        "allocation pass (first up to each framework's fair\n"
+                        "share) instead of offering them all to one framework",
+                        false);
+  conf->addOption<int>("max_slaves_per_offer",
+                       "Maximum number of slaves in one offer (0 means no\n"
+                       "limit)",
+                       0);
+  conf->addOption<double>("snapshot_interval",
+                          "Seconds between the state snapshots read by the\n"
+                          "web UI, which are only taken if the last one was\n"
+                          "read, so the web UI's first look after a quiet\n"
+                          "spell can be older (0 means only take them when\n"
+                          "the state is requested with a message)",
+                          1.0);
+  conf->addOption<double>("recovery_timeout",
+                          "Seconds after starting during which no offers are\n"
+                          "made, so that slaves of a failed master can come\n"
+                          "back first (0 means no recovery period)",
+                          0.0);
+  conf->addOption<int>("recovery_slaves",
+                       "Number of re-registered slaves that ends the\n"
+                       "recovery period early (0 means wait for the timeout)",
+                       0);
+  conf->addOption<double>("reregistration_rate",
+                          "Maximum number of slaves to re-register per second\n"
+                          "(others wait their turn; 0 means no limit)",
+                          0.0);
+  conf->addOption<string>("state_dir",
+                          "Directory to record frameworks, slaves and tasks\n"
+                          "in, which a master started on it later (or taking\n"
+                          "over from this one) begins from (empty means don't\n"
+                          "record them)",
+                          "");
+  conf->addOption<int>("state_compaction",
+                       "Number of changes recorded in the state directory\n"
+                       "between snapshots of the whole state (0 means never;\n"
+                       "the state is serialized on the master's thread and\n"
+                       "written out on another)",
+                       10000);
 }
 
 
 state::MasterState * Master::getState()
 {
+  publishSnapshot();
+  return state::copySnapshot(*snapshots.get());
+}
+
+
+std::tr1::shared_ptr<const state::Snapshot> Master::getSnapshot()
+{
+  return snapshots.get();
+}
+
+
+void Master::publishSnapshot()
+{
+  std::tr1::shared_ptr<state::Snapshot> snapshot(new state::Snapshot());
+  snapshot->version = ++snapshotVersion;
+  snapshot->time = elapsed();
+  snapshot->build_date = BUILD_DATE;
+  snapshot->build_user = BUILD_USER;
   std::ostringstream oss;
   oss << self();
-  state::MasterState *state =
-    new state::MasterState(BUILD_DATE, BUILD_USER, oss.str());
+  snapshot->pid = oss.str();
+  snapshot->offers_expired = offersExpired;
 
+  // Slaves don't change once registered
   foreachpair (_, Slave *s, slaves) {
-    state::Slave *slave = new state::Slave(s->id, s->hostname, s->publicDns,
-        s->resources.cpus, s->resources.mem, s->connectTime);
-    state->slaves.push_back(slave);
+    std::tr1::shared_ptr<const state::Slave>& slave = slaveStates[s->id];
+    if (!slave)
+      slave.reset(new state::Slave(s->id, s->hostname, s->publicDns,
+                                   s->resources.cpus(), s->resources.mem(),
+                                   s->resources.disk(), s->resources.net(),
+                                   s->connectTime));
+    snapshot->slaves.push_back(slave);
   }
 
   foreachpair (_, Framework *f, frameworks) {
-    state::Framework *framework = new state::Framework(f->id, f->user,
-        f->name, f->executorInfo.uri, f->resources.cpus, f->resources.mem,
-        f->connectTime);
-    state->frameworks.push_back(framework);
-    foreachpair (_, Task *t, f->tasks) {
-      state::Task *task = new state::Task(t->id, t->name, t->frameworkId,
-          t->slaveId, t->state, t->resources.cpus, t->resources.mem);
-      framework->tasks.push_back(task);
-    }
-    foreach (SlotOffer *o, f->slotOffers) {
-      state::SlotOffer *offer = new state::SlotOffer(o->id, o->frameworkId);
-      foreach (SlaveResources &r, o->resources) {
-        state::SlaveResources *resources = new state::SlaveResources(
-            r.slave->id, r.resources.cpus, r.resources.mem);
-        offer->resources.push_back(resources);
+    pair<int64_t, std::tr1::shared_ptr<const state::Framework> >& copied =
+      frameworkStates[f->id];
+    if (!copied.second || copied.first != f->version) {
+      state::Framework *framework = new state::Framework(f->id, f->user,
+          f->name, f->executorInfo.uri, f->resources.cpus(), f->resources.mem(),
+          f->resources.disk(), f->resources.net(), f->connectTime);
+      foreachpair (_, TaskRecord *t, f->tasks) {
+        state::Task *task = new state::Task(t->id, taskTable.name(t),
+            taskTable.frameworkId(t), taskTable.slaveId(t), t->state,
+            t->resources.cpus(), t->resources.mem(), t->resources.disk(),
+            t->resources.net());
+        framework->tasks.push_back(task);
       }
-      framework->offers.push_back(offer);
+      foreach (SlotOffer *o, f->slotOffers) {
+        state::SlotOffer *offer =
+          new state::SlotOffer(o->id, o->frameworkId, 0, o->time);
+        foreach (SlaveResources &r, o->resources) {
+          state::SlaveResources *resources = new state::SlaveResources(
+              r.slave->id, r.resources.cpus(), r.resources.mem(),
+              r.resources.disk(), r.resources.net());
+          offer->resources.push_back(resources);
+        }
+        framework->offers.push_back(offer);
+      }
+      copied = make_pair(f->version,
+                         std::tr1::shared_ptr<const state::Framework>(framework));
     }
+    snapshot->frameworks.push_back(copied.second);
   }
-  
-  return state;
+
+  snapshots.publish(snapshot);
+}
+
+
+bool Framework::filters(Slave *slave, Resources resources)
+{
+  return slaveFilter.find(slave) != slaveFilter.end() ||
+    offerFilter.filters(slave->hostname, resources);
+}
+
+
+void Framework::resourcesChanged()
+{
+  version++;
+  if (allocator != NULL)
+    allocator->frameworkResourcesChanged(this);
 }
 
 
@@ -273,11 +414,55 @@ void Master::operator () ()
   if (!allocator)
     LOG(FATAL) << "Unrecognized allocator type: " << allocatorType;
 
-  link(spawn(new AllocatorTimer(self())));
-  //link(spawn(new SharesPrinter(self())));
+  int decodeThreads = conf.get<int>("decode_threads", 0);
+  if (decodeThreads > 0) {
+    LOG(INFO) << "Decoding offer replies with " << decodeThreads << " threads";
+    decoder = new DecoderPool(self(), decodeThreads);
+  }
+
+  double allocationInterval = conf.get<double>("allocation_interval", 1.0);
+  if (allocationInterval <= 0)
+    LOG(FATAL) << "Invalid allocation interval: " << allocationInterval;
+
+  offerTimeout = conf.get<double>("offer_timeout", 0.0);
+
+  string stateDir = conf.get("state_dir", "");
+  if (stateDir != "") {
+    stateLog = new StateLog(stateDir, conf.get<int>("state_compaction", 10000));
+    recoverState();
+  }
+
+  snapshotInterval = conf.get<double>("snapshot_interval", 1.0);
+  publishSnapshot();
+  nextSnapshot = elapsed() + snapshotInterval;
+
+  recoverySlaves = conf.get<int>("recovery_slaves", 0);
+  reregistrationRate = conf.get<double>("reregistration_rate", 0.0);
+  double recoveryTimeout = conf.get<double>("recovery_timeout", 0.0);
+  if (recoveryTimeout > 0) {
+    LOG(INFO) << "Not making offers for " << recoveryTimeout << " seconds"
+              << (recoverySlaves > 0 ? " or until " : "")
+              << (recoverySlaves > 0 ? lexical_cast<string>(recoverySlaves) +
+                  " slaves re-register" : "");
+    recovering = true;
+    recoveryDeadline = elapsed() + recoveryTimeout;
+  }
+
+  // Serve /master/state.json and /master/stats.json on our port
+  renderer = new HttpRenderer();
+  Process::route("/master", self());
+
+  link(spawn(new AllocatorTimer(self(), allocationInterval)));
+  //link(spawn(new SharesPrinter(this)));
 
   while (true) {
-    switch (receive()) {
+    double timeout = expireDeadlines();
+    switch (timeout > 0 ? receive(timeout) : receive()) {
+
+    case PROCESS_TIMEOUT: {
+      // Time to look at the deadlines again
+      break;
+    }
 
     case NEW_MASTER_DETECTED: {
       // TODO(benh): We might have been the master, but then got
@@ -350,6 +535,10 @@ void Master::operator () ()
         if (generation == 0) {
           LOG(INFO) << framework << " failed over";
           replaceFramework(frameworks[framework->id], framework);
+        } else if (frameworks[framework->id]->pid == framework->pid) {
+          // We recovered this framework from the state log
+          LOG(INFO) << framework << " came back after a master failover";
+          replaceFramework(frameworks[framework->id], framework);
         } else {
           LOG(INFO) << framework << " re-registering with an already "
 		    << "used id and not failing over!";
@@ -367,60 +556,74 @@ void Master::operator () ()
       // necessary because a framework scheduler has failed over, or
       // the master has failed over and the framework schedulers are
       // reregistering.
-      foreachpair (SlaveID slaveId, Slave *slave, slaves) {
-        foreachpair (_, Task *task, slave->tasks) {
-          if (framework->id == task->frameworkId) {
+      //
+      // Also tell each slave with an executor for this framework (even
+      // one that currently isn't running any tasks) the new framework
+      // pid; slaves tell us about their executors when re-registering.
+      if (executorSlaves.count(framework->id) > 0) {
+        foreach (const SlaveID& sid, executorSlaves[framework->id]) {
+          Slave *slave = lookupSlave(sid);
+          CHECK(slave != NULL);
+          foreach (TaskRecord *task, slave->taskList(framework->id))
             framework->addTask(task);
-          }
+          send(slave->pid, pack<M2S_UPDATE_FRAMEWORK_PID>(framework->id,
+                                                          framework->pid));
         }
       }
-
-      // Broadcast the new framework pid to all the slaves. We have to
-      // broadcast because an executor might be running on a slave but
-      // it currently isn't running any tasks. This could be a
-      // potential scalability issue ...
-      foreachpair (_, Slave *slave, slaves)
-	send(slave->pid, pack<M2S_UPDATE_FRAMEWORK_PID>(framework->id,
-							framework->pid));
       break;
     }
 
-    case F2M_UNREGISTER_FRAMEWORK: {
-      FrameworkID fid;
-      tie(fid) = unpack<F2M_UNREGISTER_FRAMEWORK>(body());
-      LOG(INFO) << "Asked to unregister framework " << fid;
-      Framework *framework = lookupFramework(fid);
-      if (framework != NULL && framework->pid == from())
-        removeFramework(framework);
+    case F2M_UNREGISTER_FRAMEWORK:
+    case F2M_KILL_TASK:
+    case F2M_FRAMEWORK_MESSAGE: {
+      // These might be about tasks in an offer reply from the same
+      // framework that's still being decoded, so wait for it
+      if (pendingDecodes.count(from()) > 0)
+        heldMessages[from()].push_back(make_pair(msgid(), body()));
       else
-        LOG(WARNING) << "Non-authoratative PID attempting framework "
-                     << "unregistration ... ignoring";
+        handleFrameworkMessage(from(), msgid(), body());
       break;
     }
 
     case F2M_SLOT_OFFER_REPLY: {
-      FrameworkID fid;
-      OfferID oid;
-      vector<TaskDescription> tasks;
-      Params params;
-      tie(fid, oid, tasks, params) = unpack<F2M_SLOT_OFFER_REPLY>(body());
-      Framework *framework = lookupFramework(fid);
-      if (framework != NULL) {
-        SlotOffer *offer = lookupSlotOffer(oid);
-        if (offer != NULL) {
-          processOfferReply(offer, tasks, params);
-        } else {
-          // The slot offer is gone, meaning that we rescinded it or that
-          // the slave was lost; immediately report any tasks in it as lost
-          foreach (const TaskDescription &t, tasks) {
-            send(framework->pid,
-                 pack<M2F_STATUS_UPDATE>(t.taskId, TASK_LOST, ""));
-          }
+      if (decoder != NULL) {
+        pendingDecodes[from()]++;
+        decoder->decodeOfferReply(from(), body());
+      } else {
+        OfferReply reply;
+        decodeOfferReply(body(), &reply);
+        handleOfferReply(reply);
+      }
+      break;
+    }
+
+    case M2M_DECODED_OFFER_REPLY: {
+      OfferReply *reply;
+      tie(reply) = unpack<M2M_DECODED_OFFER_REPLY>(body());
+      handleOfferReply(*reply);
+      PID from = reply->from;
+      delete reply;
+      // Handle what the sender sent after its last reply, in order
+      if (--pendingDecodes[from] == 0) {
+        pendingDecodes.erase(from);
+        if (heldMessages.count(from) > 0) {
+          std::deque<pair<MSGID, string> > held = heldMessages[from];
+          heldMessages.erase(from);
+          foreachpair (MSGID id, const string& data, held)
+            handleFrameworkMessage(from, id, data);
         }
       }
       break;
     }
 
+    case M2M_ALLOCATION: {
+      Allocation *allocation;
+      tie(allocation) = unpack<M2M_ALLOCATION>(body());
+      allocator->allocationFinished(*allocation);
+      delete allocation;
+      break;
+    }
+
     case F2M_REVIVE_OFFERS: {
       FrameworkID fid;
       tie(fid) = unpack<F2M_REVIVE_OFFERS>(body());
@@ -433,40 +636,28 @@ void Master::operator () ()
       break;
     }
 
-    case F2M_KILL_TASK: {
+    case F2M_HINTS: {
       FrameworkID fid;
-      TaskID tid;
-      tie(fid, tid) = unpack<F2M_KILL_TASK>(body());
+      Params hints;
+      tie(fid, hints) = unpack<F2M_HINTS>(body());
       Framework *framework = lookupFramework(fid);
       if (framework != NULL) {
-        Task *task = framework->lookupTask(tid);
-        if (task != NULL) {
-          LOG(INFO) << "Asked to kill " << task << " by its framework";
-          killTask(task);
-	} else {
-	  LOG(INFO) << "Asked to kill UNKNOWN task by its framework";
-	  send(framework->pid, pack<M2F_STATUS_UPDATE>(tid, TASK_LOST, ""));
+        LOG(INFO) << "Received hints from " << framework;
+        try {
+          framework->offerFilter = OfferFilter(hints);
+        } catch (bad_lexical_cast&) {
+          LOG(ERROR) << "Ignoring malformed hints from " << framework;
+          send(framework->pid, pack<M2F_ERROR>(1, "Malformed hints"));
+          break;
         }
-      }
-      break;
-    }
-
-    case F2M_FRAMEWORK_MESSAGE: {
-      FrameworkID fid;
-      FrameworkMessage message;
-      tie(fid, message) = unpack<F2M_FRAMEWORK_MESSAGE>(body());
-      Framework *framework = lookupFramework(fid);
-      if (framework != NULL) {
-        Slave *slave = lookupSlave(message.slaveId);
-        if (slave != NULL)
-          send(slave->pid, pack<M2S_FRAMEWORK_MESSAGE>(fid, message));
+        // The new filter may be looser than the old one
+        allocator->offersRevived(framework);
       }
       break;
     }
 
     case S2M_REGISTER_SLAVE: {
-      string slaveId = masterId + "-" + lexical_cast<string>(nextSlaveId++);
-      Slave *slave = new Slave(from(), slaveId, elapsed());
+      Slave *slave = new Slave(from(), newSlaveId(), elapsed());
       tie(slave->hostname, slave->publicDns, slave->resources) =
         unpack<S2M_REGISTER_SLAVE>(body());
       LOG(INFO) << "Registering " << slave << " at " << slave->pid;
@@ -475,48 +666,26 @@ void Master::operator () ()
       link(slave->pid);
       send(slave->pid,
 	   pack<M2S_REGISTER_REPLY>(slave->id, HEARTBEAT_INTERVAL));
+      heartbeatDeadlines.push(make_pair(elapsed() + HEARTBEAT_TIMEOUT,
+                                        slave->id));
+      logSlave(slave);
       allocator->slaveAdded(slave);
       break;
     }
 
     case S2M_REREGISTER_SLAVE: {
-      Slave *slave = new Slave(from(), "", elapsed());
-      vector<Task> tasks;
-      tie(slave->id, slave->hostname, slave->publicDns,
-          slave->resources, tasks) = unpack<S2M_REREGISTER_SLAVE>(body());
-
-      if (slave->id == "") {
-        slave->id = masterId + "-" + lexical_cast<string>(nextSlaveId++);
-        LOG(ERROR) << "Slave re-registered without a SlaveID, "
-                   << "generating a new id for it.";
-      }
-
-      LOG(INFO) << "Re-registering " << slave << " at " << slave->pid;
-      slaves[slave->id] = slave;
-      pidToSid[slave->pid] = slave->id;
-      link(slave->pid);
-      send(slave->pid,
-           pack<M2S_REREGISTER_REPLY>(slave->id, HEARTBEAT_INTERVAL));
-
-      allocator->slaveAdded(slave);
-
-      foreach (const Task &t, tasks) {
-        Task *task = new Task(t);
-        slave->addTask(task);
-
-        // Tell this slave the current framework pid for this task.
-        Framework *framework = lookupFramework(task->frameworkId);
-        if (framework != NULL) {
-          framework->addTask(task);
-          send(slave->pid, pack<M2S_UPDATE_FRAMEWORK_PID>(framework->id,
-                                                          framework->pid));
-        }
+      // Slaves recovered from the state log are cheap to take back, so
+      // only new ones wait their turn
+      if (reregistrationRate > 0 && pidToSid.count(from()) == 0) {
+        // Admitted from expireDeadlines when it's this slave's turn
+        if (stagedSlaves.empty())
+          nextReregistration = std::max(nextReregistration, elapsed());
+        stagedSlaves.push_back(make_pair(from(), body()));
+        VLOG(1) << "Staged re-registration from " << from() << " ("
+                << stagedSlaves.size() << " waiting)";
+      } else {
+        reregisterSlave(from(), body());
       }
-
-      // TODO(benh|alig): We should put a timeout on how long we keep
-      // tasks running that never have frameworks reregister that
-      // claim them.
-
       break;
     }
 
@@ -552,16 +721,12 @@ void Master::operator () ()
             break;
           }
           // Update the task state locally.
-          Task *task = slave->lookupTask(fid, tid);
+          TaskRecord *task = slave->lookupTask(fid, tid);
           if (task != NULL) {
-            LOG(INFO) << "Status update: " << task << " is in state " << state;
-            task->state = state;
-            // Remove the task if it finished or failed
-            if (state == TASK_FINISHED || state == TASK_FAILED ||
-                state == TASK_KILLED || state == TASK_LOST) {
-              LOG(INFO) << "Removing " << task << " because it's done";
-              removeTask(task, TRR_TASK_ENDED);
-            }
+            LOG_RATE_LIMITED(INFO) << "Status update: "
+                                   << taskTable.describe(task)
+                                   << " is in state " << state;
+            updateTaskState(framework, task, state);
           }
         } else {
           LOG(ERROR) << "S2M_FT_STATUS_UPDATE error: couldn't lookup "
@@ -574,6 +739,43 @@ void Master::operator () ()
       break;
     }
 
+    case S2M_FT_STATUS_UPDATES: {
+      SlaveID sid;
+      FrameworkID fid;
+      vector<TaskStatus> statuses;
+      tie(sid, fid, statuses) = unpack<S2M_FT_STATUS_UPDATES>(body());
+
+      VLOG(1) << "FT: prepare relay seq:"<< seq() << " from: "<< from();
+      if (Slave *slave = lookupSlave(sid)) {
+        if (Framework *framework = lookupFramework(fid)) {
+          // Pass on the whole batch to the framework
+          forward(framework->pid);
+          if (duplicate()) {
+            LOG(WARNING) << "FT: Locally ignoring duplicate message with id:" << seq();
+            break;
+          }
+          LOG_RATE_LIMITED(INFO) << "Status updates for " << statuses.size()
+                                 << " tasks of " << framework << " on "
+                                 << slave;
+          foreach (const TaskStatus& status, statuses) {
+            TaskRecord *task = slave->lookupTask(fid, status.taskId);
+            if (task != NULL) {
+              VLOG(1) << "Status update: " << taskTable.describe(task)
+                      << " is in state " << status.state;
+              updateTaskState(framework, task, status.state);
+            }
+          }
+        } else {
+          LOG(ERROR) << "S2M_FT_STATUS_UPDATES error: couldn't lookup "
+                     << "framework id " << fid;
+        }
+      } else {
+        LOG(ERROR) << "S2M_FT_STATUS_UPDATES error: couldn't lookup slave id "
+                   << sid;
+      }
+      break;
+    }
+
     case S2M_STATUS_UPDATE: {
       SlaveID sid;
       FrameworkID fid;
@@ -586,16 +788,12 @@ void Master::operator () ()
           // Pass on the status update to the framework
           send(framework->pid, pack<M2F_STATUS_UPDATE>(tid, state, data));
           // Update the task state locally
-          Task *task = slave->lookupTask(fid, tid);
+          TaskRecord *task = slave->lookupTask(fid, tid);
           if (task != NULL) {
-            LOG(INFO) << "Status update: " << task << " is in state " << state;
-            task->state = state;
-            // Remove the task if it finished or failed
-            if (state == TASK_FINISHED || state == TASK_FAILED ||
-                state == TASK_KILLED || state == TASK_LOST) {
-              LOG(INFO) << "Removing " << task << " because it's done";
-              removeTask(task, TRR_TASK_ENDED);
-            }
+            LOG_RATE_LIMITED(INFO) << "Status update: "
+                                   << taskTable.describe(task)
+                                   << " is in state " << state;
+            updateTaskState(framework, task, state);
           }
         } else {
           LOG(ERROR) << "S2M_STATUS_UPDATE error: couldn't lookup framework id "
@@ -626,7 +824,8 @@ void Master::operator () ()
       SlaveID sid;
       FrameworkID fid;
       int32_t status;
-      tie(sid, fid, status) = unpack<S2M_LOST_EXECUTOR>(body());
+      vector<TaskStatus> statuses;
+      tie(sid, fid, status, statuses) = unpack<S2M_LOST_EXECUTOR>(body());
       Slave *slave = lookupSlave(sid);
       if (slave != NULL) {
         Framework *framework = lookupFramework(fid);
@@ -640,23 +839,33 @@ void Master::operator () ()
                       << ") exited with status " << status;
           }
 
-          // Collect all the lost tasks for this framework.
-          set<Task*> tasks;
-          foreachpair (_, Task* task, framework->tasks)
-            if (task->slaveId == slave->id)
-              tasks.insert(task);
-
-          // Tell the framework they have been lost and remove them.
-          foreach (Task* task, tasks) {
-            send(framework->pid, pack<M2F_STATUS_UPDATE>(task->id, TASK_LOST,
-                                                         task->message));
-
-            LOG(INFO) << "Removing " << task << " because of lost executor";
-            removeTask(task, TRR_EXECUTOR_LOST);
+          // Pass on how the executor's tasks ended (the updates the
+          // slave was holding, and TASK_LOST for the ones that were
+          // running) and apply it. Tasks the slave didn't list ended
+          // in updates that got here before this.
+          if (statuses.size() == 1)
+            send(framework->pid, pack<M2F_STATUS_UPDATE>(statuses[0].taskId,
+                                                         statuses[0].state,
+                                                         statuses[0].data));
+          else if (statuses.size() > 1)
+            send(framework->pid, pack<M2F_STATUS_UPDATES>(statuses));
+
+          foreach (const TaskStatus& update, statuses) {
+            TaskRecord *task = slave->lookupTask(fid, update.taskId);
+            if (task == NULL)
+              continue;
+            if (update.state == TASK_LOST) {
+              LOG(INFO) << "Removing " << taskTable.describe(task)
+                        << " because of lost executor";
+              removeTask(task, TRR_EXECUTOR_LOST);
+            } else {
+              updateTaskState(framework, task, update.state);
+            }
           }
 
           // TODO(benh): Might we still want something like M2F_EXECUTOR_LOST?
         }
+        removeExecutor(slave, fid);
       }
       break;
     }
@@ -675,18 +884,6 @@ void Master::operator () ()
     }
 
     case M2M_TIMER_TICK: {
-      unordered_map<SlaveID, Slave *> slavesCopy = slaves;
-      foreachpair (_, Slave *slave, slavesCopy) {
-	if (slave->lastHeartbeat + HEARTBEAT_TIMEOUT <= elapsed()) {
-	  LOG(INFO) << slave << " missing heartbeats ... considering disconnected";
-	  removeSlave(slave);
-	}
-      }
-
-      // Check which framework filters can be expired.
-      foreachpair (_, Framework *framework, frameworks)
-        framework->removeExpiredFilters(elapsed());
-
       // Do allocations!
       allocator->timerTick();
 
@@ -743,6 +940,19 @@ void Master::operator () ()
       send(from(), pack<M2M_GET_STATE_REPLY>(getState()));
       break;
     }
+
+    case PROCESS_HTTP: {
+      size_t length;
+      const char *data = ReliableProcess::body(&length);
+      // Without periodic snapshots, or when the latest one has gone
+      // unread for a while (so no newer one was taken), take one now
+      // so it isn't stale
+      if (snapshotInterval <= 0 ||
+          snapshots.get()->time + snapshotInterval < elapsed())
+        publishSnapshot();
+      renderer->render(HttpRequest(data, length), snapshots.get());
+      break;
+    }
     
     case M2M_SHUTDOWN: {
       LOG(INFO) << "Asked to shut down by " << from();
@@ -764,21 +974,24 @@ OfferID Master::makeOffer(Framework *framework,
 {
   OfferID oid = masterId + "-" + lexical_cast<string>(nextSlotOfferId++);
 
-  SlotOffer *offer = new SlotOffer(oid, framework->id, resources);
+  SlotOffer *offer = new SlotOffer(oid, framework->id, resources, elapsed());
   slotOffers[offer->id] = offer;
+  if (offerTimeout > 0)
+    offerDeadlines.push(make_pair(offer->time + offerTimeout, offer->id));
   framework->addOffer(offer);
   foreach (const SlaveResources& r, resources) {
     r.slave->slotOffers.insert(offer);
     r.slave->resourcesOffered += r.resources;
+    addInterest(r.slave, framework->id);
   }
-  LOG(INFO) << "Sending " << offer << " to " << framework;
+  LOG_RATE_LIMITED(INFO) << "Sending " << offer << " to " << framework;
   vector<SlaveOffer> offers;
   map<SlaveID, PID> pids;
   foreach (const SlaveResources& r, resources) {
-    Params params;
-    params.set("cpus", r.resources.cpus);
-    params.set("mem", r.resources.mem);
-    SlaveOffer offer(r.slave->id, r.slave->hostname, params.getMap());
+    map<string, string> params;
+    r.resources.writeParams(&params);
+    SlaveOffer offer(r.slave->id, r.slave->hostname, r.resources.cpus(),
+                     r.resources.mem(), params);
     offers.push_back(offer);
     pids[r.slave->id] = r.slave->pid;
   }
@@ -787,13 +1000,85 @@ OfferID Master::makeOffer(Framework *framework,
 }
 
 
+void Master::handleFrameworkMessage(const PID& from, MSGID id,
+                                    const string& body)
+{
+  switch (id) {
+    case F2M_UNREGISTER_FRAMEWORK: {
+      FrameworkID fid;
+      tie(fid) = unpack<F2M_UNREGISTER_FRAMEWORK>(body);
+      LOG(INFO) << "Asked to unregister framework " << fid;
+      Framework *framework = lookupFramework(fid);
+      if (framework != NULL && framework->pid == from)
+        removeFramework(framework);
+      else
+        LOG(WARNING) << "Non-authoratative PID attempting framework "
+                     << "unregistration ... ignoring";
+      break;
+    }
+
+    case F2M_KILL_TASK: {
+      FrameworkID fid;
+      TaskID tid;
+      tie(fid, tid) = unpack<F2M_KILL_TASK>(body);
+      Framework *framework = lookupFramework(fid);
+      if (framework != NULL) {
+        TaskRecord *task = framework->lookupTask(tid);
+        if (task != NULL) {
+          LOG(INFO) << "Asked to kill " << taskTable.describe(task)
+                    << " by its framework";
+          killTask(task);
+        } else {
+          LOG(INFO) << "Asked to kill UNKNOWN task by its framework";
+          send(framework->pid, pack<M2F_STATUS_UPDATE>(tid, TASK_LOST, ""));
+        }
+      }
+      break;
+    }
+
+    case F2M_FRAMEWORK_MESSAGE: {
+      FrameworkID fid;
+      FrameworkMessage message;
+      tie(fid, message) = unpack<F2M_FRAMEWORK_MESSAGE>(body);
+      Framework *framework = lookupFramework(fid);
+      if (framework != NULL) {
+        Slave *slave = lookupSlave(message.slaveId);
+        if (slave != NULL)
+          send(slave->pid, pack<M2S_FRAMEWORK_MESSAGE>(fid, message));
+      }
+      break;
+    }
+  }
+}
+
+
+void Master::handleOfferReply(const OfferReply& reply)
+{
+  Framework *framework = lookupFramework(reply.frameworkId);
+  if (framework != NULL) {
+    SlotOffer *offer = lookupSlotOffer(reply.offerId);
+    if (offer != NULL) {
+      processOfferReply(offer, reply);
+    } else {
+      // The slot offer is gone, meaning that we rescinded it or that
+      // the slave was lost; immediately report any tasks in it as lost
+      foreach (const TaskDescription &t, reply.tasks) {
+        send(framework->pid,
+             pack<M2F_STATUS_UPDATE>(t.taskId, TASK_LOST, ""));
+      }
+    }
+  }
+}
+
+
 // Process a resource offer reply (for a non-cancelled offer) by launching
 // the desired tasks (if the offer contains a valid set of tasks) and
 // reporting any unused resources to the allocator
-void Master::processOfferReply(SlotOffer *offer,
-    const vector<TaskDescription>& tasks, const Params& params)
+void Master::processOfferReply(SlotOffer *offer, const OfferReply& reply)
 {
-  LOG(INFO) << "Received reply for " << offer;
+  const vector<TaskDescription>& tasks = reply.tasks;
+
+  LOG_RATE_LIMITED(INFO) << "Received reply for " << offer;
 
   Framework *framework = lookupFramework(offer->frameworkId);
   CHECK(framework != NULL);
@@ -806,13 +1091,12 @@ void Master::processOfferReply(SlotOffer *offer,
 
   // Count resources in the response, and check that its tasks are valid
   unordered_map<Slave *, Resources> responseResources;
-  foreach (const TaskDescription &t, tasks) {
+  for (size_t i = 0; i < tasks.size(); i++) {
+    const TaskDescription &t = tasks[i];
+    const Resources &res = reply.resources[i];
     // Check whether this task size is valid
-    Params params(t.params);
-    Resources res(params.getInt32("cpus", -1),
-                  params.getInt32("mem", -1));
-    if (res.cpus < MIN_CPUS || res.mem < MIN_MEM || 
-        res.cpus > MAX_CPUS || res.mem > MAX_MEM) {
+    if (res.cpus() < MIN_CPUS || res.mem() < MIN_MEM || 
+        res.cpus() > MAX_CPUS || res.mem() > MAX_MEM || res.anyNegative()) {
       terminateFramework(framework, 0,
           "Invalid task size: " + lexical_cast<string>(res));
       return;
@@ -829,7 +1113,7 @@ void Master::processOfferReply(SlotOffer *offer,
   // Check that the total accepted on each slave isn't more than offered
   foreachpair (Slave *s, Resources& respRes, responseResources) {
     Resources &offRes = offerResources[s];
-    if (respRes.cpus > offRes.cpus || respRes.mem > offRes.mem) {
+    if (!respRes.fitsIn(offRes)) {
       terminateFramework(framework, 0, "Too many resources accepted");
       return;
     }
@@ -847,25 +1131,44 @@ void Master::processOfferReply(SlotOffer *offer,
     idsInResponse.insert(t.taskId);
   }
 
-  // Launch the tasks in the response
-  foreach (const TaskDescription &t, tasks) {
-    launchTask(framework, t);
+  // Launch the tasks in the response, sending each slave all of its
+  // tasks in one message (after the framework's executor info, if the
+  // slave doesn't have an executor for the framework already)
+  unordered_map<Slave *, vector<TaskDescription> > launches;
+  for (size_t i = 0; i < tasks.size(); i++) {
+    Slave *slave = lookupSlave(tasks[i].slaveId);
+    if (launches.count(slave) == 0 &&
+        slave->executors.count(framework->id) == 0) {
+      send(slave->pid, pack<M2S_ADD_FRAMEWORK>(
+            framework->id, framework->name, framework->user,
+            framework->executorInfo, framework->pid));
+    }
+    launches[slave].push_back(tasks[i]);
+    launchTask(framework, tasks[i], reply.resources[i]);
+  }
+  foreachpair (Slave *slave, const vector<TaskDescription>& launched,
+               launches) {
+    send(slave->pid, pack<M2S_RUN_TASKS>(framework->id, launched));
   }
 
   // If there are resources left on some slaves, add filters for them
   vector<SlaveResources> resourcesLeft;
-  int timeout = params.getInt32("timeout", DEFAULT_REFUSAL_TIMEOUT);
+  int timeout = reply.params.getInt32("timeout", DEFAULT_REFUSAL_TIMEOUT);
   double expiry = (timeout == -1) ? 0 : elapsed() + timeout;
   foreachpair (Slave *s, Resources offRes, offerResources) {
     Resources respRes = responseResources[s];
     Resources left = offRes - respRes;
-    if (left.cpus > 0 || left.mem > 0) {
+    if (left.anyPositive()) {
       resourcesLeft.push_back(SlaveResources(s, left));
     }
-    if (timeout != 0 && respRes.cpus == 0 && respRes.mem == 0) {
-      LOG(INFO) << "Adding filter on " << s << " to " << framework
-                << " for  " << timeout << " seconds";
+    if (timeout != 0 && respRes.isZero()) {
+      LOG_RATE_LIMITED(INFO) << "Adding filter on " << s << " to "
+                             << framework << " for  " << timeout
+                             << " seconds";
       framework->slaveFilter[s] = expiry;
+      if (expiry != 0)
+        filterDeadlines.push(make_pair(expiry, make_pair(framework->id,
+                                                         s->id)));
     }
   }
   
@@ -874,30 +1177,29 @@ void Master::processOfferReply(SlotOffer *offer,
 }
 
 
-void Master::launchTask(Framework *framework, const TaskDescription& t)
+void Master::launchTask(Framework *framework, const TaskDescription& t,
+                        const Resources& res)
 {
-  Params params(t.params);
-  Resources res(params.getInt32("cpus", -1),
-                params.getInt32("mem", -1));
-
   // The invariant right now is that launchTask is called only for
   // TaskDescriptions where the slave is still valid (see the code
   // above in processOfferReply).
   Slave *slave = lookupSlave(t.slaveId);
   CHECK(slave != NULL);
 
-  Task *task = new Task(t.taskId, framework->id, res, TASK_STARTING,
-                        t.name, "", slave->id);
+  TaskRecord *task = taskTable.add(t.taskId, framework->id, res,
+                                   TASK_STARTING, t.name, slave->id);
 
   framework->addTask(task);
-  slave->addTask(task);
+  slave->addTask(framework->id, task);
+  addExecutor(slave, framework->id);
+
+  if (stateLog != NULL)
+    stateLog->addTask(taskTable.task(task));
 
   allocator->taskAdded(task);
 
-  LOG(INFO) << "Launching " << task << " on " << slave;
-  send(slave->pid, pack<M2S_RUN_TASK>(
-        framework->id, t.taskId, framework->name, framework->user,
-        framework->executorInfo, t.name, t.data, t.params, framework->pid));
+  LOG_RATE_LIMITED(INFO) << "Launching " << taskTable.describe(task)
+                         << " on " << slave;
 }
 
 
@@ -907,11 +1209,11 @@ void Master::rescindOffer(SlotOffer *offer)
 }
 
 
-void Master::killTask(Task *task)
+void Master::killTask(TaskRecord *task)
 {
-  LOG(INFO) << "Killing " << task;
-  Framework *framework = lookupFramework(task->frameworkId);
-  Slave *slave = lookupSlave(task->slaveId);
+  LOG_RATE_LIMITED(INFO) << "Killing " << taskTable.describe(task);
+  Framework *framework = lookupFramework(taskTable.frameworkId(task));
+  Slave *slave = lookupSlave(taskTable.slaveId(task));
   CHECK(framework != NULL);
   CHECK(slave != NULL);
   send(slave->pid, pack<M2S_KILL_TASK>(framework->id, task->id));
@@ -971,6 +1273,9 @@ void Master::addFramework(Framework *framework)
 
   send(framework->pid, pack<M2F_REGISTER_REPLY>(framework->id));
 
+  logFramework(framework);
+
+  framework->allocator = allocator;
   allocator->frameworkAdded(framework);
 }
 
@@ -988,10 +1293,16 @@ void Master::replaceFramework(Framework *old, Framework *current)
     removeSlotOffer(offer, ORR_FRAMEWORK_FAILOVER, offer->resources);
   }
 
-  send(old->pid, pack<M2F_ERROR>(1, "Framework failover"));
+  // A framework recovered from the state log is replaced by the same
+  // scheduler re-registering, which shouldn't be told to go away
+  if (old->pid != current->pid)
+    send(old->pid, pack<M2F_ERROR>(1, "Framework failover"));
 
   // TODO(benh): unlink(old->pid);
   pidToFid.erase(old->pid);
+  frameworks.erase(old->id);
+  frameworkStates.erase(old->id);
+  allocator->frameworkRemoved(old);
   delete old;
 
   frameworks[current->id] = current;
@@ -999,6 +1310,332 @@ void Master::replaceFramework(Framework *old, Framework *current)
   link(current->pid);
 
   send(current->pid, pack<M2F_REGISTER_REPLY>(current->id));
+
+  logFramework(current);
+
+  current->allocator = allocator;
+  allocator->frameworkAdded(current);
+}
+
+
+void Master::addExecutor(Slave *slave, const FrameworkID& frameworkId)
+{
+  slave->executors.insert(frameworkId);
+  addInterest(slave, frameworkId);
+  executorSlaves[frameworkId].insert(slave->id);
+}
+
+
+void Master::addInterest(Slave *slave, const FrameworkID& frameworkId)
+{
+  slave->interested.insert(frameworkId);
+  interestingSlaves[frameworkId].insert(slave->id);
+}
+
+
+void Master::removeExecutor(Slave *slave, const FrameworkID& frameworkId)
+{
+  CHECK(slave != NULL);
+  slave->executors.erase(frameworkId);
+  if (executorSlaves.count(frameworkId) > 0) {
+    executorSlaves[frameworkId].erase(slave->id);
+    if (executorSlaves[frameworkId].empty())
+      executorSlaves.erase(frameworkId);
+  }
+}
+
+
+double Master::expireDeadlines()
+{
+  double now = elapsed();
+
+  while (!heartbeatDeadlines.empty() &&
+         heartbeatDeadlines.top().first <= now) {
+    SlaveID sid = heartbeatDeadlines.top().second;
+    heartbeatDeadlines.pop();
+    Slave *slave = lookupSlave(sid);
+    if (slave == NULL)
+      continue; // Already removed
+    double deadline = slave->lastHeartbeat + HEARTBEAT_TIMEOUT;
+    if (deadline <= now) {
+      LOG(INFO) << slave << " missing heartbeats ... considering disconnected";
+      removeSlave(slave);
+    } else {
+      heartbeatDeadlines.push(make_pair(deadline, sid));
+    }
+  }
+
+  while (!filterDeadlines.empty() && filterDeadlines.top().first <= now) {
+    double expiry = filterDeadlines.top().first;
+    Framework *framework = lookupFramework(filterDeadlines.top().second.first);
+    Slave *slave = lookupSlave(filterDeadlines.top().second.second);
+    filterDeadlines.pop();
+    if (framework == NULL || slave == NULL)
+      continue;
+    // Skip filters that have since been removed or replaced
+    unordered_map<Slave *, double>::iterator it =
+      framework->slaveFilter.find(slave);
+    if (it == framework->slaveFilter.end() || it->second != expiry)
+      continue;
+    VLOG(1) << "Filter on " << slave << " for " << framework << " expired";
+    framework->slaveFilter.erase(it);
+    allocator->filterExpired(framework, slave);
+  }
+
+  while (!offerDeadlines.empty() && offerDeadlines.top().first <= now) {
+    SlotOffer *offer = lookupSlotOffer(offerDeadlines.top().second);
+    offerDeadlines.pop();
+    if (offer == NULL)
+      continue; // Already replied to or removed
+    LOG(INFO) << "Rescinding " << offer << " since it was made "
+              << offerTimeout << " seconds ago";
+    offersExpired++;
+    rescindOffer(offer);
+  }
+
+  while (!stagedSlaves.empty() && nextReregistration <= now) {
+    reregisterSlave(stagedSlaves.front().first, stagedSlaves.front().second);
+    stagedSlaves.pop_front();
+    nextReregistration += 1.0 / reregistrationRate;
+  }
+
+  if (recovering && recoveryDeadline <= now) {
+    LOG(INFO) << "Recovery timed out";
+    finishRecovery();
+  }
+
+  if (snapshotInterval > 0 && nextSnapshot <= now) {
+    if (snapshots.wasRead())
+      publishSnapshot();
+    nextSnapshot = now + snapshotInterval;
+  }
+
+  double next = 0;
+  if (snapshotInterval > 0)
+    next = nextSnapshot;
+  if (!heartbeatDeadlines.empty() &&
+      (next == 0 || heartbeatDeadlines.top().first < next))
+    next = heartbeatDeadlines.top().first;
+  if (!filterDeadlines.empty() &&
+      (next == 0 || filterDeadlines.top().first < next))
+    next = filterDeadlines.top().first;
+  if (!offerDeadlines.empty() &&
+      (next == 0 || offerDeadlines.top().first < next))
+    next = offerDeadlines.top().first;
+  if (!stagedSlaves.empty() && (next == 0 || nextReregistration < next))
+    next = nextReregistration;
+  if (recovering && (next == 0 || recoveryDeadline < next))
+    next = recoveryDeadline;
+
+  return next == 0 ? 0 : next - now;
+}
+
+
+void Master::reregisterSlave(const PID& pid, const string& data)
+{
+  Slave *slave = new Slave(pid, "", elapsed());
+  vector<Task> tasks;
+  vector<FrameworkID> frameworkIds;
+  tie(slave->id, slave->hostname, slave->publicDns,
+      slave->resources, tasks, frameworkIds) =
+    unpack<S2M_REREGISTER_SLAVE>(data);
+
+  if (slave->id == "") {
+    slave->id = newSlaveId();
+    LOG(ERROR) << "Slave re-registered without a SlaveID, "
+               << "generating a new id for it.";
+  }
+
+  if (Slave *known = lookupSlave(slave->id)) {
+    // We recovered this slave from the state log (or it re-registered
+    // twice), so keep it but believe it about which tasks are running
+    delete slave;
+    slave = known;
+    LOG(INFO) << "Re-registering known " << slave << " at " << pid;
+    pidToSid.erase(slave->pid);
+    slave->pid = pid;
+    slave->lastHeartbeat = elapsed();
+    pidToSid[slave->pid] = slave->id;
+    link(slave->pid);
+    send(slave->pid,
+         pack<M2S_REREGISTER_REPLY>(slave->id, HEARTBEAT_INTERVAL));
+    logSlave(slave);
+
+    set<pair<FrameworkID, TaskID> > running;
+    foreach (const Task &t, tasks) {
+      running.insert(make_pair(t.frameworkId, t.id));
+      TaskRecord *task = slave->lookupTask(t.frameworkId, t.id);
+      if (task == NULL) {
+        addReregisteredTask(slave, t);
+      } else if (task->state != t.state) {
+        task->state = t.state;
+        if (Framework *framework = lookupFramework(t.frameworkId))
+          framework->version++;
+        if (stateLog != NULL)
+          stateLog->updateTask(t.frameworkId, task->id, task->state);
+      }
+    }
+
+    foreach (TaskRecord *task, slave->taskList()) {
+      const FrameworkID& fid = taskTable.frameworkId(task);
+      if (running.count(make_pair(fid, task->id)) == 0) {
+        LOG(INFO) << "Removing " << taskTable.describe(task) << " because "
+                  << slave << " doesn't have it anymore";
+        if (Framework *framework = lookupFramework(fid))
+          send(framework->pid, pack<M2F_STATUS_UPDATE>(task->id, TASK_LOST,
+                                                       ""));
+        removeTask(task, TRR_TASK_ENDED);
+      }
+    }
+  } else {
+    LOG(INFO) << "Re-registering " << slave << " at " << slave->pid;
+    slaves[slave->id] = slave;
+    slaveStates.erase(slave->id);
+    pidToSid[slave->pid] = slave->id;
+    link(slave->pid);
+    send(slave->pid,
+         pack<M2S_REREGISTER_REPLY>(slave->id, HEARTBEAT_INTERVAL));
+    heartbeatDeadlines.push(make_pair(elapsed() + HEARTBEAT_TIMEOUT,
+                                      slave->id));
+    logSlave(slave);
+
+    allocator->slaveAdded(slave);
+
+    foreach (const Task &t, tasks)
+      addReregisteredTask(slave, t);
+  }
+
+  // Tell this slave the current pid of each framework that has an
+  // executor on it (all in one message).
+  foreach (const FrameworkID& fid, frameworkIds)
+    addExecutor(slave, fid);
+
+  map<FrameworkID, PID> pids;
+  foreach (const FrameworkID& fid, slave->executors) {
+    Framework *framework = lookupFramework(fid);
+    if (framework != NULL)
+      pids[framework->id] = framework->pid;
+  }
+  if (!pids.empty())
+    send(slave->pid, pack<M2S_UPDATE_FRAMEWORK_PIDS>(pids));
+
+  // TODO(benh|alig): We should put a timeout on how long we keep
+  // tasks running that never have frameworks reregister that
+  // claim them.
+
+  slavesRecovered++;
+  if (recovering && recoverySlaves > 0 && slavesRecovered >= recoverySlaves) {
+    LOG(INFO) << slavesRecovered << " slaves re-registered";
+    finishRecovery();
+  }
+}
+
+
+void Master::addReregisteredTask(Slave *slave, const Task& t)
+{
+  TaskRecord *task = taskTable.add(t);
+  slave->addTask(t.frameworkId, task);
+  addExecutor(slave, t.frameworkId);
+
+  Framework *framework = lookupFramework(t.frameworkId);
+  if (framework != NULL)
+    framework->addTask(task);
+
+  if (stateLog != NULL)
+    stateLog->addTask(taskTable.task(task));
+}
+
+
+void Master::finishRecovery()
+{
+  LOG(INFO) << "Recovery finished with " << slaves.size() << " slaves, "
+            << stagedSlaves.size() << " more waiting to re-register";
+  recovering = false;
+  allocator->recoveryFinished();
+}
+
+
+void Master::recoverState()
+{
+  const LoggedState& state = stateLog->getState();
+
+  nextFrameworkId = state.nextFrameworkId;
+  nextSlaveId = state.nextSlaveId;
+
+  // Add the slaves and their tasks before the frameworks, since adding
+  // a framework makes the allocator offer whatever is free right away
+  foreachpair (_, const LoggedSlave& s, state.slaves) {
+    Slave *slave = new Slave(s.pid, s.id, elapsed());
+    slave->hostname = s.hostname;
+    slave->publicDns = s.publicDns;
+    slave->resources = s.resources;
+    LOG(INFO) << "Recovered " << slave << " at " << slave->pid;
+    slaves[slave->id] = slave;
+    pidToSid[slave->pid] = slave->id;
+    link(slave->pid);
+    heartbeatDeadlines.push(make_pair(elapsed() + HEARTBEAT_TIMEOUT,
+                                      slave->id));
+    allocator->slaveAdded(slave);
+  }
+
+  foreachpair (_, const LoggedTask& t, state.tasks) {
+    Slave *slave = lookupSlave(t.slaveId);
+    if (slave == NULL)
+      continue;
+    TaskRecord *task = taskTable.add(t.id, t.frameworkId, t.resources,
+                                     t.state, t.name, t.slaveId);
+    slave->addTask(t.frameworkId, task);
+    addExecutor(slave, t.frameworkId);
+  }
+
+  // The frameworks get no offers until their schedulers re-register
+  // with us, which replaces them with active ones
+  foreachpair (_, const LoggedFramework& f, state.frameworks) {
+    Framework *framework = new Framework(f.pid, f.id, elapsed());
+    framework->name = f.name;
+    framework->user = f.user;
+    framework->executorInfo = f.executorInfo;
+    framework->active = false;
+    LOG(INFO) << "Recovered " << framework << " at " << framework->pid;
+    frameworks[framework->id] = framework;
+    pidToFid[framework->pid] = framework->id;
+    link(framework->pid);
+    if (executorSlaves.count(framework->id) > 0) {
+      foreach (const SlaveID& sid, executorSlaves[framework->id])
+        foreach (TaskRecord *task, lookupSlave(sid)->taskList(framework->id))
+          framework->addTask(task);
+    }
+    framework->allocator = allocator;
+    allocator->frameworkAdded(framework);
+  }
+}
+
+
+void Master::logFramework(Framework *framework)
+{
+  if (stateLog != NULL) {
+    LoggedFramework logged;
+    logged.id = framework->id;
+    logged.name = framework->name;
+    logged.user = framework->user;
+    logged.executorInfo = framework->executorInfo;
+    logged.pid = framework->pid;
+    stateLog->addFramework(logged);
+  }
+}
+
+
+void Master::logSlave(Slave *slave)
+{
+  if (stateLog != NULL) {
+    LoggedSlave logged;
+    logged.id = slave->id;
+    logged.hostname = slave->hostname;
+    logged.publicDns = slave->publicDns;
+    logged.resources = slave->resources;
+    logged.pid = slave->pid;
+    stateLog->addSlave(logged);
+  }
 }
 
 
@@ -1009,14 +1646,16 @@ void Master::removeFramework(Framework *framework)
   framework->active = false;
   // TODO: Notify allocator that a framework removal is beginning?
   
-  // Tell slaves to kill the framework
-  foreachpair (_, Slave *slave, slaves)
-    send(slave->pid, pack<M2S_KILL_FRAMEWORK>(framework->id));
+  // Tell the slaves with executors for the framework to kill it
+  if (executorSlaves.count(framework->id) > 0) {
+    foreach (const SlaveID& sid, executorSlaves[framework->id])
+      send(lookupSlave(sid)->pid, pack<M2S_KILL_FRAMEWORK>(framework->id));
+  }
 
   // Remove pointers to the framework's tasks in slaves
-  unordered_map<TaskID, Task *> tasksCopy = framework->tasks;
-  foreachpair (_, Task *task, tasksCopy) {
-    Slave *slave = lookupSlave(task->slaveId);
+  unordered_map<TaskID, TaskRecord *> tasksCopy = framework->tasks;
+  foreachpair (_, TaskRecord *task, tasksCopy) {
+    Slave *slave = lookupSlave(taskTable.slaveId(task));
     CHECK(slave != NULL);
     removeTask(task, TRR_FRAMEWORK_LOST);
   }
@@ -1027,14 +1666,35 @@ void Master::removeFramework(Framework *framework)
     removeSlotOffer(offer, ORR_FRAMEWORK_LOST, offer->resources);
   }
 
+  // The slaves will kill the framework's executors
+  if (executorSlaves.count(framework->id) > 0) {
+    unordered_set<SlaveID> sids = executorSlaves[framework->id];
+    foreach (const SlaveID& sid, sids)
+      removeExecutor(lookupSlave(sid), framework->id);
+  }
+
+  // Don't tell the framework about slaves it will never hear of again
+  if (interestingSlaves.count(framework->id) > 0) {
+    foreach (const SlaveID& sid, interestingSlaves[framework->id]) {
+      Slave *slave = lookupSlave(sid);
+      if (slave != NULL)
+        slave->interested.erase(framework->id);
+    }
+    interestingSlaves.erase(framework->id);
+  }
+
   // TODO(benh): Similar code between removeFramework and
   // replaceFramework needs to be shared!
 
   // TODO(benh): unlink(framework->pid);
   pidToFid.erase(framework->pid);
 
+  if (stateLog != NULL)
+    stateLog->removeFramework(framework->id);
+
   // Delete it
   frameworks.erase(framework->id);
+  frameworkStates.erase(framework->id);
   allocator->frameworkRemoved(framework);
   delete framework;
 }
@@ -1046,10 +1706,11 @@ void Master::removeSlave(Slave *slave)
   slave->active = false;
   // TODO: Notify allocator that a slave removal is beginning?
   
-  // Remove pointers to slave's tasks in frameworks, and send status updates
-  unordered_map<pair<FrameworkID, TaskID>, Task *> tasksCopy = slave->tasks;
-  foreachpair (_, Task *task, tasksCopy) {
-    Framework *framework = lookupFramework(task->frameworkId);
+  // Remove pointers to slave's tasks in frameworks, and send status
+  // updates (one message per framework)
+  map<FrameworkID, vector<TaskStatus> > lost;
+  foreach (TaskRecord *task, slave->taskList()) {
+    Framework *framework = lookupFramework(taskTable.frameworkId(task));
     // A framework might not actually exist because the master failed
     // over and the framework hasn't reconnected. This can be a tricky
     // situation for frameworks that want to have high-availability,
@@ -1059,10 +1720,19 @@ void Master::removeSlave(Slave *slave)
     // framework until it fails over. See the TODO above in
     // S2M_REREGISTER_SLAVE.
     if (framework != NULL)
-      send(framework->pid, pack<M2F_STATUS_UPDATE>(task->id, TASK_LOST,
-						   task->message));
+      lost[framework->id].push_back(TaskStatus(task->id, TASK_LOST, ""));
     removeTask(task, TRR_SLAVE_LOST);
   }
+  foreachpair (const FrameworkID& fid, const vector<TaskStatus>& statuses,
+               lost) {
+    Framework *framework = lookupFramework(fid);
+    if (statuses.size() == 1)
+      send(framework->pid, pack<M2F_STATUS_UPDATE>(statuses[0].taskId,
+                                                   TASK_LOST,
+                                                   statuses[0].data));
+    else
+      send(framework->pid, pack<M2F_STATUS_UPDATES>(statuses));
+  }
 
   // Remove slot offers from the slave; this will also rescind them
   unordered_set<SlotOffer *> slotOffersCopy = slave->slotOffers;
@@ -1077,36 +1747,73 @@ void Master::removeSlave(Slave *slave)
     removeSlotOffer(offer, ORR_SLAVE_LOST, otherSlaveResources);
   }
   
-  // Remove slave from any filters
-  foreachpair (_, Framework *framework, frameworks)
-    framework->slaveFilter.erase(slave);
-  
-  // Send lost-slave message to all frameworks (this helps them re-run
-  // previously finished tasks whose output was on the lost slave)
-  foreachpair (_, Framework *framework, frameworks)
-    send(framework->pid, pack<M2F_LOST_SLAVE>(slave->id));
+  // Forget about the executors on the slave
+  unordered_set<FrameworkID> fids = slave->executors;
+  foreach (const FrameworkID& fid, fids)
+    removeExecutor(slave, fid);
+
+  // Remove slave from any filters (which only frameworks that were
+  // offered the slave can have) and send lost-slave message to the
+  // frameworks that know about it (this helps them re-run previously
+  // finished tasks whose output was on the lost slave)
+  foreach (const FrameworkID& fid, slave->interested) {
+    Framework *framework = lookupFramework(fid);
+    if (framework != NULL) {
+      framework->slaveFilter.erase(slave);
+      send(framework->pid, pack<M2F_LOST_SLAVE>(slave->id));
+    }
+    if (interestingSlaves.count(fid) > 0) {
+      interestingSlaves[fid].erase(slave->id);
+      if (interestingSlaves[fid].empty())
+        interestingSlaves.erase(fid);
+    }
+  }
 
   // TODO(benh): unlink(slave->pid);
   pidToSid.erase(slave->pid);
 
+  if (stateLog != NULL)
+    stateLog->removeSlave(slave->id);
+
   // Delete it
   slaves.erase(slave->id);
+  slaveStates.erase(slave->id);
   allocator->slaveRemoved(slave);
   delete slave;
 }
 
 
 // Remove a slot offer (because it was replied or we lost a framework or slave)
-void Master::removeTask(Task *task, TaskRemovalReason reason)
+void Master::removeTask(TaskRecord *task, TaskRemovalReason reason)
 {
-  Framework *framework = lookupFramework(task->frameworkId);
-  Slave *slave = lookupSlave(task->slaveId);
-  CHECK(framework != NULL);
+  const FrameworkID& fid = taskTable.frameworkId(task);
+  Framework *framework = lookupFramework(fid);
+  Slave *slave = lookupSlave(taskTable.slaveId(task));
   CHECK(slave != NULL);
-  framework->removeTask(task->id);
-  slave->removeTask(task);
+  // The framework might not have re-registered since a master failover
+  if (framework != NULL)
+    framework->removeTask(task->id);
+  slave->removeTask(fid, task);
+  if (stateLog != NULL)
+    stateLog->removeTask(fid, task->id);
   allocator->taskRemoved(task, reason);
-  delete task;
+  taskTable.remove(task);
+}
+
+
+// Record a task's new state, removing the task if it's done
+void Master::updateTaskState(Framework *framework, TaskRecord *task,
+                             TaskState state)
+{
+  task->state = state;
+  framework->version++;
+  if (stateLog != NULL)
+    stateLog->updateTask(framework->id, task->id, state);
+  if (state == TASK_FINISHED || state == TASK_FAILED ||
+      state == TASK_KILLED || state == TASK_LOST) {
+    VLOG(1) << "Removing " << taskTable.describe(task) << " because it's done";
+    removeTask(task, TRR_TASK_ENDED);
+  }
 }
 
 
@@ -1123,13 +1830,39 @@ Allocator* Master::createAllocator()
 FrameworkID Master::newFrameworkId()
 {
   int fwId = nextFrameworkId++;
+  logNextIds();
   ostringstream oss;
   oss << masterId << "-" << setw(4) << setfill('0') << fwId;
   return oss.str();
 }
 
 
+// Create a new slave ID, formatted as MASTERID-SLAVEID like above
+SlaveID Master::newSlaveId()
+{
+  int64_t slaveId = nextSlaveId++;
+  logNextIds();
+  return masterId + "-" + lexical_cast<string>(slaveId);
+}
+
+
+// Record the ID counters, since the master ID only changes once a
+// minute and a master restarted on the same state log within that
+// minute would otherwise hand out the recovered IDs again
+void Master::logNextIds()
+{
+  if (stateLog != NULL)
+    stateLog->setNextIds(nextFrameworkId, nextSlaveId);
+}
+
+
 const Params& Master::getConf()
 {
   return conf;
 }
+
+
+bool Master::isRecovering()
+{
+  return recovering;
+}
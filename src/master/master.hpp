@@ -5,8 +5,11 @@
 #include <arpa/inet.h>
 
 #include <algorithm>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <map>
+#include <queue>
 #include <set>
 #include <sstream>
 #include <stdexcept>
@@ -21,7 +24,13 @@
 #include <boost/unordered_map.hpp>
 #include <boost/unordered_set.hpp>
 
+#include "allocation.hpp"
+#include "decoder.hpp"
+#include "http.hpp"
+#include "offer_filter.hpp"
 #include "state.hpp"
+#include "state_log.hpp"
+#include "task_table.hpp"
 
 #include "common/fatal.hpp"
 #include "common/foreach.hpp"
@@ -38,9 +47,11 @@
 
 namespace mesos { namespace internal { namespace master {
 
+using std::greater;
 using std::make_pair;
 using std::map;
 using std::pair;
+using std::priority_queue;
 using std::set;
 using std::string;
 using std::vector;
@@ -52,7 +63,8 @@ using namespace mesos;
 using namespace mesos::internal;
 
 
-// Maximum number of slot offers to have outstanding for each framework.
+// Default maximum number of slot offers to have outstanding for each
+// framework (see the max_offers_per_framework option).
 const int MAX_OFFERS_PER_FRAMEWORK = 50;
 
 // Default number of seconds until a refused slot is resent to a framework.
@@ -131,9 +143,11 @@ struct SlotOffer
   OfferID id;
   FrameworkID frameworkId;
   vector<SlaveResources> resources;
+  double time; // When the offer was made
   
-  SlotOffer(OfferID i, FrameworkID f, const vector<SlaveResources>& r)
-    : id(i), frameworkId(f), resources(r) {}
+  SlotOffer(OfferID i, FrameworkID f, const vector<SlaveResources>& r,
+            double t)
+    : id(i), frameworkId(f), resources(r), time(t) {}
 };
 
 // An connected framework.
@@ -141,27 +155,39 @@ struct Framework
 {
   PID pid;
   FrameworkID id;
-  bool active; // Turns false when framework is being removed
+  bool active; // Turns false when framework is being removed (and is
+               // false for one recovered from the state log until its
+               // scheduler re-registers)
   string name;
   string user;
   ExecutorInfo executorInfo;
   double connectTime;
 
-  unordered_map<TaskID, Task *> tasks;
+  unordered_map<TaskID, TaskRecord *> tasks;
   unordered_set<SlotOffer *> slotOffers; // Active offers given to this framework
 
   Resources resources; // Total resources owned by framework (tasks + offers)
+
+  // Told whenever 'resources' changes (set once the framework is added)
+  Allocator *allocator;
+
+  // Bumped whenever the framework's tasks or offers change, so that
+  // state snapshots know when to copy it again
+  int64_t version;
   
   // Contains a time of unfiltering for each slave we've filtered,
   // or 0 for slaves that we want to keep filtered forever
   unordered_map<Slave *, double> slaveFilter;
 
+  // Which offers the framework wants, from the hints it last sent
+  OfferFilter offerFilter;
+
   // A failover timer if the connection to this framework is lost.
   FrameworkFailoverTimer *failoverTimer;
 
   Framework(const PID &_pid, FrameworkID _id, double time)
     : pid(_pid), id(_id), active(true), connectTime(time),
-      failoverTimer(NULL) {}
+      allocator(NULL), version(0), failoverTimer(NULL) {}
 
   ~Framework()
   {
@@ -173,28 +199,30 @@ struct Framework
     }
   }
   
-  Task * lookupTask(TaskID tid)
+  TaskRecord * lookupTask(TaskID tid)
   {
-    unordered_map<TaskID, Task *>::iterator it = tasks.find(tid);
+    unordered_map<TaskID, TaskRecord *>::iterator it = tasks.find(tid);
     if (it != tasks.end())
       return it->second;
     else
       return NULL;
   }
   
-  void addTask(Task *task)
+  void addTask(TaskRecord *task)
   {
     CHECK(tasks.count(task->id) == 0);
     tasks[task->id] = task;
     this->resources += task->resources;
+    resourcesChanged();
   }
   
   void removeTask(TaskID tid)
   {
     CHECK(tasks.find(tid) != tasks.end());
-    unordered_map<TaskID, Task *>::iterator it = tasks.find(tid);
+    unordered_map<TaskID, TaskRecord *>::iterator it = tasks.find(tid);
     this->resources -= it->second->resources;
     tasks.erase(it);
+    resourcesChanged();
   }
   
   void addOffer(SlotOffer *offer)
@@ -203,6 +231,7 @@ struct Framework
     slotOffers.insert(offer);
     foreach (SlaveResources &r, offer->resources)
       this->resources += r.resources;
+    resourcesChanged();
   }
 
   void removeOffer(SlotOffer *offer)
@@ -211,23 +240,16 @@ struct Framework
     slotOffers.erase(offer);
     foreach (SlaveResources &r, offer->resources)
       this->resources -= r.resources;
+    resourcesChanged();
   }
   
-  bool filters(Slave *slave, Resources resources)
-  {
-    // TODO: Implement other filters
-    return slaveFilter.find(slave) != slaveFilter.end();
-  }
+  // Whether the framework doesn't want these resources on this slave
+  // offered to it, either because it refused the slave or because of
+  // its offer filter
+  bool filters(Slave *slave, Resources resources);
   
-  void removeExpiredFilters(double now)
-  {
-    vector<Slave *> toRemove;
-    foreachpair (Slave *slave, double removalTime, slaveFilter)
-      if (removalTime != 0 && removalTime <= now)
-        toRemove.push_back(slave);
-    foreach (Slave *slave, toRemove)
-      slaveFilter.erase(slave);
-  }
+  // Notify the allocator (if any) that 'resources' has changed
+  void resourcesChanged();
 };
 
 
@@ -246,8 +268,17 @@ struct Slave
   Resources resourcesOffered; // Resources currently in offers
   Resources resourcesInUse;   // Resources currently used by tasks
 
-  unordered_map<pair<FrameworkID, TaskID>, Task *> tasks;
+  // The tasks on this slave of each framework (keyed this way so that
+  // there is a copy of a framework's ID per slave rather than per task)
+  unordered_map<FrameworkID, unordered_map<TaskID, TaskRecord *> > tasks;
   unordered_set<SlotOffer *> slotOffers; // Active offers of slots on this slave
+
+  // Frameworks with an executor on this slave (which might have no tasks)
+  unordered_set<FrameworkID> executors;
+
+  // Frameworks that have been offered this slave or have had executors
+  // on it, which are the ones that need to hear if it is lost
+  unordered_set<FrameworkID> interested;
   
   Slave(const PID &_pid, SlaveID _id, double time)
     : pid(_pid), id(_id), active(true)
@@ -255,26 +286,62 @@ struct Slave
     connectTime = lastHeartbeat = time;
   }
 
-  Task * lookupTask(FrameworkID fid, TaskID tid)
+  TaskRecord * lookupTask(FrameworkID fid, TaskID tid)
+  {
+    unordered_map<FrameworkID, unordered_map<TaskID, TaskRecord *> >::iterator
+      it = tasks.find(fid);
+    if (it == tasks.end())
+      return NULL;
+    unordered_map<TaskID, TaskRecord *>::iterator it2 = it->second.find(tid);
+    if (it2 != it->second.end())
+      return it2->second;
+    else
+      return NULL;
+  }
+
+  // The tasks on this slave, copied out so that they can be removed
+  vector<TaskRecord *> taskList(FrameworkID fid) const
   {
-    foreachpair (_, Task *task, tasks)
-      if (task->frameworkId == fid && task->id == tid)
-        return task;
+    vector<TaskRecord *> list;
+    unordered_map<FrameworkID,
+                  unordered_map<TaskID, TaskRecord *> >::const_iterator
+      it = tasks.find(fid);
+    if (it != tasks.end()) {
+      foreachpair (_, TaskRecord *task, it->second)
+        list.push_back(task);
+    }
+    return list;
+  }
 
-    return NULL;
+  vector<TaskRecord *> taskList() const
+  {
+    vector<TaskRecord *> list;
+    unordered_map<FrameworkID,
+                  unordered_map<TaskID, TaskRecord *> >::const_iterator
+      it;
+    for (it = tasks.begin(); it != tasks.end(); ++it) {
+      foreachpair (_, TaskRecord *task, it->second)
+        list.push_back(task);
+    }
+    return list;
   }
 
-  void addTask(Task *task)
+  // Records don't hold their framework's ID, so it's passed in
+  void addTask(const FrameworkID& fid, TaskRecord *task)
   {
-    CHECK(tasks.find(make_pair(task->frameworkId, task->id)) == tasks.end());
-    tasks[make_pair(task->frameworkId, task->id)] = task;
+    CHECK(tasks[fid].count(task->id) == 0);
+    tasks[fid][task->id] = task;
     resourcesInUse += task->resources;
   }
   
-  void removeTask(Task *task)
+  void removeTask(const FrameworkID& fid, TaskRecord *task)
   {
-    CHECK(tasks.find(make_pair(task->frameworkId, task->id)) != tasks.end());
-    tasks.erase(make_pair(task->frameworkId, task->id));
+    unordered_map<FrameworkID, unordered_map<TaskID, TaskRecord *> >::iterator
+      it = tasks.find(fid);
+    CHECK(it != tasks.end() && it->second.count(task->id) > 0);
+    it->second.erase(task->id);
+    if (it->second.empty())
+      tasks.erase(it);
     resourcesInUse -= task->resources;
   }
   
@@ -315,9 +382,70 @@ protected:
   unordered_map<SlaveID, Slave *> slaves;
   unordered_map<OfferID, SlotOffer *> slotOffers;
 
+  // Holds the records that the frameworks' and slaves' indexes point to
+  // (the indexes themselves still allocate a node per task)
+  TaskTable taskTable;
+
   unordered_map<PID, FrameworkID> pidToFid;
   unordered_map<PID, SlaveID> pidToSid;
 
+  // Slaves on which each framework has an executor (see Slave::executors),
+  // kept by ID since frameworks might not (yet) be registered
+  unordered_map<FrameworkID, unordered_set<SlaveID> > executorSlaves;
+
+  // Slaves whose Slave::interested has each framework, so that the
+  // framework can be taken out of them when it is removed
+  unordered_map<FrameworkID, unordered_set<SlaveID> > interestingSlaves;
+
+  // When slaves might miss their heartbeats and when filters expire,
+  // earliest first. Entries aren't removed when a slave heartbeats or a
+  // filter is replaced; they are checked against the slave or filter
+  // when they come due instead.
+  typedef pair<double, SlaveID> HeartbeatDeadline;
+  typedef pair<double, pair<FrameworkID, SlaveID> > FilterDeadline;
+  typedef pair<double, OfferID> OfferDeadline;
+
+  priority_queue<HeartbeatDeadline, vector<HeartbeatDeadline>,
+                 greater<HeartbeatDeadline> > heartbeatDeadlines;
+  priority_queue<FilterDeadline, vector<FilterDeadline>,
+                 greater<FilterDeadline> > filterDeadlines;
+  priority_queue<OfferDeadline, vector<OfferDeadline>,
+                 greater<OfferDeadline> > offerDeadlines;
+
+  // Seconds after which offers are rescinded (or 0 to never rescind
+  // them), and how many have been rescinded because of that so far
+  double offerTimeout;
+  int64_t offersExpired;
+
+  // State snapshots for the web UI and other readers, published every
+  // 'snapshotInterval' seconds if the last one was read (and whenever
+  // the state is asked for),
+  // along with the copies of each slave and framework in the latest
+  // one (and the framework version copied) to reuse in the next one
+  state::Snapshots snapshots;
+  int64_t snapshotVersion;
+  double snapshotInterval;
+  double nextSnapshot;
+  unordered_map<SlaveID, std::tr1::shared_ptr<const state::Slave> > slaveStates;
+  unordered_map<FrameworkID, pair<int64_t,
+    std::tr1::shared_ptr<const state::Framework> > > frameworkStates;
+
+  // Recovery after a failover: slaves that re-register are staged (with
+  // the body of their message) and admitted at most 'reregistrationRate'
+  // per second (0 means right away), and no offers are made until
+  // 'recoverySlaves' of them are back or 'recoveryDeadline' passes
+  bool recovering;
+  double recoveryDeadline;
+  int recoverySlaves;
+  int slavesRecovered;
+  double reregistrationRate;
+  double nextReregistration;
+  std::deque<pair<PID, string> > stagedSlaves;
+
+  // Where frameworks, slaves and tasks are recorded for the next master
+  // to start from (or NULL if they aren't)
+  StateLog *stateLog;
+
   int64_t nextFrameworkId; // Used to give each framework a unique ID.
   int64_t nextSlaveId;     // Used to give each slave a unique ID.
   int64_t nextSlotOfferId; // Used to give each slot offer a unique ID.
@@ -325,6 +453,19 @@ protected:
   string allocatorType;
   Allocator *allocator;
 
+  // Decodes offer replies off of the master's thread (or NULL, in
+  // which case we decode them ourselves as they arrive).
+  DecoderPool *decoder;
+
+  // Offer replies from each sender still being decoded, and what the
+  // sender sent since that has to wait for them (see operator ())
+  unordered_map<PID, int> pendingDecodes;
+  unordered_map<PID, std::deque<pair<MSGID, string> > > heldMessages;
+
+  // Renders the answers to HTTP requests off of the master's thread
+  // (created when the master starts serving them).
+  HttpRenderer *renderer;
+
   string masterId; // Contains the date the master was launched and its fault
                    // tolerance ID (e.g. ephemeral ID returned from ZooKeeper).
                    // Used in framework and slave IDs created by this master.
@@ -339,13 +480,19 @@ public:
   static void registerOptions(Configurator* conf);
 
   state::MasterState *getState();
+
+  // Get the latest state snapshot (safe to call from any thread; the
+  // pointer is empty until the master has started)
+  std::tr1::shared_ptr<const state::Snapshot> getSnapshot();
   
-  OfferID makeOffer(Framework *framework,
-		    const vector<SlaveResources>& resources);
+  // Virtual so that the allocator benchmark can make offers without
+  // sending them anywhere
+  virtual OfferID makeOffer(Framework *framework,
+                            const vector<SlaveResources>& resources);
   
   void rescindOffer(SlotOffer *offer);
   
-  void killTask(Task *task);
+  void killTask(TaskRecord *task);
   
   Framework * lookupFramework(FrameworkID fid);
 
@@ -361,17 +508,32 @@ public:
 
   const Params& getConf();
 
+  // Where the IDs and names of tasks' records are looked up
+  const TaskTable& getTaskTable() { return taskTable; }
+
+  // Whether the master is waiting for slaves to come back after a
+  // failover, during which the allocator shouldn't make offers
+  bool isRecovering();
+
 protected:
   void operator () ();
 
   // Process a resource offer reply (for a non-cancelled offer) by launching
   // the desired tasks (if the offer contains a valid set of tasks) and
   // reporting any unused resources to the allocator
-  void processOfferReply(SlotOffer *offer,
-      const vector<TaskDescription>& tasks, const Params& params);
+  void processOfferReply(SlotOffer *offer, const OfferReply& reply);
+
+  // Handle a decoded offer reply, whether or not its offer is still around
+  void handleOfferReply(const OfferReply& reply);
+
+  // Handle an F2M_UNREGISTER_FRAMEWORK, F2M_KILL_TASK or
+  // F2M_FRAMEWORK_MESSAGE with the given body
+  void handleFrameworkMessage(const PID& from, MSGID id, const string& body);
 
-  // Launch a task described in a slot offer response
-  void launchTask(Framework *framework, const TaskDescription& task);
+  // Add a task described in a slot offer response (processOfferReply
+  // sends the slave the tasks to run)
+  void launchTask(Framework *framework, const TaskDescription& task,
+                  const Resources& resources);
   
   // Terminate a framework, sending it a particular error message
   // TODO: Make the error codes and messages programmer-friendly
@@ -385,7 +547,20 @@ protected:
                        OfferReturnReason reason,
                        const vector<SlaveResources>& resourcesLeft);
 
-  void removeTask(Task *task, TaskRemovalReason reason);
+  void removeTask(TaskRecord *task, TaskRemovalReason reason);
+
+  // Record a task's new state, removing the task if it's done
+  void updateTaskState(Framework *framework, TaskRecord *task,
+                       TaskState state);
+
+  // Remember that a framework has an executor on a slave
+  void addExecutor(Slave *slave, const FrameworkID& frameworkId);
+
+  // Forget about a framework's executor on a slave
+  void removeExecutor(Slave *slave, const FrameworkID& frameworkId);
+
+  // Remember that a framework needs to hear if a slave is lost
+  void addInterest(Slave *slave, const FrameworkID& frameworkId);
 
   void addFramework(Framework *framework);
 
@@ -398,10 +573,43 @@ protected:
   // Lose all of a slave's tasks and delete the slave object
   void removeSlave(Slave *slave);
 
+  // Add back a slave that was registered with a previous master, given
+  // the body of its S2M_REREGISTER_SLAVE message
+  void reregisterSlave(const PID& pid, const string& data);
+
+  // Add a task that a re-registering slave says it's running
+  void addReregisteredTask(Slave *slave, const Task& task);
+
+  // Stop suppressing offers and run an allocation pass over every slave
+  void finishRecovery();
+
+  // Add back the frameworks, slaves and tasks in the state log (the
+  // slaves and frameworks are removed as usual if they don't turn out
+  // to be around)
+  void recoverState();
+
+  // Record a framework or slave (again) in the state log, if any
+  void logFramework(Framework *framework);
+  void logSlave(Slave *slave);
+
+  // Remove slaves that missed their heartbeats, filters that expired and
+  // offers that timed out, admit staged slaves, end recovery and publish
+  // a snapshot when due (and read), returning the seconds until the next deadline
+  // (or 0)
+  double expireDeadlines();
+
+  // Publish a new state snapshot, copying only the slaves and
+  // frameworks that changed since the last one
+  void publishSnapshot();
+
   virtual Allocator* createAllocator();
 
   FrameworkID newFrameworkId();
 
+  SlaveID newSlaveId();
+
+  void logNextIds();
+
   string currentDate();
 };
 
@@ -429,12 +637,6 @@ inline std::ostream& operator << (std::ostream& stream, const Framework *f)
 }
 
 
-inline std::ostream& operator << (std::ostream& stream, const Task *t)
-{
-  stream << "task " << t->frameworkId << ":" << t->id;
-  return stream;
-}
-
 }}} /* namespace */
 
 #endif /* __MASTER_HPP__ */
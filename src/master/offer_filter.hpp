@@ -0,0 +1,74 @@
+#ifndef __MASTER_OFFER_FILTER_HPP__
+#define __MASTER_OFFER_FILTER_HPP__
+
+#include <string>
+#include <vector>
+
+#include <boost/unordered_set.hpp>
+
+#include "common/foreach.hpp"
+#include "common/params.hpp"
+#include "common/resources.hpp"
+#include "common/string_utils.hpp"
+
+
+namespace mesos { namespace internal { namespace master {
+
+using std::string;
+using std::vector;
+using boost::unordered_set;
+
+
+// Which offers a framework wants, as given by the hints it sends
+// through SchedulerDriver::sendHints:
+//   min_cpus, min_mem: don't offer slaves with less than this free
+//   allow_hosts:       only offer these (comma separated) hosts
+//   deny_hosts:        never offer these (comma separated) hosts
+//   max_offers:        maximum number of offers to have outstanding
+// Filters are values so that allocation passes can take copies of them.
+struct OfferFilter
+{
+  int32_t minCpus;
+  int64_t minMem;
+  unordered_set<string> allowHosts; // Empty means all hosts are allowed
+  unordered_set<string> denyHosts;
+  int32_t maxOffers; // 0 means no limit
+
+  OfferFilter() : minCpus(0), minMem(0), maxOffers(0) {}
+
+  OfferFilter(const Params& hints)
+  {
+    minCpus = hints.getInt32("min_cpus", 0);
+    minMem = hints.getInt64("min_mem", 0);
+    maxOffers = hints.getInt32("max_offers", 0);
+
+    vector<string> hosts;
+    StringUtils::split(hints.get("allow_hosts", ""), ",", &hosts);
+    foreach (const string& host, hosts)
+      allowHosts.insert(StringUtils::trim(host));
+
+    hosts.clear();
+    StringUtils::split(hints.get("deny_hosts", ""), ",", &hosts);
+    foreach (const string& host, hosts)
+      denyHosts.insert(StringUtils::trim(host));
+  }
+
+  // Returns true if this filter doesn't rule out any slave
+  bool empty() const
+  {
+    return minCpus <= 0 && minMem <= 0 && allowHosts.empty() &&
+      denyHosts.empty();
+  }
+
+  // Returns true if resources on this host should not be offered
+  bool filters(const string& hostname, const Resources& resources) const
+  {
+    return resources.cpus() < minCpus || resources.mem() < minMem ||
+      (!allowHosts.empty() && allowHosts.count(hostname) == 0) ||
+      denyHosts.count(hostname) > 0;
+  }
+};
+
+}}} /* namespace */
+
+#endif /* __MASTER_OFFER_FILTER_HPP__ */
@@ -4,30 +4,62 @@
 
 #include "simple_allocator.hpp"
 
+#include "common/logging.hpp"
 
+
+using std::make_pair;
 using std::max;
-using std::sort;
 
 using namespace mesos;
 using namespace mesos::internal;
 using namespace mesos::internal::master;
 
 
+SimpleAllocator::SimpleAllocator(Master* _master)
+  : master(_master), sharesStale(false), allSlavesDirty(false), thread(NULL),
+    allocating(false)
+{
+  batching = master->getConf().get<bool>("batch_allocations", false);
+  batchSize = master->getConf().get<int>("allocation_batch_size", 0);
+  maxOffers = master->getConf().get<int>("max_offers_per_framework",
+                                         MAX_OFFERS_PER_FRAMEWORK);
+  spread = master->getConf().get<bool>("spread_offers", false);
+  maxSlavesPerOffer = master->getConf().get<int>("max_slaves_per_offer", 0);
+  if (master->getConf().get<bool>("allocation_thread", false)) {
+    LOG(INFO) << "Running allocation passes on their own thread";
+    thread = new AllocationThread(master->self());
+  }
+}
+
+
+SimpleAllocator::~SimpleAllocator()
+{
+  delete thread;
+}
+
+
 void SimpleAllocator::frameworkAdded(Framework* framework)
 {
   LOG(INFO) << "Added " << framework;
-  makeNewOffers();
+  reorder(framework);
+  dirtyFrameworks.insert(framework);
+  allocate();
 }
 
 
 void SimpleAllocator::frameworkRemoved(Framework* framework)
 {
   LOG(INFO) << "Removed " << framework;
+  if (shares.count(framework) > 0) {
+    ordering.erase(make_pair(shares[framework], framework->id));
+    shares.erase(framework);
+  }
   foreachpair (Slave* s, unordered_set<Framework*>& refs, refusers)
     refs.erase(framework);
+  dirtyFrameworks.erase(framework);
   // TODO: Re-offer just the slaves that the framework had tasks on?
   //       Alternatively, comment this out and wait for a timer tick
-  makeNewOffers();
+  allocate();
 }
 
 
@@ -36,7 +68,8 @@ void SimpleAllocator::slaveAdded(Slave* slave)
   LOG(INFO) << "Added " << slave;
   refusers[slave] = unordered_set<Framework*>();
   totalResources += slave->resources;
-  makeNewOffers(slave);
+  sharesStale = true;
+  allocate(slave);
 }
 
 
@@ -44,21 +77,30 @@ void SimpleAllocator::slaveRemoved(Slave* slave)
 {
   LOG(INFO) << "Removed " << slave;
   totalResources -= slave->resources;
+  sharesStale = true;
   refusers.erase(slave);
+  dirtySlaves.erase(slave);
 }
 
 
-void SimpleAllocator::taskRemoved(Task* task, TaskRemovalReason reason)
+void SimpleAllocator::taskRemoved(TaskRecord* task, TaskRemovalReason reason)
 {
-  LOG(INFO) << "Removed " << task;
+  const TaskTable& tasks = master->getTaskTable();
+  LOG_RATE_LIMITED(INFO) << "Removed " << tasks.describe(task);
   // Remove all refusers from this slave since it has more resources free
-  Slave* slave = master->lookupSlave(task->slaveId);
+  Slave* slave = master->lookupSlave(tasks.slaveId(task));
   CHECK(slave != 0);
   refusers[slave].clear();
   // Re-offer the resources, unless this task was removed due to a lost
   // slave or a lost framework (in which case we'll get another callback)
   if (reason == TRR_TASK_ENDED || reason == TRR_EXECUTOR_LOST)
-    makeNewOffers(slave);
+    allocate(slave);
+}
+
+
+void SimpleAllocator::frameworkResourcesChanged(Framework* framework)
+{
+  reorder(framework);
 }
 
 
@@ -66,15 +108,17 @@ void SimpleAllocator::offerReturned(SlotOffer* offer,
                                     OfferReturnReason reason,
                                     const vector<SlaveResources>& resLeft)
 {
-  LOG(INFO) << "Offer returned: " << offer << ", reason = " << reason;
-  // If this offer returned due to the framework replying, add it to refusers
-  if (reason == ORR_FRAMEWORK_REPLIED) {
+  LOG_RATE_LIMITED(INFO) << "Offer returned: " << offer
+                         << ", reason = " << reason;
+  // If this offer returned due to the framework replying, or not replying
+  // in time, add it to refusers
+  if (reason == ORR_FRAMEWORK_REPLIED || reason == ORR_OFFER_RESCINDED) {
     Framework* framework = master->lookupFramework(offer->frameworkId);
     CHECK(framework != 0);
     foreach (const SlaveResources& r, resLeft) {
       VLOG(1) << "Framework reply leaves " << r.resources 
               << " free on " << r.slave;
-      if (r.resources.cpus > 0 || r.resources.mem > 0) {
+      if (r.resources.anyPositive()) {
         VLOG(1) << "Inserting " << framework << " as refuser for " << r.slave;
         refusers[r.slave].insert(framework);
       }
@@ -83,10 +127,18 @@ void SimpleAllocator::offerReturned(SlotOffer* offer,
   // Make new offers, unless the offer returned due to a lost framework or slave
   // (in those cases, frameworkRemoved and slaveRemoved will be called later)
   if (reason != ORR_SLAVE_LOST && reason != ORR_FRAMEWORK_LOST) {
-    vector<Slave*> slaves;
-    foreach (const SlaveResources& r, resLeft)
-      slaves.push_back(r.slave);
-    makeNewOffers(slaves);
+    // Passes skipped a framework at its offer limit on every slave, so
+    // once it's under the limit again they all need to be looked at
+    Framework* framework = master->lookupFramework(offer->frameworkId);
+    size_t limit = framework != 0 ? offerLimit(framework) : 0;
+    if (limit > 0 && framework->slotOffers.size() + 1 == limit) {
+      allocate();
+    } else {
+      vector<Slave*> slaves;
+      foreach (const SlaveResources& r, resLeft)
+        slaves.push_back(r.slave);
+      allocate(slaves);
+    }
   }
 }
 
@@ -94,58 +146,177 @@ void SimpleAllocator::offerReturned(SlotOffer* offer,
 void SimpleAllocator::offersRevived(Framework* framework)
 {
   LOG(INFO) << "Filters removed for " << framework;
-  makeNewOffers();
+  dirtyFrameworks.insert(framework);
+  allocate();
+}
+
+
+void SimpleAllocator::filterExpired(Framework* framework, Slave* slave)
+{
+  VLOG(1) << "Filter on " << slave << " for " << framework << " expired";
+  allocate(slave);
 }
 
 
 void SimpleAllocator::timerTick()
 {
-  // TODO: Is this necessary?
-  makeNewOffers();
+  // Batched passes only look at what changed since the last one
+  if (batching || thread != NULL)
+    allocateDirty();
+  else
+    makeNewOffers();
 }
 
 
-namespace {
-  
-struct DominantShareComparator
+void SimpleAllocator::recoveryFinished()
 {
-  Resources total;
-  
-  DominantShareComparator(Resources _total) : total(_total)
-  {
-    if (total.cpus == 0) // Prevent division by zero if there are no slaves
-      total.cpus = 1;
-    if (total.mem == 0)
-      total.mem = 1;
+  LOG(INFO) << "Recovery finished, looking at every slave";
+  allocate();
+}
+
+
+void SimpleAllocator::allocate()
+{
+  if (batching || thread != NULL) {
+    allSlavesDirty = true;
+    maybeAllocate();
+  } else {
+    makeNewOffers();
   }
-  
-  bool operator() (Framework* f1, Framework* f2)
-  {
-    double share1 = max(f1->resources.cpus / (double) total.cpus,
-                        f1->resources.mem  / (double) total.mem);
-    double share2 = max(f2->resources.cpus / (double) total.cpus,
-                        f2->resources.mem  / (double) total.mem);
-    if (share1 == share2)
-      return f1->id < f2->id; // Make the sort deterministic for unit testing
-    else
-      return share1 < share2;
+}
+
+
+void SimpleAllocator::allocate(Slave* slave)
+{
+  if (batching || thread != NULL) {
+    dirtySlaves.insert(slave);
+    maybeAllocate();
+  } else {
+    makeNewOffers(slave);
+  }
+}
+
+
+void SimpleAllocator::allocate(const vector<Slave*>& slaves)
+{
+  if (batching || thread != NULL) {
+    foreach (Slave* slave, slaves)
+      dirtySlaves.insert(slave);
+    maybeAllocate();
+  } else {
+    makeNewOffers(slaves);
   }
-};
+}
+
 
+void SimpleAllocator::allocationFinished(const Allocation& allocation)
+{
+  CHECK(allocating);
+  allocating = false;
+  makeOffers(allocation);
+  maybeAllocate();
+}
+
+
+void SimpleAllocator::maybeAllocate()
+{
+  size_t dirty = dirtySlaves.size() + dirtyFrameworks.size();
+  if ((!batching && (dirty > 0 || allSlavesDirty)) ||
+      (batchSize > 0 && dirty >= (size_t) batchSize))
+    allocateDirty();
+}
+
+
+void SimpleAllocator::allocateDirty()
+{
+  // Wait for the outstanding pass, if any, to finish
+  if (allocating)
+    return;
+
+  VLOG(1) << "Allocating for " << dirtySlaves.size() << " slaves and "
+          << dirtyFrameworks.size() << " frameworks that changed"
+          << (allSlavesDirty ? " (looking at all slaves)" : "");
+
+  // Take (and clear) the dirty state before making any offers
+  vector<Slave*> slaves(dirtySlaves.begin(), dirtySlaves.end());
+  bool all = allSlavesDirty;
+  dirtySlaves.clear();
+  dirtyFrameworks.clear();
+  allSlavesDirty = false;
+
+  if (all)
+    makeNewOffers();
+  else if (slaves.size() > 0)
+    makeNewOffers(slaves);
+}
+
+
+double SimpleAllocator::dominantShare(Framework* framework)
+{
+  return framework->resources.dominantShare(totalResources);
+}
+
+
+void SimpleAllocator::reorder(Framework* framework)
+{
+  unordered_map<Framework*, double>::iterator it = shares.find(framework);
+  if (it != shares.end())
+    ordering.erase(make_pair(it->second, framework->id));
+  double share = dominantShare(framework);
+  shares[framework] = share;
+  // Ties are broken by id to make the ordering deterministic for unit tests
+  ordering[make_pair(share, framework->id)] = framework;
+}
+
+
+void SimpleAllocator::reorderAll()
+{
+  ordering.clear();
+  foreachpair (Framework* framework, double& share, shares) {
+    share = dominantShare(framework);
+    ordering[make_pair(share, framework->id)] = framework;
+  }
+  sharesStale = false;
+}
+
+
+size_t SimpleAllocator::offerLimit(Framework* framework)
+{
+  size_t max = framework->offerFilter.maxOffers;
+  if (maxOffers > 0 && (max == 0 || (size_t) maxOffers < max))
+    max = maxOffers;
+  return max;
+}
+
+
+bool SimpleAllocator::hasMaxOffers(Framework* framework)
+{
+  size_t max = offerLimit(framework);
+  return max > 0 && framework->slotOffers.size() >= max;
 }
 
 
 vector<Framework*> SimpleAllocator::getAllocationOrdering()
 {
-  vector<Framework*> frameworks = master->getActiveFrameworks();
-  DominantShareComparator comp(totalResources);
-  sort(frameworks.begin(), frameworks.end(), comp);
+  if (sharesStale)
+    reorderAll();
+
+  // Copy the ordering since making offers will change it as we go
+  vector<Framework*> frameworks;
+  frameworks.reserve(ordering.size());
+  foreachpair (_, Framework* framework, ordering)
+    if (framework->active && !hasMaxOffers(framework))
+      frameworks.push_back(framework);
   return frameworks;
 }
 
 
 void SimpleAllocator::makeNewOffers()
 {
+  // The master does a full pass once it's done recovering
+  if (master->isRecovering())
+    return;
+
   // TODO: Create a method in master so that we don't return the whole list of slaves
   vector<Slave*> slaves = master->getActiveSlaves();
   makeNewOffers(slaves);
@@ -162,6 +333,9 @@ void SimpleAllocator::makeNewOffers(Slave* slave)
 
 void SimpleAllocator::makeNewOffers(const vector<Slave*>& slaves)
 {
+  if (master->isRecovering())
+    return;
+
   // Get an ordering of frameworks to send offers to
   vector<Framework*> ordering = getAllocationOrdering();
   if (ordering.size() == 0)
@@ -172,7 +346,7 @@ void SimpleAllocator::makeNewOffers(const vector<Slave*>& slaves)
   foreach (Slave* slave, slaves) {
     if (slave->active) {
       Resources res = slave->resourcesFree();
-      if (res.cpus >= MIN_CPUS && res.mem >= MIN_MEM) {
+      if (res.cpus() >= MIN_CPUS && res.mem() >= MIN_MEM) {
         VLOG(1) << "Found free resources: " << res << " on " << slave;
         freeResources[slave] = res;
       }
@@ -191,22 +365,77 @@ void SimpleAllocator::makeNewOffers(const vector<Slave*>& slaves)
     }
   }
   
+  // Copy what the pass needs to look at (given filters & refusals)
+  AllocationRequest* request = new AllocationRequest();
+  request->total = totalResources;
+  request->spread = spread;
+  request->maxSlavesPerOffer = max(maxSlavesPerOffer, 0);
   foreach (Framework* framework, ordering) {
-    // See which resources this framework can take (given filters & refusals)
+    request->frameworks.push_back(framework->id);
+    request->resources.push_back(framework->resources);
+    foreachpair (Slave* slave, _, framework->slaveFilter)
+      if (freeResources.count(slave) > 0)
+        request->excluded[framework->id].insert(slave->id);
+    // Only frameworks that sent hints need every slave looked at
+    if (!framework->offerFilter.empty()) {
+      foreachpair (Slave* slave, Resources resources, freeResources)
+        if (framework->offerFilter.filters(slave->hostname, resources))
+          request->excluded[framework->id].insert(slave->id);
+    }
+  }
+  foreachpair (Slave* slave, Resources resources, freeResources) {
+    request->free.push_back(make_pair(slave->id, resources));
+    foreach (Framework* framework, refusers[slave])
+      request->excluded[framework->id].insert(slave->id);
+  }
+
+  if (thread != NULL) {
+    allocating = true;
+    thread->allocate(request);
+  } else {
+    Allocation allocation;
+    mesos::internal::master::allocate(*request, &allocation);
+    delete request;
+    makeOffers(allocation);
+  }
+}
+
+
+void SimpleAllocator::makeOffers(const Allocation& allocation)
+{
+  for (size_t i = 0; i < allocation.offers.size(); i++) {
+    const FrameworkID& frameworkId = allocation.offers[i].first;
+    const vector<pair<SlaveID, Resources> >& resources =
+      allocation.offers[i].second;
+
+    Framework* framework = master->lookupFramework(frameworkId);
+
     vector<SlaveResources> offerable;
-    foreachpair (Slave* slave, Resources resources, freeResources) {
-      if (refusers[slave].find(framework) == refusers[slave].end() &&
-          !framework->filters(slave, resources)) {
-        VLOG(1) << "Offering " << resources << " on " << slave
-                << " to framework " << framework->id;
-        offerable.push_back(SlaveResources(slave, resources));
+    for (size_t j = 0; j < resources.size(); j++) {
+      Slave* slave = master->lookupSlave(resources[j].first);
+      if (slave == NULL || !slave->active)
+        continue; // The slave was lost while the pass was running
+
+      // Skip resources that aren't free anymore or that the framework
+      // has started to refuse or filter, and look at the slave again
+      Resources free = slave->resourcesFree();
+      if (framework == NULL || !framework->active ||
+          hasMaxOffers(framework) ||
+          refusers[slave].count(framework) > 0 ||
+          framework->filters(slave, resources[j].second) ||
+          !resources[j].second.fitsIn(free)) {
+        VLOG(1) << "Not offering " << resources[j].second << " on " << slave
+                << " to framework " << frameworkId << " since it changed";
+        dirtySlaves.insert(slave);
+        continue;
       }
+
+      VLOG(1) << "Offering " << resources[j].second << " on " << slave
+              << " to framework " << frameworkId;
+      offerable.push_back(SlaveResources(slave, resources[j].second));
     }
-    if (offerable.size() > 0) {
-      foreach (SlaveResources& r, offerable) {
-        freeResources.erase(r.slave);
-      }
+
+    if (offerable.size() > 0)
       master->makeOffer(framework, offerable);
-    }
   }
 }
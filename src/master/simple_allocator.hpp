@@ -1,6 +1,8 @@
 #ifndef __SIMPLE_ALLOCATOR_HPP__
 #define __SIMPLE_ALLOCATOR_HPP__
 
+#include <map>
+#include <utility>
 #include <vector>
 
 #include <boost/unordered_map.hpp>
@@ -13,6 +15,8 @@
 
 namespace mesos { namespace internal { namespace master {
 
+using std::map;
+using std::pair;
 using std::vector;
 using boost::unordered_map;
 using boost::unordered_set;
@@ -26,11 +30,47 @@ class SimpleAllocator : public Allocator
   // Remember which frameworks refused each slave "recently"; this is cleared
   // when the slave's free resources go up or when everyone has refused it
   unordered_map<Slave*, unordered_set<Framework*> > refusers;
+
+  // Frameworks ordered by (dominant share, id), kept up to date as their
+  // resources change so that allocating doesn't need to sort them; we
+  // also remember the share each framework was last indexed under
+  map<pair<double, FrameworkID>, Framework*> ordering;
+  unordered_map<Framework*, double> shares;
+
+  // Whether the total resources changed since the shares were computed;
+  // the ordering is then rebuilt once, when a pass next looks at it,
+  // rather than for every slave that comes or goes
+  bool sharesStale;
+
+  // When batching, events only record which slaves (or, for frameworks
+  // that were added or revived, all slaves) need to be looked at again,
+  // and one allocation pass covers them all on the next timer tick, or
+  // earlier once 'batchSize' slaves and frameworks have changed
+  bool batching;
+  int batchSize;
+  unordered_set<Slave*> dirtySlaves;
+  unordered_set<Framework*> dirtyFrameworks;
+  bool allSlavesDirty;
+
+  // Frameworks with this many offers outstanding don't get more (0 means
+  // there's no limit)
+  int maxOffers;
+
+  // Whether allocation passes split the free slaves across frameworks,
+  // and the most slaves to put in one offer (0 means no limit)
+  bool spread;
+  int maxSlavesPerOffer;
+
+  // Runs allocation passes if they shouldn't run on the master's thread;
+  // only one pass is outstanding at a time and anything that changes in
+  // the meantime stays dirty for the next one
+  AllocationThread* thread;
+  bool allocating;
   
 public:
-  SimpleAllocator(Master* _master): master(_master) {}
+  SimpleAllocator(Master* _master);
   
-  ~SimpleAllocator() {}
+  ~SimpleAllocator();
   
   virtual void frameworkAdded(Framework* framework);
   
@@ -40,17 +80,53 @@ public:
   
   virtual void slaveRemoved(Slave* slave);
   
-  virtual void taskRemoved(Task* task, TaskRemovalReason reason);
+  virtual void taskRemoved(TaskRecord* task, TaskRemovalReason reason);
+
+  virtual void frameworkResourcesChanged(Framework* framework);
 
   virtual void offerReturned(SlotOffer* offer,
                              OfferReturnReason reason,
                              const vector<SlaveResources>& resourcesLeft);
 
   virtual void offersRevived(Framework* framework);
+
+  virtual void filterExpired(Framework* framework, Slave* slave);
   
   virtual void timerTick();
+
+  virtual void recoveryFinished();
+
+  virtual void allocationFinished(const Allocation& allocation);
   
 private:
+  // Compute a framework's share of its most used resource in the cluster
+  double dominantShare(Framework* framework);
+
+  // Move a framework to the right place in the ordering
+  void reorder(Framework* framework);
+
+  // Recompute all shares, e.g. because the total resources changed
+  void reorderAll();
+
+  // Allocate the free resources on all slaves (or on some slaves), right
+  // away or, when batching, on the next allocation pass
+  void allocate();
+  void allocate(Slave* slave);
+  void allocate(const vector<Slave*>& slaves);
+
+  // Allocate now if anything is dirty and we aren't batching, or if
+  // enough slaves and frameworks are dirty
+  void maybeAllocate();
+
+  // Run an allocation pass over everything that is dirty
+  void allocateDirty();
+
+  // Get the most offers a framework may have outstanding (0 if any number)
+  size_t offerLimit(Framework* framework);
+
+  // Check whether a framework can't be given any more offers
+  bool hasMaxOffers(Framework* framework);
+
   // Get an ordering to consider frameworks in for launching tasks
   vector<Framework*> getAllocationOrdering();
   
@@ -62,6 +138,10 @@ private:
 
   // Make resource offers for a subset of the slaves
   void makeNewOffers(const vector<Slave*>& slaves);
+
+  // Make the offers decided on by an allocation pass, skipping those
+  // whose framework or slave has gone away or changed since
+  void makeOffers(const Allocation& allocation);
 };
 
 }}} /* namespace */
@@ -0,0 +1,49 @@
+#include <algorithm>
+
+#include "state.hpp"
+
+using std::max;
+
+using std::tr1::shared_ptr;
+
+using namespace mesos;
+using namespace mesos::internal;
+using namespace mesos::internal::master;
+
+
+state::MasterState * state::copySnapshot(const Snapshot& snapshot)
+{
+  MasterState *state = new MasterState(snapshot.build_date,
+                                       snapshot.build_user,
+                                       snapshot.pid,
+                                       snapshot.isFT);
+
+  state->offers_expired = snapshot.offers_expired;
+
+  foreach (const shared_ptr<const Slave>& s, snapshot.slaves)
+    state->slaves.push_back(new Slave(*s));
+
+  foreach (const shared_ptr<const Framework>& f, snapshot.frameworks) {
+    Framework *framework = new Framework(f->id, f->user, f->name,
+                                         f->executor, f->cpus, f->mem,
+                                         f->disk, f->net, f->connect_time);
+    state->frameworks.push_back(framework);
+    foreach (Task *t, f->tasks)
+      framework->tasks.push_back(new Task(*t));
+    foreach (SlotOffer *o, f->offers) {
+      SlotOffer *offer = new SlotOffer(o->id, o->framework_id,
+                                       snapshot.time - o->time, o->time);
+      state->oldest_offer_age = max(state->oldest_offer_age, offer->age);
+      foreach (SlaveResources *r, o->resources) {
+        offer->resources.push_back(new SlaveResources(*r));
+        state->offered_cpus += r->cpus;
+        state->offered_mem += r->mem;
+        state->offered_disk += r->disk;
+        state->offered_net += r->net;
+      }
+      framework->offers.push_back(offer);
+    }
+  }
+
+  return state;
+}
@@ -7,7 +7,16 @@
 
 #include <mesos_types.hpp>
 
+#ifndef SWIG
+#include <pthread.h>
+
+#include <tr1/memory>
+#endif
+
 #include "common/foreach.hpp"
+#ifndef SWIG
+#include "common/lock.hpp"
+#endif
 
 #include "config/config.hpp"
 
@@ -19,9 +28,12 @@ struct SlaveResources
   SlaveID slave_id;
   int32_t cpus;
   int64_t mem;
+  int32_t disk;
+  int32_t net;
   
-  SlaveResources(SlaveID _sid, int32_t _cpus, int64_t _mem)
-    : slave_id(_sid), cpus(_cpus), mem(_mem) {}
+  SlaveResources(SlaveID _sid, int32_t _cpus, int64_t _mem, int32_t _disk,
+                 int32_t _net)
+    : slave_id(_sid), cpus(_cpus), mem(_mem), disk(_disk), net(_net) {}
 };
 
 
@@ -30,9 +42,11 @@ struct SlotOffer
   OfferID id;
   FrameworkID framework_id;
   std::vector<SlaveResources *> resources;
+  double age; // Seconds since the offer was made
+  double time; // When the offer was made (in snapshots, where age is 0)
   
-  SlotOffer(OfferID _id, FrameworkID _fid)
-    : id(_id), framework_id(_fid) {}
+  SlotOffer(OfferID _id, FrameworkID _fid, double _age, double _time = 0)
+    : id(_id), framework_id(_fid), age(_age), time(_time) {}
     
   ~SlotOffer()
   {
@@ -45,9 +59,11 @@ struct SlotOffer
 struct Slave
 {
   Slave(SlaveID id_, const std::string& host_, const std::string& public_dns_,
-	int32_t cpus_, int64_t mem_, time_t connect_)
+	int32_t cpus_, int64_t mem_, int32_t disk_, int32_t net_,
+	time_t connect_)
     : id(id_), host(host_), public_dns(public_dns_),
-      cpus(cpus_), mem(mem_), connect_time(connect_) {}
+      cpus(cpus_), mem(mem_), disk(disk_), net(net_),
+      connect_time(connect_) {}
 
   Slave() {}
 
@@ -56,6 +72,8 @@ struct Slave
   std::string public_dns;
   int32_t cpus;
   int64_t mem;
+  int32_t disk;
+  int32_t net;
   int64_t connect_time;
 };
 
@@ -63,9 +81,10 @@ struct Slave
 struct Task
 {
   Task(TaskID id_, const std::string& name_, FrameworkID fid_, SlaveID sid_,
-       TaskState state_, int32_t _cpus, int64_t _mem)
+       TaskState state_, int32_t _cpus, int64_t _mem, int32_t _disk,
+       int32_t _net)
     : id(id_), name(name_), framework_id(fid_), slave_id(sid_), state(state_), 
-      cpus(_cpus), mem(_mem) {}
+      cpus(_cpus), mem(_mem), disk(_disk), net(_net) {}
 
   Task() {}
 
@@ -76,6 +95,8 @@ struct Task
   TaskState state;
   int32_t cpus;
   int64_t mem;
+  int32_t disk;
+  int32_t net;
 };
 
 
@@ -83,9 +104,11 @@ struct Framework
 {
   Framework(FrameworkID id_, const std::string& user_,
       const std::string& name_, const std::string& executor_,
-      int32_t cpus_, int64_t mem_, time_t connect_)
+      int32_t cpus_, int64_t mem_, int32_t disk_, int32_t net_,
+      time_t connect_)
     : id(id_), user(user_), name(name_), executor(executor_),
-      cpus(cpus_), mem(mem_), connect_time(connect_) {}
+      cpus(cpus_), mem(mem_), disk(disk_), net(net_),
+      connect_time(connect_) {}
 
   Framework() {}
 
@@ -103,6 +126,8 @@ struct Framework
   std::string executor;
   int32_t cpus;
   int64_t mem;
+  int32_t disk;
+  int32_t net;
   int64_t connect_time;
 
   std::vector<Task *> tasks;
@@ -114,9 +139,13 @@ struct MasterState
 {
   MasterState(const std::string& build_date_, const std::string& build_user_,
 	      const std::string& pid_, bool _isFT = false)
-    : build_date(build_date_), build_user(build_user_), pid(pid_), isFT(_isFT) {}
+    : build_date(build_date_), build_user(build_user_), pid(pid_), isFT(_isFT),
+      offered_cpus(0), offered_mem(0), offered_disk(0), offered_net(0),
+      oldest_offer_age(0), offers_expired(0) {}
 
-  MasterState() {}
+  MasterState()
+    : offered_cpus(0), offered_mem(0), offered_disk(0), offered_net(0),
+      oldest_offer_age(0), offers_expired(0) {}
 
   ~MasterState()
   {
@@ -133,8 +162,87 @@ struct MasterState
   std::vector<Slave *> slaves;
   std::vector<Framework *> frameworks;
   bool isFT;
+
+  // Resources tied up in outstanding offers, how long the oldest one
+  // has been outstanding, and how many offers timed out
+  int32_t offered_cpus;
+  int64_t offered_mem;
+  int32_t offered_disk;
+  int32_t offered_net;
+  double oldest_offer_age;
+  int64_t offers_expired;
 };
 
+
+#ifndef SWIG
+
+// An immutable copy of the master's state. Slaves and frameworks that
+// haven't changed are shared with the previous version, so publishing
+// a new version only copies the frameworks that changed (and a pointer
+// for every other slave and framework).
+struct Snapshot
+{
+  Snapshot() : version(0), time(0), isFT(false), offers_expired(0) {}
+
+  int64_t version;
+  double time; // When it was published, to compute offer ages from
+
+  std::string build_date;
+  std::string build_user;
+  std::string pid;
+  bool isFT;
+  int64_t offers_expired;
+
+  std::vector<std::tr1::shared_ptr<const Slave> > slaves;
+  std::vector<std::tr1::shared_ptr<const Framework> > frameworks;
+};
+
+
+// Holds the latest snapshot. The master publishes new versions and
+// readers on any thread get the current one without copying it.
+class Snapshots
+{
+public:
+  Snapshots() : read(false) { pthread_mutex_init(&mutex, 0); }
+
+  ~Snapshots() { pthread_mutex_destroy(&mutex); }
+
+  void publish(const std::tr1::shared_ptr<const Snapshot>& snapshot)
+  {
+    Lock lock(&mutex);
+    current = snapshot;
+    read = false;
+  }
+
+  // Returns an empty pointer if nothing has been published yet
+  std::tr1::shared_ptr<const Snapshot> get()
+  {
+    Lock lock(&mutex);
+    read = true;
+    return current;
+  }
+
+  // Whether the current snapshot has been read since it was published
+  // (if not, there's nobody to publish a newer one for)
+  bool wasRead()
+  {
+    Lock lock(&mutex);
+    return read;
+  }
+
+private:
+  pthread_mutex_t mutex;
+  std::tr1::shared_ptr<const Snapshot> current;
+  bool read;
+};
+
+
+// Make a MasterState (owned by the caller) out of a snapshot, e.g. for
+// the web UI, filling in offer ages and totals along the way.
+MasterState *copySnapshot(const Snapshot& snapshot);
+
+#endif /* SWIG */
+
 }}}} /* namespace */
 
 #endif /* MASTER_STATE_HPP */
@@ -0,0 +1,559 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+#include <glog/logging.h>
+
+#include "state_log.hpp"
+
+#include "common/foreach.hpp"
+
+#include "messaging/messages.hpp"
+
+using std::ifstream;
+using std::ofstream;
+using std::istringstream;
+using std::make_pair;
+using std::numeric_limits;
+using std::ostringstream;
+
+using process::tuples::deserializer;
+using process::tuples::serializer;
+
+using namespace mesos;
+using namespace mesos::internal;
+using namespace mesos::internal::master;
+
+
+namespace {
+
+// Version of the records' format, kept in the file "format" in the
+// directory; changes whenever the format of any record does (including
+// that of what goes in them, such as Resources)
+const int FORMAT = 2;
+
+
+enum RecordType {
+  ADD_FRAMEWORK = 1,
+  REMOVE_FRAMEWORK,
+  ADD_SLAVE,
+  REMOVE_SLAVE,
+  ADD_TASK,
+  UPDATE_TASK,
+  REMOVE_TASK,
+  NEXT_IDS
+};
+
+
+string record(const LoggedFramework& framework)
+{
+  ostringstream out;
+  serializer s(out);
+  s & (int32_t) ADD_FRAMEWORK;
+  s & framework.id;
+  s & framework.name;
+  s & framework.user;
+  s & framework.executorInfo;
+  s & framework.pid;
+  return out.str();
+}
+
+
+string record(const LoggedSlave& slave)
+{
+  ostringstream out;
+  serializer s(out);
+  s & (int32_t) ADD_SLAVE;
+  s & slave.id;
+  s & slave.hostname;
+  s & slave.publicDns;
+  s & slave.resources;
+  s & slave.pid;
+  return out.str();
+}
+
+
+string record(const LoggedTask& task)
+{
+  ostringstream out;
+  serializer s(out);
+  s & (int32_t) ADD_TASK;
+  s & task.id;
+  s & task.frameworkId;
+  s & task.slaveId;
+  s & task.name;
+  s & task.resources;
+  s & task.state;
+  return out.str();
+}
+
+
+typedef map<pair<FrameworkID, TaskID>, LoggedTask>::iterator TaskIterator;
+
+
+// Add (or replace) a task in 'state', keeping its slave's index right
+void putTask(LoggedState *state, const LoggedTask& task)
+{
+  pair<FrameworkID, TaskID> key = make_pair(task.frameworkId, task.id);
+  TaskIterator it = state->tasks.find(key);
+  if (it != state->tasks.end() && it->second.slaveId != task.slaveId)
+    state->slaveTasks[it->second.slaveId].erase(key);
+  state->tasks[key] = task;
+  state->slaveTasks[task.slaveId].insert(key);
+}
+
+
+// Remove a task from 'state' and from its slave's index
+void eraseTask(LoggedState *state, TaskIterator it)
+{
+  map<SlaveID, set<pair<FrameworkID, TaskID> > >::iterator slave =
+    state->slaveTasks.find(it->second.slaveId);
+  if (slave != state->slaveTasks.end()) {
+    slave->second.erase(it->first);
+    if (slave->second.empty())
+      state->slaveTasks.erase(slave);
+  }
+  state->tasks.erase(it);
+}
+
+
+string record(int64_t nextFrameworkId, int64_t nextSlaveId)
+{
+  ostringstream out;
+  serializer s(out);
+  s & (int32_t) NEXT_IDS;
+  s & nextFrameworkId;
+  s & nextSlaveId;
+  return out.str();
+}
+
+
+// Prefix a record with its length so that a torn one can be detected
+string frame(const string& record)
+{
+  uint32_t length = htonl((uint32_t) record.size());
+  return string((const char *) &length, sizeof(length)) + record;
+}
+
+
+// Write all of 'data' to 'fd' or die trying
+void writeAll(int fd, const string& data, const string& path)
+{
+  size_t written = 0;
+  while (written < data.size()) {
+    ssize_t n = write(fd, data.data() + written, data.size() - written);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      LOG(FATAL) << "Failed to write to " << path << ": " << strerror(errno);
+    written += n;
+  }
+}
+
+} /* namespace */
+
+
+StateLog::StateLog(const string& _directory, int _compactEvery)
+  : directory(_directory), compactEvery(_compactEvery), fd(-1), records(0),
+    compacting(false)
+{
+  if (mkdir(directory.c_str(), 0755) < 0 && errno != EEXIST)
+    LOG(FATAL) << "Failed to create " << directory << ": " << strerror(errno);
+
+  checkFormat();
+
+  size_t end;
+  replay(directory + "/snapshot", &end);
+  bool oldLog = replay(directory + "/log.old", &end) > 0;
+
+  string path = directory + "/log";
+  records = replay(path, &end);
+
+  fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd < 0)
+    LOG(FATAL) << "Failed to open " << path << ": " << strerror(errno);
+
+  // Drop whatever a crash left of the last record
+  struct stat s;
+  if (fstat(fd, &s) == 0 && (size_t) s.st_size > end) {
+    LOG(WARNING) << "Dropping " << s.st_size - end << " bytes at the end of "
+                 << path;
+    if (ftruncate(fd, end) < 0)
+      LOG(FATAL) << "Failed to truncate " << path << ": " << strerror(errno);
+  }
+
+  LOG(INFO) << "Read " << state.frameworks.size() << " frameworks, "
+            << state.slaves.size() << " slaves and " << state.tasks.size()
+            << " tasks from " << directory;
+
+  // Finish the compaction we were stopped in the middle of, before the
+  // log gets moved over "log.old"
+  if (oldLog) {
+    compact();
+    finishCompaction();
+  }
+}
+
+
+StateLog::~StateLog()
+{
+  finishCompaction();
+  if (fd >= 0)
+    close(fd);
+}
+
+
+void StateLog::checkFormat()
+{
+  string path = directory + "/format";
+  ifstream in(path.c_str());
+  if (in.is_open()) {
+    int format = -1;
+    in >> format;
+    if (format != FORMAT)
+      LOG(FATAL) << "The state in " << directory << " is in format "
+                 << format << ", but this master only reads format "
+                 << FORMAT;
+    return;
+  }
+
+  // Only an empty directory can be started in our format
+  const char *files[] = { "snapshot", "log.old", "log" };
+  for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+    struct stat s;
+    string file = directory + "/" + files[i];
+    if (stat(file.c_str(), &s) == 0 && s.st_size > 0)
+      LOG(FATAL) << "The state in " << directory << " has no format "
+                 << "version, so it was written by an older master";
+  }
+
+  ofstream out(path.c_str());
+  out << FORMAT << "\n";
+  out.close();
+  if (out.fail())
+    LOG(FATAL) << "Failed to write " << path;
+}
+
+
+void StateLog::addFramework(const LoggedFramework& framework)
+{
+  append(record(framework));
+}
+
+
+void StateLog::removeFramework(const FrameworkID& frameworkId)
+{
+  ostringstream out;
+  serializer s(out);
+  s & (int32_t) REMOVE_FRAMEWORK;
+  s & frameworkId;
+  append(out.str());
+}
+
+
+void StateLog::addSlave(const LoggedSlave& slave)
+{
+  append(record(slave));
+}
+
+
+void StateLog::removeSlave(const SlaveID& slaveId)
+{
+  ostringstream out;
+  serializer s(out);
+  s & (int32_t) REMOVE_SLAVE;
+  s & slaveId;
+  append(out.str());
+}
+
+
+void StateLog::addTask(const Task& task)
+{
+  LoggedTask logged;
+  logged.id = task.id;
+  logged.frameworkId = task.frameworkId;
+  logged.slaveId = task.slaveId;
+  logged.name = task.name;
+  logged.resources = task.resources;
+  logged.state = task.state;
+  append(record(logged));
+}
+
+
+void StateLog::updateTask(const FrameworkID& frameworkId, TaskID taskId,
+                          TaskState taskState)
+{
+  ostringstream out;
+  serializer s(out);
+  s & (int32_t) UPDATE_TASK;
+  s & frameworkId;
+  s & (int32_t) taskId;
+  s & taskState;
+  append(out.str());
+}
+
+
+void StateLog::removeTask(const FrameworkID& frameworkId, TaskID taskId)
+{
+  ostringstream out;
+  serializer s(out);
+  s & (int32_t) REMOVE_TASK;
+  s & frameworkId;
+  s & (int32_t) taskId;
+  append(out.str());
+}
+
+
+void StateLog::setNextIds(int64_t nextFrameworkId, int64_t nextSlaveId)
+{
+  append(record(nextFrameworkId, nextSlaveId));
+}
+
+
+void StateLog::compact()
+{
+  // Write the state out as the records that would add it back
+  ostringstream out;
+  out << frame(record(state.nextFrameworkId, state.nextSlaveId));
+  foreachpair (_, const LoggedFramework& framework, state.frameworks)
+    out << frame(record(framework));
+  foreachpair (_, const LoggedSlave& slave, state.slaves)
+    out << frame(record(slave));
+  foreachpair (_, const LoggedTask& task, state.tasks)
+    out << frame(record(task));
+
+  // Only one snapshot is written at a time, so that "log.old" still
+  // holds everything since the last one when we move the log over it
+  finishCompaction();
+
+  // Start a new log, keeping the old one until the snapshot is on disk
+  string path = directory + "/log";
+  string old = directory + "/log.old";
+  close(fd);
+  if (rename(path.c_str(), old.c_str()) < 0)
+    LOG(FATAL) << "Failed to rename " << path << ": " << strerror(errno);
+  fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd < 0)
+    LOG(FATAL) << "Failed to open " << path << ": " << strerror(errno);
+
+  VLOG(1) << "Compacting " << records << " records in " << directory;
+  records = 0;
+
+  snapshot = out.str();
+  if (pthread_create(&compactor, 0, writeSnapshot, this) != 0)
+    LOG(FATAL) << "Failed to create state log compaction thread";
+  compacting = true;
+}
+
+
+void StateLog::finishCompaction()
+{
+  if (compacting) {
+    pthread_join(compactor, NULL);
+    compacting = false;
+    snapshot.clear();
+  }
+}
+
+
+void * StateLog::writeSnapshot(void *arg)
+{
+  StateLog *log = (StateLog *) arg;
+
+  // Replace the snapshot only once the new one is on disk, then delete
+  // the old log (if we crash in between, it just gets applied again)
+  string path = log->directory + "/snapshot";
+  string temp = path + ".tmp";
+  int snapshot = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (snapshot < 0)
+    LOG(FATAL) << "Failed to open " << temp << ": " << strerror(errno);
+  writeAll(snapshot, log->snapshot, temp);
+  if (fsync(snapshot) < 0)
+    LOG(FATAL) << "Failed to sync " << temp << ": " << strerror(errno);
+  close(snapshot);
+
+  if (rename(temp.c_str(), path.c_str()) < 0)
+    LOG(FATAL) << "Failed to rename " << temp << ": " << strerror(errno);
+
+  string old = log->directory + "/log.old";
+  if (unlink(old.c_str()) < 0 && errno != ENOENT)
+    LOG(FATAL) << "Failed to delete " << old << ": " << strerror(errno);
+
+  return NULL;
+}
+
+
+void StateLog::append(const string& record)
+{
+  apply(record);
+  writeAll(fd, frame(record), directory + "/log");
+  if (compactEvery > 0 && ++records >= compactEvery)
+    compact();
+}
+
+
+bool StateLog::apply(const string& record)
+{
+  istringstream in(record);
+  deserializer d(in);
+
+  int32_t type = 0;
+  d & type;
+
+  switch (type) {
+    case ADD_FRAMEWORK: {
+      LoggedFramework framework;
+      d & framework.id;
+      d & framework.name;
+      d & framework.user;
+      d & framework.executorInfo;
+      d & framework.pid;
+      if (!in.fail())
+        state.frameworks[framework.id] = framework;
+      break;
+    }
+
+    case REMOVE_FRAMEWORK: {
+      FrameworkID frameworkId;
+      d & frameworkId;
+      if (!in.fail()) {
+        state.frameworks.erase(frameworkId);
+        TaskIterator it =
+          state.tasks.lower_bound(make_pair(frameworkId,
+                                            numeric_limits<TaskID>::min()));
+        while (it != state.tasks.end() && it->first.first == frameworkId)
+          eraseTask(&state, it++);
+      }
+      break;
+    }
+
+    case ADD_SLAVE: {
+      LoggedSlave slave;
+      d & slave.id;
+      d & slave.hostname;
+      d & slave.publicDns;
+      d & slave.resources;
+      d & slave.pid;
+      if (!in.fail())
+        state.slaves[slave.id] = slave;
+      break;
+    }
+
+    case REMOVE_SLAVE: {
+      SlaveID slaveId;
+      d & slaveId;
+      if (!in.fail()) {
+        state.slaves.erase(slaveId);
+        map<SlaveID, set<pair<FrameworkID, TaskID> > >::iterator slave =
+          state.slaveTasks.find(slaveId);
+        if (slave != state.slaveTasks.end()) {
+          set<pair<FrameworkID, TaskID> >::iterator key;
+          for (key = slave->second.begin(); key != slave->second.end(); ++key)
+            state.tasks.erase(*key);
+          state.slaveTasks.erase(slave);
+        }
+      }
+      break;
+    }
+
+    case ADD_TASK: {
+      LoggedTask task;
+      d & task.id;
+      d & task.frameworkId;
+      d & task.slaveId;
+      d & task.name;
+      d & task.resources;
+      d & task.state;
+      if (!in.fail())
+        putTask(&state, task);
+      break;
+    }
+
+    case UPDATE_TASK: {
+      FrameworkID frameworkId;
+      int32_t taskId;
+      TaskState taskState;
+      d & frameworkId;
+      d & taskId;
+      d & taskState;
+      if (!in.fail()) {
+        TaskIterator it =
+          state.tasks.find(make_pair(frameworkId, (TaskID) taskId));
+        if (it != state.tasks.end())
+          it->second.state = taskState;
+      }
+      break;
+    }
+
+    case REMOVE_TASK: {
+      FrameworkID frameworkId;
+      int32_t taskId;
+      d & frameworkId;
+      d & taskId;
+      if (!in.fail()) {
+        TaskIterator it =
+          state.tasks.find(make_pair(frameworkId, (TaskID) taskId));
+        if (it != state.tasks.end())
+          eraseTask(&state, it);
+      }
+      break;
+    }
+
+    case NEXT_IDS: {
+      int64_t nextFrameworkId = 0, nextSlaveId = 0;
+      d & nextFrameworkId;
+      d & nextSlaveId;
+      if (!in.fail()) {
+        state.nextFrameworkId = nextFrameworkId;
+        state.nextSlaveId = nextSlaveId;
+      }
+      break;
+    }
+
+    default:
+      return false;
+  }
+
+  return !in.fail();
+}
+
+
+int StateLog::replay(const string& path, size_t *end)
+{
+  *end = 0;
+
+  ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+  if (!file.is_open())
+    return 0;
+
+  ostringstream contents;
+  contents << file.rdbuf();
+  const string data = contents.str();
+
+  int count = 0;
+  size_t offset = 0;
+  while (data.size() - offset >= sizeof(uint32_t)) {
+    uint32_t length;
+    memcpy(&length, data.data() + offset, sizeof(length));
+    length = ntohl(length);
+    if (data.size() - offset - sizeof(length) < length)
+      break; // Torn by a crash
+    if (!apply(data.substr(offset + sizeof(length), length)))
+      LOG(FATAL) << "Bad record at offset " << offset << " in " << path;
+    offset += sizeof(length) + length;
+    count++;
+  }
+
+  *end = offset;
+  return count;
+}
@@ -0,0 +1,174 @@
+#ifndef __MASTER_STATE_LOG_HPP__
+#define __MASTER_STATE_LOG_HPP__
+
+#include <pthread.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+
+#include <process.hpp>
+
+#include <mesos.hpp>
+#include <mesos_types.hpp>
+
+#include "common/resources.hpp"
+#include "common/task.hpp"
+
+
+namespace mesos { namespace internal { namespace master {
+
+using std::map;
+using std::pair;
+using std::set;
+using std::string;
+
+
+// What the state log remembers about a framework
+struct LoggedFramework
+{
+  FrameworkID id;
+  string name;
+  string user;
+  ExecutorInfo executorInfo;
+  PID pid;
+};
+
+
+// What the state log remembers about a slave
+struct LoggedSlave
+{
+  SlaveID id;
+  string hostname;
+  string publicDns;
+  Resources resources;
+  PID pid;
+};
+
+
+// What the state log remembers about a task: what a recovering master
+// needs to account for its resources (and not, e.g., its last message)
+struct LoggedTask
+{
+  TaskID id;
+  FrameworkID frameworkId;
+  SlaveID slaveId;
+  string name;
+  Resources resources;
+  TaskState state;
+};
+
+
+// Everything in a state log (tasks are keyed like in Slave::tasks)
+struct LoggedState
+{
+  LoggedState() : nextFrameworkId(0), nextSlaveId(0) {}
+
+  map<FrameworkID, LoggedFramework> frameworks;
+  map<SlaveID, LoggedSlave> slaves;
+  map<pair<FrameworkID, TaskID>, LoggedTask> tasks;
+
+  // The keys in 'tasks' of the tasks on each slave, so that removing a
+  // slave only looks at its own tasks
+  map<SlaveID, set<pair<FrameworkID, TaskID> > > slaveTasks;
+
+  // The master's counters for framework and slave IDs
+  int64_t nextFrameworkId;
+  int64_t nextSlaveId;
+};
+
+
+// A record on disk of the frameworks, slaves and tasks that the master
+// knows about, so that a master that takes over (or restarts) can start
+// from where the last one left off instead of waiting for every slave
+// and framework to re-register. Changes are appended to the file "log"
+// in a directory, and every so many of them the whole state is written
+// to the file "snapshot" instead, which replaces the log. Opening the
+// directory replays the snapshot, then "log.old" (a log that was being
+// replaced when we stopped) and then the log. The file "format" holds
+// the version of the records' format, and a directory in any other
+// format is a fatal error rather than being misread.
+//
+// Compacting serializes the whole state on the caller's thread, which
+// costs about as much as copying it, and moves the log aside to
+// "log.old". Writing and syncing the snapshot, which is the slow part,
+// happens on a thread of its own, after which "log.old" is deleted.
+//
+// Records can be applied more than once (so a log that a crash left
+// behind after its snapshot was written is harmless), and a record that
+// was only partly written is dropped. A whole record that can't be
+// parsed (e.g. one written by a newer master) is a fatal error rather
+// than being dropped with everything after it. Appends aren't synced to
+// disk, so a machine crash can lose the last few changes; the slaves
+// tell the next master about their tasks when they re-register anyway.
+class StateLog
+{
+public:
+  // Read back the state in 'directory' (creating it if needed), writing
+  // a snapshot every 'compactEvery' records (0 means never)
+  StateLog(const string& directory, int compactEvery);
+
+  ~StateLog();
+
+  const LoggedState& getState() const { return state; }
+
+  // Adding a framework or slave that's already there replaces it
+  void addFramework(const LoggedFramework& framework);
+
+  // Also forgets the framework's tasks
+  void removeFramework(const FrameworkID& frameworkId);
+
+  void addSlave(const LoggedSlave& slave);
+
+  // Also forgets the tasks on the slave
+  void removeSlave(const SlaveID& slaveId);
+
+  void addTask(const Task& task);
+
+  void updateTask(const FrameworkID& frameworkId, TaskID taskId,
+                  TaskState taskState);
+
+  void removeTask(const FrameworkID& frameworkId, TaskID taskId);
+
+  void setNextIds(int64_t nextFrameworkId, int64_t nextSlaveId);
+
+  // Start writing the whole state to the snapshot in the background
+  // and empty the log
+  void compact();
+
+  // Wait for the snapshot being written by compact(), if any
+  void finishCompaction();
+
+private:
+  // Die unless the directory is in our format, recording the format in
+  // it if it's new
+  void checkFormat();
+
+  // Apply a record to the state and write it to the log
+  void append(const string& record);
+
+  // Apply a record to the state, returning false if it can't be parsed
+  bool apply(const string& record);
+
+  // Apply the whole records in a file, returning how many there were
+  // and setting 'end' to the offset just past the last one
+  int replay(const string& path, size_t *end);
+
+  // Body of the thread that writes the snapshot for compact()
+  static void * writeSnapshot(void *arg);
+
+  const string directory;
+  const int compactEvery;
+  int fd;      // The log, open for appending
+  int records; // Records in the log since the last snapshot
+  LoggedState state;
+
+  bool compacting;  // Whether 'compactor' is running
+  pthread_t compactor;
+  string snapshot;  // What 'compactor' is writing
+};
+
+}}} /* namespace */
+
+#endif /* __MASTER_STATE_LOG_HPP__ */
@@ -0,0 +1,94 @@
+#include <sstream>
+
+#include <glog/logging.h>
+
+#include "task_table.hpp"
+
+#include "common/foreach.hpp"
+
+using std::ostringstream;
+
+using namespace mesos;
+using namespace mesos::internal;
+using namespace mesos::internal::master;
+
+
+TaskTable::TaskTable(size_t _chunkSize)
+  : chunkSize(_chunkSize), count(0)
+{
+  CHECK(chunkSize > 0);
+}
+
+
+TaskTable::~TaskTable()
+{
+  foreach (TaskRecord *chunk, chunks)
+    delete[] chunk;
+}
+
+
+TaskRecord * TaskTable::add(const Task& task)
+{
+  return add(task.id, task.frameworkId, task.resources, task.state,
+             task.name, task.slaveId);
+}
+
+
+TaskRecord * TaskTable::add(TaskID id, const FrameworkID& frameworkId,
+                            const Resources& resources, TaskState state,
+                            const string& name, const SlaveID& slaveId)
+{
+  TaskRecord *record = allocate();
+  record->id = id;
+  record->state = state;
+  record->framework = frameworkIds.acquire(frameworkId);
+  record->slave = slaveIds.acquire(slaveId);
+  record->name = names.acquire(name);
+  record->resources = resources;
+  return record;
+}
+
+
+TaskRecord * TaskTable::allocate()
+{
+  if (free.empty()) {
+    TaskRecord *chunk = new TaskRecord[chunkSize];
+    chunks.push_back(chunk);
+    free.reserve(capacity());
+    // Hand out the chunk from the front so that tasks added together
+    // end up next to each other
+    for (size_t i = chunkSize; i > 0; i--)
+      free.push_back(&chunk[i - 1]);
+  }
+
+  TaskRecord *record = free.back();
+  free.pop_back();
+  count++;
+  return record;
+}
+
+
+void TaskTable::remove(TaskRecord *task)
+{
+  CHECK(count > 0);
+  frameworkIds.release(task->framework);
+  slaveIds.release(task->slave);
+  names.release(task->name);
+  free.push_back(task);
+  count--;
+}
+
+
+Task TaskTable::task(const TaskRecord *task) const
+{
+  return Task(task->id, frameworkId(task), task->resources, task->state,
+              name(task), "", slaveId(task));
+}
+
+
+string TaskTable::describe(const TaskRecord *task) const
+{
+  ostringstream out;
+  out << "task " << frameworkId(task) << ":" << task->id;
+  return out.str();
+}
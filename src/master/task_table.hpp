@@ -0,0 +1,174 @@
+#ifndef __MASTER_TASK_TABLE_HPP__
+#define __MASTER_TASK_TABLE_HPP__
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
+#include <glog/logging.h>
+
+#include <mesos_types.hpp>
+
+#include "common/resources.hpp"
+#include "common/task.hpp"
+
+
+namespace mesos { namespace internal { namespace master {
+
+using std::deque;
+using std::string;
+using std::vector;
+using boost::unordered_map;
+
+
+// What the master keeps about a task. The IDs of its framework and slave
+// and its name are kept once in the TaskTable that holds it and referred
+// to by index, so a record holds no strings of its own.
+struct TaskRecord
+{
+  TaskID id;
+  TaskState state;
+  uint32_t framework; // Indexes into the table's framework IDs,
+  uint32_t slave;     // slave IDs and names
+  uint32_t name;
+  Resources resources;
+};
+
+
+// Where the master keeps its tasks. Records are carved out of chunks of
+// 'chunkSize' tasks and handed out again from a free list, so taking or
+// returning a record is O(1) and, once the table has grown to the number
+// of tasks the master runs, doesn't allocate. Records never move, so the
+// framework and slave indexes point straight at them. Chunks are only
+// freed with the table.
+//
+// The framework IDs, slave IDs and names that records refer to are each
+// kept once, for as long as some record uses them, so the thousands of
+// tasks of a framework on a slave cost one copy of each ID (and of their
+// name, if they share one). A whole Task is only built to be sent, put
+// in the state log or shown; tasks' status messages aren't kept at all.
+//
+// The framework and slave indexes are hash maps keyed by task ID, which
+// still allocate a node per task on add and free it on remove.
+class TaskTable
+{
+public:
+  explicit TaskTable(size_t chunkSize = 4096);
+
+  ~TaskTable();
+
+  // Fill in a free record from 'task' (all of it but its message)
+  TaskRecord * add(const Task& task);
+
+  // Fill in a free record (without building a Task to copy first)
+  TaskRecord * add(TaskID id, const FrameworkID& frameworkId,
+                   const Resources& resources, TaskState state,
+                   const string& name, const SlaveID& slaveId);
+
+  // Put a record back on the free list
+  void remove(TaskRecord *task);
+
+  const FrameworkID& frameworkId(const TaskRecord *task) const
+  {
+    return frameworkIds.get(task->framework);
+  }
+
+  const SlaveID& slaveId(const TaskRecord *task) const
+  {
+    return slaveIds.get(task->slave);
+  }
+
+  const string& name(const TaskRecord *task) const
+  {
+    return names.get(task->name);
+  }
+
+  // Build the whole task, with an empty message
+  Task task(const TaskRecord *task) const;
+
+  // Describe a task for logging, as "task <framework ID>:<task ID>"
+  string describe(const TaskRecord *task) const;
+
+  // Records in use
+  size_t size() const { return count; }
+
+  // Records in use or free
+  size_t capacity() const { return chunks.size() * chunkSize; }
+
+  // Distinct framework IDs, slave IDs and names in use
+  size_t strings() const
+  {
+    return frameworkIds.size() + slaveIds.size() + names.size();
+  }
+
+private:
+  // Values that are each kept once and referred to by index, counting
+  // the references so that a value goes once nothing refers to it
+  template <typename T>
+  class Pool
+  {
+  public:
+    uint32_t acquire(const T& value)
+    {
+      typename unordered_map<T, uint32_t>::iterator it = indexes.find(value);
+      if (it != indexes.end()) {
+        refs[it->second]++;
+        return it->second;
+      }
+      uint32_t index;
+      if (unused.empty()) {
+        index = values.size();
+        values.push_back(value);
+        refs.push_back(1);
+      } else {
+        index = unused.back();
+        unused.pop_back();
+        values[index] = value;
+        refs[index] = 1;
+      }
+      indexes[value] = index;
+      return index;
+    }
+
+    void release(uint32_t index)
+    {
+      CHECK(refs[index] > 0);
+      if (--refs[index] == 0) {
+        indexes.erase(values[index]);
+        values[index] = T();
+        unused.push_back(index);
+      }
+    }
+
+    const T& get(uint32_t index) const { return values[index]; }
+
+    size_t size() const { return indexes.size(); }
+
+  private:
+    deque<T> values; // A deque so that get()'s references stay good
+    vector<uint32_t> refs;
+    vector<uint32_t> unused;
+    unordered_map<T, uint32_t> indexes;
+  };
+
+  // Take a record off the free list, adding a chunk if there are none
+  TaskRecord * allocate();
+
+  TaskTable(const TaskTable&);
+  TaskTable& operator = (const TaskTable&);
+
+  const size_t chunkSize;
+  vector<TaskRecord *> chunks;
+  vector<TaskRecord *> free; // Has room for every record, so never reallocates
+  size_t count;
+
+  Pool<FrameworkID> frameworkIds;
+  Pool<SlaveID> slaveIds;
+  Pool<string> names;
+};
+
+}}} /* namespace */
+
+#endif /* __MASTER_TASK_TABLE_HPP__ */
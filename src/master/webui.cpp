@@ -17,7 +17,7 @@ extern "C" void init_master();  // Initializer for the Python master module
 
 namespace {
 
-PID master;
+mesos::internal::master::Master *master;
 string webuiPort;
 string logDir;
 
@@ -48,7 +48,7 @@ void *runMasterWebUI(void *)
 }
 
 
-void startMasterWebUI(const PID &master, const Params &params)
+void startMasterWebUI(Master *master, const Params &params)
 {
   // TODO(*): It would be nice if we didn't have to be specifying
   // default values for configuration options in the code like
@@ -70,31 +70,19 @@ void startMasterWebUI(const PID &master, const Params &params)
 
 namespace state {
 
-class StateGetter : public MesosProcess
-{
-public:
-  MasterState *masterState;
-
-  StateGetter() {}
-  ~StateGetter() {}
-
-  void operator () ()
-  {
-    send(::master, pack<M2M_GET_STATE>());
-    receive();
-    CHECK(msgid() == M2M_GET_STATE_REPLY);
-    masterState = unpack<M2M_GET_STATE_REPLY, 0>(body());
-  }
-};
-
-
 // From master_state.hpp
 MasterState *get_master()
 {
-  StateGetter getter;
-  PID pid = Process::spawn(&getter);
-  Process::wait(pid);
-  return getter.masterState;
+  // Copy the latest snapshot here, on the web UI's thread, rather than
+  // having the master copy its state for every page
+  std::tr1::shared_ptr<const Snapshot> snapshot = ::master->getSnapshot();
+  if (snapshot)
+    return copySnapshot(*snapshot);
+
+  Response response =
+    MesosProcess::request(::master->self(), pack<M2M_GET_STATE>()).get();
+  CHECK(response.id == M2M_GET_STATE_REPLY);
+  return unpack<M2M_GET_STATE_REPLY, 0>(MesosProcess::body(response));
 }
 
 } /* namespace state { */
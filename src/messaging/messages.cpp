@@ -22,6 +22,30 @@ void operator & (deserializer& d, master::state::MasterState *&state)
 }
 
 
+void operator & (serializer& s, const master::OfferReply *reply)
+{
+  s & (intptr_t &) reply;
+}
+
+
+void operator & (deserializer& d, master::OfferReply *&reply)
+{
+  d & (intptr_t &) reply;
+}
+
+
+void operator & (serializer& s, const master::Allocation *allocation)
+{
+  s & (intptr_t &) allocation;
+}
+
+
+void operator & (deserializer& d, master::Allocation *&allocation)
+{
+  d & (intptr_t &) allocation;
+}
+
+
 void operator & (serializer& s, const slave::state::SlaveState *state)
 {
   s & (intptr_t &) state;
@@ -98,6 +122,8 @@ void operator & (serializer& s, const SlaveOffer& offer)
 {
   s & offer.slaveId;
   s & offer.host;
+  s & offer.cpus;
+  s & offer.mem;
   s & offer.params;
 }
 
@@ -106,6 +132,8 @@ void operator & (deserializer& s, SlaveOffer& offer)
 {
   s & offer.slaveId;
   s & offer.host;
+  s & offer.cpus;
+  s & offer.mem;
   s & offer.params;
 }
 
@@ -115,6 +143,8 @@ void operator & (serializer& s, const TaskDescription& task)
   s & task.taskId;
   s & task.slaveId;
   s & task.name;
+  s & task.cpus;
+  s & task.mem;
   s & task.params;
   s & task.data;
 }
@@ -125,6 +155,8 @@ void operator & (deserializer& s, TaskDescription& task)
   s & task.taskId;
   s & task.slaveId;
   s & task.name;
+  s & task.cpus;
+  s & task.mem;
   s & task.params;
   s & task.data;
 }
@@ -191,15 +223,29 @@ void operator & (deserializer& s, Params& params)
 
 void operator & (serializer& s, const Resources& resources)
 {
-  s & resources.cpus;
-  s & resources.mem;
+  s & (int32_t) NUM_RESOURCES;
+  for (int i = 0; i < NUM_RESOURCES; i++)
+    s & resources.amounts[i];
 }
 
 
 void operator & (deserializer& s, Resources& resources)
 {
-  s & resources.cpus;
-  s & resources.mem;
+  // Skip any resources that a newer sender knows about and we don't,
+  // keeping the slots past NUM_RESOURCES zero
+  int32_t count = 0;
+  s & count;
+  resources = Resources();
+  if (count < 0 || count > MAX_RESOURCES) {
+    s.stream.setstate(std::ios::failbit);
+    return;
+  }
+  for (int32_t i = 0; i < count; i++) {
+    int32_t amount = 0;
+    s & amount;
+    if (i < NUM_RESOURCES)
+      resources.amounts[i] = amount;
+  }
 }
 
 void operator & (serializer& s, const Task& taskInfo)
@@ -224,4 +270,20 @@ void operator & (deserializer& s, Task& taskInfo)
   s & taskInfo.slaveId;
 }
 
+
+void operator & (serializer& s, const TaskStatus& status)
+{
+  s & status.taskId;
+  s & status.state;
+  s & status.data;
+}
+
+
+void operator & (deserializer& d, TaskStatus& status)
+{
+  d & status.taskId;
+  d & status.state;
+  d & status.data;
+}
+
 }} /* namespace mesos { namespace internal { */
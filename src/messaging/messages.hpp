@@ -9,6 +9,7 @@
 #include <vector>
 
 #include <reliable.hpp>
+#include <request.hpp>
 
 #include <tuples/tuples.hpp>
 
@@ -28,7 +29,11 @@
 
 namespace mesos { namespace internal {
 
-const std::string MESOS_MESSAGING_VERSION = "0";
+namespace master { struct OfferReply; struct Allocation; }
+
+// Messages with another version are dropped, so this changes whenever
+// the format of any message does (including the order of MessageType)
+const std::string MESOS_MESSAGING_VERSION = "1";
 
 enum MessageType {
   /* From framework to master. */
@@ -39,10 +44,12 @@ enum MessageType {
   F2M_REVIVE_OFFERS,
   F2M_KILL_TASK,
   F2M_FRAMEWORK_MESSAGE,
+  F2M_HINTS,
 
   F2F_SLOT_OFFER_REPLY,
   F2F_FRAMEWORK_MESSAGE,
   F2F_TASK_RUNNING_STATUS,
+  F2F_HINTS,
   
   /* From master to framework. */
   M2F_REGISTER_REPLY,
@@ -50,6 +57,7 @@ enum MessageType {
   M2F_RESCIND_OFFER,
   M2F_STATUS_UPDATE,
   M2F_FT_STATUS_UPDATE,
+  M2F_STATUS_UPDATES,
   M2F_LOST_SLAVE,
   M2F_FRAMEWORK_MESSAGE,
   M2F_ERROR,
@@ -60,6 +68,7 @@ enum MessageType {
   S2M_UNREGISTER_SLAVE,
   S2M_STATUS_UPDATE,
   S2M_FT_STATUS_UPDATE,
+  S2M_FT_STATUS_UPDATES,
   S2M_FRAMEWORK_MESSAGE,
   S2M_LOST_EXECUTOR,
 
@@ -74,16 +83,19 @@ enum MessageType {
   /* From master to slave. */
   M2S_REGISTER_REPLY,
   M2S_REREGISTER_REPLY,
-  M2S_RUN_TASK,
+  M2S_ADD_FRAMEWORK,
+  M2S_RUN_TASKS,
   M2S_KILL_TASK,
   M2S_KILL_FRAMEWORK,
   M2S_FRAMEWORK_MESSAGE,
   M2S_UPDATE_FRAMEWORK_PID,
+  M2S_UPDATE_FRAMEWORK_PIDS,
   M2S_SHUTDOWN, // Used in unit tests to shut down cluster
 
   /* From executor to slave. */
   E2S_REGISTER_EXECUTOR,
   E2S_STATUS_UPDATE,
+  E2S_STATUS_UPDATES,
   E2S_FRAMEWORK_MESSAGE,
 
   /* From slave to executor. */
@@ -108,6 +120,8 @@ enum MessageType {
   M2M_GET_STATE_REPLY,
   M2M_TIMER_TICK,        // Timer for expiring filters etc
   M2M_FRAMEWORK_EXPIRED, // Timer for expiring frameworks
+  M2M_DECODED_OFFER_REPLY, // Sent by decoder threads
+  M2M_ALLOCATION,        // Sent by the allocation thread
   M2M_SHUTDOWN,          // Used in tests to shut down master
 
   /* Internal to slave */
@@ -139,6 +153,22 @@ public:
     ReliableProcess::post(to, ID, data.data(), data.size());
   }
 
+  template <MSGID ID>
+  static Future<Response> request(const PID &to, const tuple<ID> &t,
+                                  double secs = 0)
+  {
+    const std::string &data = MESOS_MESSAGING_VERSION + "|" + std::string(t);
+    return ::request(to, ID, data.data(), data.size(), secs);
+  }
+
+  // Returns the body of a response (see request) without the version.
+  static std::string body(const Response &response)
+  {
+    size_t index = response.body.find('|');
+    CHECK(index != std::string::npos);
+    return response.body.substr(index + 1);
+  }
+
 protected:
   std::string body() const
   {
@@ -236,6 +266,10 @@ TUPLE(F2M_FRAMEWORK_MESSAGE,
       (FrameworkID,
        FrameworkMessage));
 
+TUPLE(F2M_HINTS,
+      (FrameworkID,
+       Params));
+
 TUPLE(F2F_SLOT_OFFER_REPLY,
       (OfferID,
        std::vector<TaskDescription>,
@@ -247,6 +281,9 @@ TUPLE(F2F_FRAMEWORK_MESSAGE,
 TUPLE(F2F_TASK_RUNNING_STATUS,
       ());
 
+TUPLE(F2F_HINTS,
+      (Params));
+
 TUPLE(M2F_REGISTER_REPLY,
       (FrameworkID));
 
@@ -268,6 +305,9 @@ TUPLE(M2F_FT_STATUS_UPDATE,
        TaskState,
        std::string));
 
+TUPLE(M2F_STATUS_UPDATES,
+      (std::vector<TaskStatus> /*in order*/));
+
 TUPLE(M2F_LOST_SLAVE,
       (SlaveID));
 
@@ -289,7 +329,8 @@ TUPLE(S2M_REREGISTER_SLAVE,
        std::string /*name*/,
        std::string /*publicDns*/,
        Resources,
-       std::vector<Task>));
+       std::vector<Task>,
+       std::vector<FrameworkID> /*frameworks with executors*/));
 
 TUPLE(S2M_UNREGISTER_SLAVE,
       (SlaveID));
@@ -308,6 +349,11 @@ TUPLE(S2M_FT_STATUS_UPDATE,
        TaskState,
        std::string));
 
+TUPLE(S2M_FT_STATUS_UPDATES,
+      (SlaveID,
+       FrameworkID,
+       std::vector<TaskStatus> /*in order*/));
+
 TUPLE(S2M_FRAMEWORK_MESSAGE,
       (SlaveID,
        FrameworkID,
@@ -316,7 +362,8 @@ TUPLE(S2M_FRAMEWORK_MESSAGE,
 TUPLE(S2M_LOST_EXECUTOR,
       (SlaveID,
        FrameworkID,
-       int32_t /*exitStatus*/));
+       int32_t /*exitStatus*/,
+       std::vector<TaskStatus> /*how its tasks ended, in order*/));
 
 TUPLE(SH2M_HEARTBEAT,
       (SlaveID));
@@ -339,17 +386,17 @@ TUPLE(M2S_REREGISTER_REPLY,
       (SlaveID,
        double /*heartbeat interval*/));
 
-TUPLE(M2S_RUN_TASK,
+TUPLE(M2S_ADD_FRAMEWORK,
       (FrameworkID,
-       TaskID,
        std::string /*frameworkName*/,
        std::string /*user*/,
        ExecutorInfo,
-       std::string /*taskName*/,
-       std::string /*taskArgs*/,
-       Params,
        PID /*framework PID*/));
 
+TUPLE(M2S_RUN_TASKS,
+      (FrameworkID, /*added with M2S_ADD_FRAMEWORK*/
+       std::vector<TaskDescription>));
+
 TUPLE(M2S_KILL_TASK,
       (FrameworkID,
        TaskID));
@@ -365,6 +412,9 @@ TUPLE(M2S_UPDATE_FRAMEWORK_PID,
       (FrameworkID,
        PID));
 
+TUPLE(M2S_UPDATE_FRAMEWORK_PIDS,
+      (std::map<FrameworkID, PID>));
+
 TUPLE(M2S_SHUTDOWN,
       ());
 
@@ -377,6 +427,10 @@ TUPLE(E2S_STATUS_UPDATE,
        TaskState,
        std::string));
 
+TUPLE(E2S_STATUS_UPDATES,
+      (FrameworkID,
+       std::vector<TaskStatus> /*in order*/));
+
 TUPLE(E2S_FRAMEWORK_MESSAGE,
       (FrameworkID,
        FrameworkMessage));
@@ -428,6 +482,12 @@ TUPLE(M2M_TIMER_TICK,
 TUPLE(M2M_FRAMEWORK_EXPIRED,
       (FrameworkID));
 
+TUPLE(M2M_DECODED_OFFER_REPLY,
+      (master::OfferReply *));
+
+TUPLE(M2M_ALLOCATION,
+      (master::Allocation *));
+
 TUPLE(M2M_SHUTDOWN,
       ());
 
@@ -453,6 +513,12 @@ TUPLE(S2S_SHUTDOWN,
 void operator & (process::tuples::serializer&, const master::state::MasterState *);
 void operator & (process::tuples::deserializer&, master::state::MasterState *&);
 
+void operator & (process::tuples::serializer&, const master::OfferReply *);
+void operator & (process::tuples::deserializer&, master::OfferReply *&);
+
+void operator & (process::tuples::serializer&, const master::Allocation *);
+void operator & (process::tuples::deserializer&, master::Allocation *&);
+
 void operator & (process::tuples::serializer&, const slave::state::SlaveState *);
 void operator & (process::tuples::deserializer&, slave::state::SlaveState *&);
 
@@ -495,6 +561,9 @@ void operator & (process::tuples::deserializer&, Resources&);
 void operator & (process::tuples::serializer&, const Task&);
 void operator & (process::tuples::deserializer&, Task&);
 
+void operator & (process::tuples::serializer&, const TaskStatus&);
+void operator & (process::tuples::deserializer&, TaskStatus&);
+
 
 /* Serialization functions for STL vectors. */
 
@@ -18,6 +18,7 @@
 #include <reliable.hpp>
 
 #include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/unordered_map.hpp>
 
 #include "common/fatal.hpp"
@@ -44,6 +45,7 @@ using std::string;
 using std::vector;
 
 using boost::bind;
+using boost::lexical_cast;
 using boost::ref;
 using boost::unordered_map;
 
@@ -115,6 +117,7 @@ private:
   ExecutorInfo execInfo;
   int32_t generation;
   PID master;
+  Params hints;
 
   volatile bool terminate;
 
@@ -141,6 +144,19 @@ public:
   ~SchedulerProcess() {}
 
 protected:
+  // Stop waiting to hear about a task that we launched
+  void taskStatusReceived(TaskID tid)
+  {
+    unordered_map <TaskID, RbReply *>::iterator it = rbReplies.find(tid);
+    if (it != rbReplies.end()) {
+      RbReply *rr = it->second;
+      send(rr->self(), pack<F2F_TASK_RUNNING_STATUS>());
+      wait(rr->self());
+      rbReplies.erase(tid);
+      delete rr;
+    }
+  }
+
   void operator () ()
   {
     // Get username of current user.
@@ -206,6 +222,10 @@ protected:
 
       case M2F_REGISTER_REPLY: {
         tie(frameworkId) = unpack<M2F_REGISTER_REPLY>(body());
+        // A new master (or a failed over framework) starts out without
+        // any of our hints, so send them again.
+        if (!hints.getMap().empty())
+          send(master, pack<F2M_HINTS>(frameworkId, hints));
         invoke(bind(&Scheduler::registered, sched, driver, frameworkId));
         break;
       }
@@ -215,7 +235,13 @@ protected:
         vector<SlaveOffer> offs;
         map<SlaveID, PID> pids;
         tie(oid, offs, pids) = unpack<M2F_SLOT_OFFER>(body());
-        
+
+        // Older frameworks look for the resources in the params
+        foreach (SlaveOffer &offer, offs) {
+          offer.params["cpus"] = lexical_cast<string>(offer.cpus);
+          offer.params["mem"] = lexical_cast<string>(offer.mem);
+        }
+
 	// Save all the slave PIDs that are part of this ofer so later
 	// we can send framework messages directly.
         foreachpair (const SlaveID &slaveId, const PID &pid, pids)
@@ -231,6 +257,18 @@ protected:
         Params params;
         tie(oid, tasks, params) = unpack<F2F_SLOT_OFFER_REPLY>(body());
 
+        // Fill in resources given only as params so that the master
+        // doesn't have to parse them
+        foreach (TaskDescription &task, tasks) {
+          if (task.cpus < 0 || task.mem < 0) {
+            Params taskParams(task.params);
+            if (task.cpus < 0)
+              task.cpus = taskParams.getInt32("cpus", -1);
+            if (task.mem < 0)
+              task.mem = taskParams.getInt64("mem", -1);
+          }
+        }
+
 	// Keep only the slave PIDs where we run tasks so we can send
 	// framework messages directly.
         foreach(const TaskDescription &task, tasks) {
@@ -252,6 +290,14 @@ protected:
         break;
       }
 
+      case F2F_HINTS: {
+        tie(hints) = unpack<F2F_HINTS>(body());
+        // If we haven't registered yet these get sent with the reply.
+        if (frameworkId != "")
+          send(master, pack<F2M_HINTS>(frameworkId, hints));
+        break;
+      }
+
       case F2F_FRAMEWORK_MESSAGE: {
         FrameworkMessage msg;
         tie(msg) = unpack<F2F_FRAMEWORK_MESSAGE>(body());
@@ -299,34 +345,52 @@ protected:
         }
         ack();
 
-	unordered_map <TaskID, RbReply *>::iterator it = rbReplies.find(tid);
-	if (it != rbReplies.end()) {
-	  RbReply *rr = it->second;
-	  send(rr->self(), pack<F2F_TASK_RUNNING_STATUS>());
-	  wait(rr->self());
-	  rbReplies.erase(tid);
-	  delete rr;
-	}
+        taskStatusReceived(tid);
 
         TaskStatus status(tid, state, data);
         invoke(bind(&Scheduler::statusUpdate, sched, driver, ref(status)));
         break;
       }
 
+      case S2M_FT_STATUS_UPDATES: {
+        SlaveID sid;
+        FrameworkID frameworkId;
+        vector<TaskStatus> statuses;
+        tie(sid, frameworkId, statuses) =
+          unpack<S2M_FT_STATUS_UPDATES>(body());
+
+        if (duplicate()) {
+          VLOG(1) << "Received a duplicate batch of " << statuses.size()
+                  << " status updates";
+          break;
+        }
+        ack();
+
+        foreach (const TaskStatus& status, statuses)
+          taskStatusReceived(status.taskId);
+
+        invoke(bind(&Scheduler::statusUpdates, sched, driver, ref(statuses)));
+        break;
+      }
+
+      case M2F_STATUS_UPDATES: {
+        vector<TaskStatus> statuses;
+        tie(statuses) = unpack<M2F_STATUS_UPDATES>(body());
+
+        foreach (const TaskStatus& status, statuses)
+          taskStatusReceived(status.taskId);
+
+        invoke(bind(&Scheduler::statusUpdates, sched, driver, ref(statuses)));
+        break;
+      }
+
       case M2F_STATUS_UPDATE: {
         TaskID tid;
         TaskState state;
         string data;
         tie(tid, state, data) = unpack<M2F_STATUS_UPDATE>(body());
 
-	unordered_map <TaskID, RbReply *>::iterator it = rbReplies.find(tid);
-	if (it != rbReplies.end()) {
-	  RbReply *rr = it->second;
-	  send(rr->self(), pack<F2F_TASK_RUNNING_STATUS>());
-	  wait(rr->self());
-	  rbReplies.erase(tid);
-	  delete rr;
-	}
+        taskStatusReceived(tid);
 
         TaskStatus status(tid, state, data);
         invoke(bind(&Scheduler::statusUpdate, sched, driver, ref(status)));
@@ -425,6 +489,16 @@ void Scheduler::error(SchedulerDriver* driver, int code, const string &message)
 }
 
 
+// Default implementation of Scheduler::statusUpdates that passes the
+// updates on to statusUpdate one at a time
+void Scheduler::statusUpdates(SchedulerDriver* driver,
+                              const vector<TaskStatus>& statuses)
+{
+  foreach (const TaskStatus& status, statuses)
+    statusUpdate(driver, status);
+}
+
+
 MesosSchedulerDriver::MesosSchedulerDriver(Scheduler* sched,
 					   const string &url,
 					   FrameworkID frameworkId)
@@ -701,9 +775,9 @@ int MesosSchedulerDriver::sendHints(const map<std::string, std::string>& hints)
     return -1;
   }
 
-  // TODO(*): Send the hints; for now, we do nothing
-  //error(1, "sendHints is not yet implemented");
-  return -1;
+  process->send(process->self(), pack<F2F_HINTS>(Params(hints)));
+
+  return 0;
 }
 
 
@@ -781,7 +855,9 @@ public:
     for (size_t i = 0; i < offers.size(); i++) {
       mesos_slot offer = { offers[i].slaveId.c_str(),
                            offers[i].host.c_str(),
-                           paramStrs[i].c_str() };
+                           paramStrs[i].c_str(),
+                           offers[i].cpus,
+                           offers[i].mem };
       c_offers[i] = offer;
     }
 
@@ -1098,6 +1174,11 @@ int mesos_sched_reply_to_offer(struct mesos_sched* sched,
                                        string(tasks[i].name),
                                        params,
                                        taskArg);
+
+    if (tasks[i].cpus != 0 || tasks[i].mem != 0) {
+      wrapped_tasks[i].cpus = tasks[i].cpus;
+      wrapped_tasks[i].mem = tasks[i].mem;
+    }
   }
 
   CScheduler* cs = lookupCScheduler(sched);
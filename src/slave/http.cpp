@@ -0,0 +1,108 @@
+#include <sstream>
+
+#include "http.hpp"
+
+#include "common/json.hpp"
+
+using std::ostringstream;
+
+using namespace mesos;
+using namespace mesos::internal;
+using namespace mesos::internal::slave;
+
+
+namespace {
+
+void writeStats(ostringstream& out, const state::SlaveState& state)
+{
+  int64_t usedCpus = 0, usedMem = 0, usedDisk = 0, usedNet = 0, tasks = 0;
+  foreach (state::Framework *f, state.frameworks) {
+    usedCpus += f->cpus;
+    usedMem += f->mem;
+    usedDisk += f->disk;
+    usedNet += f->net;
+    tasks += f->tasks.size();
+  }
+
+  out << "\"frameworks\":" << state.frameworks.size() << ","
+      << "\"tasks\":" << tasks << ","
+      << "\"total_cpus\":" << state.cpus << ","
+      << "\"total_mem\":" << state.mem << ","
+      << "\"total_disk\":" << state.disk << ","
+      << "\"total_net\":" << state.net << ","
+      << "\"used_cpus\":" << usedCpus << ","
+      << "\"used_mem\":" << usedMem << ","
+      << "\"used_disk\":" << usedDisk << ","
+      << "\"used_net\":" << usedNet << ","
+      << "\"proc_migrations\":" << ProcessStats::procMigrations() << ","
+      << "\"io_migrations\":" << ProcessStats::ioMigrations();
+}
+
+
+void writeState(ostringstream& out, const state::SlaveState& state)
+{
+  out << "\"build_date\":" << jsonString(state.build_date) << ","
+      << "\"build_user\":" << jsonString(state.build_user) << ","
+      << "\"id\":" << jsonString(state.id.s) << ","
+      << "\"pid\":" << jsonString(state.pid) << ","
+      << "\"master_pid\":" << jsonString(state.master_pid) << ","
+      << "\"cpus\":" << state.cpus << ","
+      << "\"mem\":" << state.mem << ","
+      << "\"disk\":" << state.disk << ","
+      << "\"net\":" << state.net << ",";
+
+  out << "\"frameworks\":[";
+  bool first = true;
+  foreach (state::Framework *f, state.frameworks) {
+    out << (first ? "" : ",") << "{"
+        << "\"id\":" << jsonString(f->id.s) << ","
+        << "\"name\":" << jsonString(f->name) << ","
+        << "\"executor_uri\":" << jsonString(f->executor_uri) << ","
+        << "\"executor_status\":" << jsonString(f->executor_status) << ","
+        << "\"cpus\":" << f->cpus << ","
+        << "\"mem\":" << f->mem << ","
+        << "\"disk\":" << f->disk << ","
+        << "\"net\":" << f->net << ","
+        << "\"tasks\":[";
+    first = false;
+
+    bool firstTask = true;
+    foreach (state::Task *t, f->tasks) {
+      out << (firstTask ? "" : ",") << "{"
+          << "\"id\":" << t->id << ","
+          << "\"name\":" << jsonString(t->name) << ","
+          << "\"state\":" << jsonString(taskStateName(t->state)) << ","
+          << "\"cpus\":" << t->cpus << ","
+          << "\"mem\":" << t->mem << ","
+          << "\"disk\":" << t->disk << ","
+          << "\"net\":" << t->net << "}";
+      firstTask = false;
+    }
+    out << "]}";
+  }
+  out << "]";
+}
+
+} /* namespace */
+
+
+void mesos::internal::slave::respondHttp(const HttpRequest& request,
+                                         const state::SlaveState& state)
+{
+  ostringstream out;
+  if (request.path == "/slave/state.json") {
+    out << "{";
+    writeState(out, state);
+    out << ",\"stats\":{";
+    writeStats(out, state);
+    out << "}}";
+  } else if (request.path == "/slave/stats.json") {
+    out << "{";
+    writeStats(out, state);
+    out << "}";
+  } else {
+    Process::respond(request.id, "404 Not Found", "text/plain", "");
+    return;
+  }
+  Process::respond(request.id, "200 OK", "application/json", out.str());
+}
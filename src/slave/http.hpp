@@ -0,0 +1,18 @@
+#ifndef __SLAVE_HTTP_HPP__
+#define __SLAVE_HTTP_HPP__
+
+#include <process.hpp>
+
+#include "state.hpp"
+
+
+namespace mesos { namespace internal { namespace slave {
+
+// Answer an HTTP request routed to the slave (see Process::route):
+//   /slave/state.json  frameworks and their tasks
+//   /slave/stats.json  counts and totals only (cheap to scrape)
+void respondHttp(const HttpRequest& request, const state::SlaveState& state);
+
+}}} /* namespace */
+
+#endif /* __SLAVE_HTTP_HPP__ */
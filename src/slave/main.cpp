@@ -35,6 +35,9 @@ int main(int argc, char **argv)
   Configurator conf;
   conf.addOption<string>("url", 'u', "Master URL");
   conf.addOption<string>("isolation", 'i', "Isolation module name", "process");
+  conf.addOption<string>("socket_dir",
+                         "Directory for Unix domain sockets used to talk\n"
+                         "to executors on this host (default: use TCP)");
 #ifdef MESOS_WEBUI
   conf.addOption<int>("webui_port", 'w', "Web UI port", 8081);
 #endif
@@ -62,6 +65,12 @@ int main(int argc, char **argv)
   }
   string url = params["url"];
 
+  // Have libprocess listen on (and prefer) Unix domain sockets for
+  // processes on this host; executors inherit the setting through
+  // the environment. This must happen before libprocess initializes.
+  if (params.contains("socket_dir"))
+    setenv("LIBPROCESS_SOCKET_DIR", params["socket_dir"].c_str(), true);
+
   string isolation = params["isolation"];
   LOG(INFO) << "Creating \"" << isolation << "\" isolation module";
   IsolationModule *isolationModule = IsolationModule::create(isolation);
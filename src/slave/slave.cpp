@@ -6,9 +6,12 @@
 #include <algorithm>
 #include <fstream>
 
+#include "http.hpp"
 #include "slave.hpp"
 #include "webui.hpp"
 
+#include "common/logging.hpp"
+
 // There's no gethostbyname2 on Solaris, so fake it by calling gethostbyname
 #ifdef __sun__
 #define gethostbyname2(name, _) gethostbyname(name)
@@ -78,14 +81,19 @@ const int32_t DEFAULT_MEM = 1 * Gigabyte;
 Slave::Slave(Resources _resources, bool _local,
              IsolationModule *_isolationModule)
   : id(""), resources(_resources), local(_local),
-    isolationModule(_isolationModule) {}
+    isolationModule(_isolationModule), statusUpdateInterval(0),
+    statusUpdateBatchSize(0) {}
 
 
 Slave::Slave(const Params& _conf, bool _local, IsolationModule *_module)
   : id(""), conf(_conf), local(_local), isolationModule(_module)
 {
   resources = Resources(conf.get<int32_t>("cpus", DEFAULT_CPUS),
-                        conf.get<int32_t>("mem", DEFAULT_MEM));
+                        conf.get<int32_t>("mem", DEFAULT_MEM),
+                        conf.get<int32_t>("disk", 0),
+                        conf.get<int32_t>("net", 0));
+  statusUpdateInterval = conf.get<double>("status_update_interval", 0.0);
+  statusUpdateBatchSize = conf.get<int>("status_update_batch_size", 0);
 }
 
 
@@ -95,6 +103,12 @@ void Slave::registerOptions(Configurator* conf)
                            DEFAULT_CPUS);
   conf->addOption<int64_t>("mem", 'm', "Memory for use by tasks, in MB\n",
                            DEFAULT_MEM);
+  conf->addOption<int32_t>("disk", "Disk space for use by tasks, in MB\n"
+                           "(0 means it isn't offered)",
+                           0);
+  conf->addOption<int32_t>("net", "Network bandwidth for use by tasks, in\n"
+                           "Mbit/s (0 means it isn't offered)",
+                           0);
   conf->addOption<string>("work_dir",
                           "Where to place framework work directories\n"
                           "(default: MESOS_HOME/work)");
@@ -108,6 +122,15 @@ void Slave::registerOptions(Configurator* conf)
                         "submitted them rather than the user running\n"
                         "the slave (requires setuid permission)\n",
                         true);
+  conf->addOption<double>("status_update_interval",
+                          "Seconds that task status updates can wait to be\n"
+                          "sent to the master together with later ones (0\n"
+                          "means send each batch from an executor right away)",
+                          0.0);
+  conf->addOption<int>("status_update_batch_size",
+                       "Maximum number of status updates to send in one\n"
+                       "message (0 means no limit)",
+                       0);
 }
 
 
@@ -124,17 +147,19 @@ state::SlaveState *Slave::getState()
   std::ostringstream master_pid;
   master_pid << master;
   state::SlaveState *state =
-    new state::SlaveState(BUILD_DATE, BUILD_USER, id, resources.cpus, 
-        resources.mem, my_pid.str(), master_pid.str());
+    new state::SlaveState(BUILD_DATE, BUILD_USER, id, resources.cpus(), 
+        resources.mem(), resources.disk(), resources.net(), my_pid.str(),
+        master_pid.str());
 
   foreachpair(_, Framework *f, frameworks) {
     state::Framework *framework = new state::Framework(f->id, f->name, 
-        f->executorInfo.uri, f->executorStatus, f->resources.cpus,
-        f->resources.mem);
+        f->executorInfo.uri, f->executorStatus, f->resources.cpus(),
+        f->resources.mem(), f->resources.disk(), f->resources.net());
     state->frameworks.push_back(framework);
     foreachpair(_, Task *t, f->tasks) {
       state::Task *task = new state::Task(t->id, t->name, t->state,
-          t->resources.cpus, t->resources.mem);
+          t->resources.cpus(), t->resources.mem(), t->resources.disk(),
+          t->resources.net());
       framework->tasks.push_back(task);
     }
   }
@@ -164,8 +189,12 @@ void Slave::operator () ()
   // Initialize isolation module.
   isolationModule->initialize(this);
 
+  // Serve /slave/state.json and /slave/stats.json on our port
+  Process::route("/slave", self());
+
   while (true) {
-    switch (receive()) {
+    double timeout = flushStatusUpdates();
+    switch (timeout > 0 ? receive(timeout) : receive()) {
       case NEW_MASTER_DETECTED: {
 	string masterSeq;
 	PID masterPid;
@@ -184,8 +213,10 @@ void Slave::operator () ()
 	  // Reconnecting, so reconstruct resourcesInUse for the master.
 	  Resources resourcesInUse; 
 	  vector<Task> taskVec;
+	  vector<FrameworkID> frameworkIds;
 
 	  foreachpair(_, Framework *framework, frameworks) {
+	    frameworkIds.push_back(framework->id);
 	    foreachpair(_, Task *task, framework->tasks) {
 	      resourcesInUse += task->resources;
 	      Task ti = *task;
@@ -194,7 +225,9 @@ void Slave::operator () ()
 	    }
 	  }
 
-	  send(master, pack<S2M_REREGISTER_SLAVE>(id, hostname, publicDns, resources, taskVec));
+	  send(master, pack<S2M_REREGISTER_SLAVE>(id, hostname, publicDns,
+						  resources, taskVec,
+						  frameworkIds));
 	}
 	break;
       }
@@ -225,38 +258,60 @@ void Slave::operator () ()
         break;
       }
       
-      case M2S_RUN_TASK: {
-	FrameworkID frameworkId;
-        TaskID tid;
-        string fwName, user, taskName, taskArg;
+      case M2S_ADD_FRAMEWORK: {
+        FrameworkID frameworkId;
+        string fwName, user;
         ExecutorInfo execInfo;
-        Params params;
         PID pid;
-        tie(frameworkId, tid, fwName, user, execInfo,
-            taskName, taskArg, params, pid) = unpack<M2S_RUN_TASK>(body());
-        LOG(INFO) << "Got assigned task " << frameworkId << ":" << tid;
-        Resources res;
-        res.cpus = params.getInt32("cpus", -1);
-        res.mem = params.getInt64("mem", -1);
-        Framework *framework = getFramework(frameworkId);
-        if (framework == NULL) {
-          // Framework not yet created on this node - create it.
-          framework = new Framework(frameworkId, fwName, user, execInfo, pid);
+        tie(frameworkId, fwName, user, execInfo, pid) =
+          unpack<M2S_ADD_FRAMEWORK>(body());
+        if (getFramework(frameworkId) == NULL) {
+          // Start the framework's executor; its tasks come next
+          LOG(INFO) << "Adding framework " << frameworkId;
+          Framework *framework =
+            new Framework(frameworkId, fwName, user, execInfo, pid);
           frameworks[frameworkId] = framework;
           isolationModule->startExecutor(framework);
         }
-        Task *task = framework->addTask(tid, taskName, res);
+        break;
+      }
+
+      case M2S_RUN_TASKS: {
+        FrameworkID frameworkId;
+        vector<mesos::TaskDescription> tasks;
+        tie(frameworkId, tasks) = unpack<M2S_RUN_TASKS>(body());
+        Framework *framework = getFramework(frameworkId);
+        if (framework == NULL) {
+          // The executor went away after the master sent these. Report
+          // just these tasks lost: by now the master may have started a
+          // new executor here, whose tasks a lost executor would take.
+          LOG(WARNING) << "Got " << tasks.size() << " tasks for UNKNOWN "
+                       << "framework " << frameworkId;
+          foreach (const mesos::TaskDescription& t, tasks)
+            send(master, pack<S2M_STATUS_UPDATE>(id, frameworkId, t.taskId,
+                                                 TASK_LOST, ""));
+          break;
+        }
         Executor *executor = getExecutor(frameworkId);
-        if (executor) {
-          send(executor->pid,
-               pack<S2E_RUN_TASK>(tid, taskName, taskArg, params));
-          isolationModule->resourcesChanged(framework);
-        } else {
-          // Executor not yet registered; queue task for when it starts up
-          TaskDescription *td = new TaskDescription(
-              tid, taskName, taskArg, params.str());
-          framework->queuedTasks.push_back(td);
+        foreach (const mesos::TaskDescription& t, tasks) {
+          LOG_RATE_LIMITED(INFO) << "Got assigned task " << frameworkId
+                                 << ":" << t.taskId;
+          Params params(t.params);
+          Resources res(t.cpus, t.mem);
+          res.readParams(t.params);
+          framework->addTask(t.taskId, t.name, res);
+          if (executor) {
+            send(executor->pid,
+                 pack<S2E_RUN_TASK>(t.taskId, t.name, t.data, params));
+          } else {
+            // Executor not yet registered; queue task for when it starts up
+            TaskDescription *td = new TaskDescription(
+                t.taskId, t.name, t.data, params.str());
+            framework->queuedTasks.push_back(td);
+          }
         }
+        if (executor)
+          isolationModule->resourcesChanged(framework);
         break;
       }
 
@@ -315,6 +370,20 @@ void Slave::operator () ()
         break;
       }
 
+      case M2S_UPDATE_FRAMEWORK_PIDS: {
+        map<FrameworkID, PID> pids;
+        tie(pids) = unpack<M2S_UPDATE_FRAMEWORK_PIDS>(body());
+        foreachpair (const FrameworkID& frameworkId, const PID& pid, pids) {
+          Framework *framework = getFramework(frameworkId);
+          if (framework != NULL) {
+            LOG(INFO) << "Updating framework " << frameworkId
+                      << " pid to " << pid;
+            framework->pid = pid;
+          }
+        }
+        break;
+      }
+
       case E2S_REGISTER_EXECUTOR: {
         FrameworkID frameworkId;
         tie(frameworkId) = unpack<E2S_REGISTER_EXECUTOR>(body());
@@ -354,22 +423,9 @@ void Slave::operator () ()
 
         Framework *framework = getFramework(frameworkId);
         if (framework != NULL) {
-	  LOG(INFO) << "Got status update for task "
-                    << frameworkId << ":" << tid;
-	  if (taskState == TASK_FINISHED || taskState == TASK_FAILED ||
-	      taskState == TASK_KILLED || taskState == TASK_LOST) {
-	    LOG(INFO) << "Task " << frameworkId << ":" << tid << " done";
-
-            framework->removeTask(tid);
-            isolationModule->resourcesChanged(framework);
-          }
-
-	  // Reliably send message and save sequence number for
-	  // canceling later.
-	  int seq = rsend(master, framework->pid,
-			  pack<S2M_FT_STATUS_UPDATE>(id, frameworkId, tid,
-						     taskState, data));
-	  seqs[frameworkId].insert(seq);
+          queueStatusUpdates(framework,
+                             vector<TaskStatus>(1, TaskStatus(tid, taskState,
+                                                              data)));
 	} else {
 	  LOG(WARNING) << "Got status update for UNKNOWN task "
 		       << frameworkId << ":" << tid;
@@ -377,6 +433,21 @@ void Slave::operator () ()
         break;
       }
 
+      case E2S_STATUS_UPDATES: {
+        FrameworkID frameworkId;
+        vector<TaskStatus> statuses;
+        tie(frameworkId, statuses) = unpack<E2S_STATUS_UPDATES>(body());
+
+        Framework *framework = getFramework(frameworkId);
+        if (framework != NULL) {
+          queueStatusUpdates(framework, statuses);
+        } else {
+          LOG(WARNING) << "Got " << statuses.size() << " status updates "
+                       << "for UNKNOWN framework " << frameworkId;
+        }
+        break;
+      }
+
       case E2S_FRAMEWORK_MESSAGE: {
         FrameworkID frameworkId;
         FrameworkMessage message;
@@ -384,8 +455,8 @@ void Slave::operator () ()
 
         Framework *framework = getFramework(frameworkId);
         if (framework != NULL) {
-	  LOG(INFO) << "Sending message for framework " << frameworkId
-		    << " to " << framework->pid;
+	  LOG_RATE_LIMITED(INFO) << "Sending message for framework "
+                                 << frameworkId << " to " << framework->pid;
 
           // Set slave ID in case framework omitted it.
           message.slaveId = this->id;
@@ -401,6 +472,15 @@ void Slave::operator () ()
 	break;
       }
 
+      case PROCESS_HTTP: {
+        size_t length;
+        const char *data = ReliableProcess::body(&length);
+        state::SlaveState *state = getState();
+        respondHttp(HttpRequest(data, length), *state);
+        delete state;
+        break;
+      }
+
       case PROCESS_EXIT: {
         LOG(INFO) << "Process exited: " << from();
 
@@ -418,7 +498,7 @@ void Slave::operator () ()
 			<< " disconnected";
 	      Framework *framework = getFramework(ex->frameworkId);
 	      if (framework != NULL) {
-		send(master, pack<S2M_LOST_EXECUTOR>(id, ex->frameworkId, -1));
+		executorLost(framework, -1);
 		killFramework(framework);
 	      }
 	      break;
@@ -447,6 +527,11 @@ void Slave::operator () ()
         return;
       }
 
+      case PROCESS_TIMEOUT: {
+        // Time to send some status updates
+        break;
+      }
+
       default: {
         LOG(ERROR) << "Received unknown message ID " << msgid()
                    << " from " << from();
@@ -489,12 +574,116 @@ void Slave::sendQueuedTasks(Framework *framework)
 }
 
 
+void Slave::queueStatusUpdates(Framework *framework,
+                               const vector<TaskStatus>& statuses)
+{
+  bool tasksEnded = false;
+  foreach (const TaskStatus& status, statuses) {
+    VLOG(1) << "Got status update for task " << framework->id << ":"
+            << status.taskId;
+    if (status.state == TASK_FINISHED || status.state == TASK_FAILED ||
+        status.state == TASK_KILLED || status.state == TASK_LOST) {
+      VLOG(1) << "Task " << framework->id << ":" << status.taskId << " done";
+      framework->removeTask(status.taskId);
+      tasksEnded = true;
+    }
+    framework->statusUpdates.push_back(status);
+  }
+
+  if (tasksEnded)
+    isolationModule->resourcesChanged(framework);
+
+  if (statusUpdateInterval <= 0 ||
+      (statusUpdateBatchSize > 0 &&
+       framework->statusUpdates.size() >= statusUpdateBatchSize)) {
+    sendStatusUpdates(framework);
+  } else if (framework->statusUpdates.size() == statuses.size()) {
+    // These are the first ones waiting
+    framework->statusUpdatesDeadline = elapsed() + statusUpdateInterval;
+  }
+}
+
+
+void Slave::sendStatusUpdates(Framework *framework)
+{
+  const vector<TaskStatus>& updates = framework->statusUpdates;
+  if (updates.empty())
+    return;
+
+  size_t batchSize = statusUpdateBatchSize > 0
+    ? statusUpdateBatchSize : updates.size();
+
+  VLOG(1) << "Sending " << updates.size() << " status updates for framework "
+          << framework->id;
+
+  // Reliably send each batch and save its sequence number for
+  // canceling later. A lone update goes as a plain status update.
+  for (size_t i = 0; i < updates.size(); i += batchSize) {
+    size_t end = std::min(i + batchSize, updates.size());
+    int seq;
+    if (end - i == 1) {
+      const TaskStatus& status = updates[i];
+      seq = rsend(master, framework->pid,
+                  pack<S2M_FT_STATUS_UPDATE>(id, framework->id,
+                                             status.taskId, status.state,
+                                             status.data));
+    } else {
+      vector<TaskStatus> batch(updates.begin() + i, updates.begin() + end);
+      seq = rsend(master, framework->pid,
+                  pack<S2M_FT_STATUS_UPDATES>(id, framework->id, batch));
+    }
+    seqs[framework->id].insert(seq);
+  }
+
+  framework->statusUpdates.clear();
+  framework->statusUpdatesDeadline = 0;
+}
+
+
+double Slave::flushStatusUpdates()
+{
+  if (statusUpdateInterval <= 0)
+    return 0;
+
+  double now = elapsed();
+  double next = 0;
+  foreachpair (_, Framework *framework, frameworks) {
+    if (framework->statusUpdates.empty())
+      continue;
+    if (framework->statusUpdatesDeadline <= now)
+      sendStatusUpdates(framework);
+    else if (next == 0 || framework->statusUpdatesDeadline < next)
+      next = framework->statusUpdatesDeadline;
+  }
+
+  return next > 0 ? next - now : 0;
+}
+
+
+// Tell the master that a framework's executor is gone, along with how
+// its tasks ended: the status updates we were holding for it, and then
+// TASK_LOST for the tasks that were still running in it. The held
+// updates go in this message rather than ahead of it because
+// killFramework() stops retrying the framework's reliable messages.
+void Slave::executorLost(Framework *framework, int32_t status)
+{
+  vector<TaskStatus> statuses = framework->statusUpdates;
+  framework->statusUpdates.clear();
+  framework->statusUpdatesDeadline = 0;
+  foreachpair (TaskID tid, _, framework->tasks)
+    statuses.push_back(TaskStatus(tid, TASK_LOST, ""));
+  send(master, pack<S2M_LOST_EXECUTOR>(id, framework->id, status, statuses));
+}
+
+
 // Kill a framework (including its executor if killExecutor is true).
 void Slave::killFramework(Framework *framework, bool killExecutor)
 {
   LOG(INFO) << "Cleaning up framework " << framework->id;
 
-  // Cancel sending any reliable messages for this framework.
+  // Cancel sending any reliable messages for this framework. Status
+  // updates we were still holding are dropped too: either the master
+  // removed the framework, or they went with S2M_LOST_EXECUTOR.
   foreach (int seq, seqs[framework->id])
     cancel(seq);
 
@@ -533,7 +722,7 @@ void Slave::executorExited(FrameworkID frameworkId, int status)
   if (Framework *f = getFramework(frameworkId)) {
     LOG(INFO) << "Executor for framework " << frameworkId << " exited "
               << "with status " << status;
-    send(master, pack<S2M_LOST_EXECUTOR>(id, frameworkId, status));
+    executorLost(f, status);
     killFramework(f, false);
   }
 };
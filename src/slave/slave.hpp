@@ -90,10 +90,16 @@ struct Framework
   // Information about the status of the executor for this framework, set by
   // the isolation module. For example, this might include a PID, a VM ID, etc.
   string executorStatus;
+
+  // Status updates waiting to be sent to the master together, in order,
+  // and when they have to be sent by
+  vector<TaskStatus> statusUpdates;
+  double statusUpdatesDeadline;
   
   Framework(FrameworkID _id, const string& _name, const string& _user,
             const ExecutorInfo& _executorInfo, const PID& _pid)
-    : id(_id), name(_name), user(_user), executorInfo(_executorInfo), pid(_pid) {}
+    : id(_id), name(_name), user(_user), executorInfo(_executorInfo), pid(_pid),
+      statusUpdatesDeadline(0) {}
 
   ~Framework()
   {
@@ -180,6 +186,12 @@ public:
   // Sequence numbers of reliable messages sent on behalf of framework.
   unordered_map<FrameworkID, unordered_set<int> > seqs;
 
+  // How long status updates can wait to be batched with others (0 means
+  // they're sent right away), and how many can go in one message (0
+  // means no limit)
+  double statusUpdateInterval;
+  int statusUpdateBatchSize;
+
 public:
   Slave(Resources resources, bool local, IsolationModule* isolationModule);
 
@@ -211,6 +223,20 @@ protected:
   // Send any tasks queued up for the given framework to its executor
   // (needed if we received tasks while the executor was starting up).
   void sendQueuedTasks(Framework *framework);
+
+  // Queue status updates from a framework's executor to be sent to the
+  // master (right away unless batching them)
+  void queueStatusUpdates(Framework *framework,
+                          const vector<TaskStatus>& statuses);
+
+  // Send a framework's queued status updates to the master
+  void sendStatusUpdates(Framework *framework);
+
+  void executorLost(Framework *framework, int32_t status);
+
+  // Send the status updates that have waited long enough, returning the
+  // seconds until the next ones have to be sent (or 0)
+  double flushStatusUpdates();
 };
 
 }}}
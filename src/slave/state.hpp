@@ -17,8 +17,9 @@ namespace mesos { namespace internal { namespace slave { namespace state {
 struct Task
 {
   Task(TaskID id_, const std::string& name_, TaskState state_,
-      int32_t cpus_, int64_t mem_)
-    : id(id_), name(name_), state(state_), cpus(cpus_), mem(mem_) {}
+      int32_t cpus_, int64_t mem_, int32_t disk_, int32_t net_)
+    : id(id_), name(name_), state(state_), cpus(cpus_), mem(mem_),
+      disk(disk_), net(net_) {}
 
   Task() {}
 
@@ -27,15 +28,18 @@ struct Task
   TaskState state;
   int32_t cpus;
   int64_t mem;
+  int32_t disk;
+  int32_t net;
 };
 
 struct Framework
 {
   Framework(FrameworkID id_, const std::string& name_,
       const std::string& executor_uri_, const std::string& executor_status_,
-      int32_t cpus_, int64_t mem_)
+      int32_t cpus_, int64_t mem_, int32_t disk_, int32_t net_)
     : id(id_), name(name_), executor_uri(executor_uri_),
-      executor_status(executor_status_), cpus(cpus_), mem(mem_) {}
+      executor_status(executor_status_), cpus(cpus_), mem(mem_),
+      disk(disk_), net(net_) {}
 
   Framework() {}
 
@@ -51,6 +55,8 @@ struct Framework
   std::string executor_status;
   int32_t cpus;
   int64_t mem;
+  int32_t disk;
+  int32_t net;
 
   std::vector<Task *> tasks;
 };
@@ -58,10 +64,12 @@ struct Framework
 struct SlaveState
 {
   SlaveState(const std::string& build_date_, const std::string& build_user_,
-	     SlaveID id_, int32_t cpus_, int64_t mem_, const std::string& pid_,
+	     SlaveID id_, int32_t cpus_, int64_t mem_, int32_t disk_,
+	     int32_t net_, const std::string& pid_,
 	     const std::string& master_pid_)
     : build_date(build_date_), build_user(build_user_), id(id_),
-      cpus(cpus_), mem(mem_), pid(pid_), master_pid(master_pid_) {}
+      cpus(cpus_), mem(mem_), disk(disk_), net(net_), pid(pid_),
+      master_pid(master_pid_) {}
 
   SlaveState() {}
 
@@ -76,6 +84,8 @@ struct SlaveState
   SlaveID id;
   int32_t cpus;
   int64_t mem;
+  int32_t disk;
+  int32_t net;
   std::string pid;
   std::string master_pid;
 
@@ -79,31 +79,13 @@ void startSlaveWebUI(const PID &slave, const Params &params)
 
 namespace state {
 
-class StateGetter : public MesosProcess
-{
-public:
-  SlaveState *slaveState;
-
-  StateGetter() {}
-  ~StateGetter() {}
-
-  void operator () ()
-  {
-    send(::slave, pack<S2S_GET_STATE>());
-    receive();
-    CHECK(msgid() == S2S_GET_STATE_REPLY);
-    slaveState = unpack<S2S_GET_STATE_REPLY, 0>(body());
-  }
-};
-
-
 // From slave_state.hpp
 SlaveState *get_slave()
 {
-  StateGetter getter;
-  PID pid = Process::spawn(&getter);
-  Process::wait(pid);
-  return getter.slaveState;
+  Response response =
+    MesosProcess::request(::slave, pack<S2S_GET_STATE>()).get();
+  CHECK(response.id == S2S_GET_STATE_REPLY);
+  return unpack<S2S_GET_STATE_REPLY, 0>(MesosProcess::body(response));
 }
 
 } /* namespace state { */
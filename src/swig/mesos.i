@@ -33,6 +33,7 @@
   /* Declare template instantiations we will use */
   %template(SlaveOfferVector) std::vector<mesos::SlaveOffer>;
   %template(TaskDescriptionVector) std::vector<mesos::TaskDescription>;
+  %template(TaskStatusVector) std::vector<mesos::TaskStatus>;
   %template(StringMap) std::map<std::string, std::string>;
 #endif /* SWIGPYTHON */
 
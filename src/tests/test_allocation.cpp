@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+
+#include <boost/lexical_cast.hpp>
+
+#include "master/allocation.hpp"
+
+using std::make_pair;
+using std::string;
+
+using boost::lexical_cast;
+
+using namespace mesos;
+using namespace mesos::internal;
+using namespace mesos::internal::master;
+
+
+// A request for 'frameworks' frameworks (with no resources yet) and
+// 'slaves' slaves with 1 CPU and 1 GB each
+static AllocationRequest makeRequest(int frameworks, int slaves)
+{
+  AllocationRequest request;
+  for (int i = 0; i < frameworks; i++) {
+    request.frameworks.push_back("framework" + lexical_cast<string>(i));
+    request.resources.push_back(Resources());
+  }
+  for (int i = 0; i < slaves; i++) {
+    Resources resources(1, 1 * Gigabyte);
+    request.free.push_back(make_pair("slave" + lexical_cast<string>(i),
+                                     resources));
+    request.total += resources;
+  }
+  return request;
+}
+
+
+TEST(AllocationTest, FirstFrameworkGetsEverything)
+{
+  AllocationRequest request = makeRequest(2, 4);
+  Allocation allocation;
+  allocate(request, &allocation);
+  ASSERT_EQ(1, allocation.offers.size());
+  EXPECT_EQ("framework0", allocation.offers[0].first.s);
+  EXPECT_EQ(4, allocation.offers[0].second.size());
+}
+
+
+TEST(AllocationTest, ExcludedSlavesGoToNextFramework)
+{
+  AllocationRequest request = makeRequest(2, 4);
+  request.excluded["framework0"].insert("slave1");
+  Allocation allocation;
+  allocate(request, &allocation);
+  ASSERT_EQ(2, allocation.offers.size());
+  EXPECT_EQ(3, allocation.offers[0].second.size());
+  ASSERT_EQ(1, allocation.offers[1].second.size());
+  EXPECT_EQ("slave1", allocation.offers[1].second[0].first.s);
+}
+
+
+TEST(AllocationTest, MaxSlavesPerOffer)
+{
+  AllocationRequest request = makeRequest(2, 5);
+  request.maxSlavesPerOffer = 2;
+  Allocation allocation;
+  allocate(request, &allocation);
+  ASSERT_EQ(2, allocation.offers.size());
+  EXPECT_EQ(2, allocation.offers[0].second.size());
+  EXPECT_EQ(2, allocation.offers[1].second.size());
+}
+
+
+TEST(AllocationTest, SpreadAcrossFrameworks)
+{
+  AllocationRequest request = makeRequest(3, 7);
+  request.spread = true;
+  Allocation allocation;
+  allocate(request, &allocation);
+  ASSERT_EQ(3, allocation.offers.size());
+  EXPECT_EQ(3, allocation.offers[0].second.size());
+  EXPECT_EQ(2, allocation.offers[1].second.size());
+  EXPECT_EQ(2, allocation.offers[2].second.size());
+}
+
+
+TEST(AllocationTest, SpreadUpToFairShareFirst)
+{
+  // framework0 already has half the cluster, so it only gets slaves
+  // once framework1 has reached its fair share
+  AllocationRequest request = makeRequest(2, 4);
+  request.resources[0] = Resources(4, 4 * Gigabyte);
+  request.total += request.resources[0];
+  request.spread = true;
+  Allocation allocation;
+  allocate(request, &allocation);
+  ASSERT_EQ(1, allocation.offers.size());
+  EXPECT_EQ("framework1", allocation.offers[0].first.s);
+  EXPECT_EQ(4, allocation.offers[0].second.size());
+}
@@ -0,0 +1,183 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include <tr1/functional>
+
+#include <future.hpp>
+#include <process.hpp>
+#include <request.hpp>
+
+using std::string;
+using std::vector;
+
+
+namespace {
+
+const MSGID PING = PROCESS_MSGID + 1;
+const MSGID PONG = PROCESS_MSGID + 2;
+const MSGID STOP = PROCESS_MSGID + 3;
+
+
+void remember(int *values, int *count, const int &value)
+{
+  values[(*count)++] = value;
+}
+
+
+// Answers every PING with a PONG carrying the same body, or doesn't
+// answer at all if it's 'silent', remembering who the last PING was from
+class PingedProcess : public Process
+{
+public:
+  PID pinger;
+
+  PingedProcess(bool _silent) : silent(_silent) {}
+
+protected:
+  void operator () ()
+  {
+    while (true) {
+      switch (receive()) {
+        case PING: {
+          pinger = from();
+          size_t length;
+          const char *data = body(&length);
+          if (!silent)
+            send(from(), PONG, data, length);
+          break;
+        }
+        case STOP:
+          return;
+      }
+    }
+  }
+
+private:
+  bool silent;
+};
+
+} /* namespace */
+
+
+TEST(FutureTest, OnReadyRunsOnceTheValueIsSet)
+{
+  Promise<int> promise;
+  Future<int> future = promise.future();
+
+  int values[2];
+  int count = 0;
+  future.onReady(std::tr1::bind(&remember, values, &count,
+                                std::tr1::placeholders::_1));
+  EXPECT_FALSE(future.ready());
+  EXPECT_EQ(0, count);
+
+  EXPECT_TRUE(promise.set(1));
+  EXPECT_TRUE(future.ready());
+  ASSERT_EQ(1, count);
+  EXPECT_EQ(1, values[0]);
+
+  // Only the first value counts, and later callbacks run right away
+  EXPECT_FALSE(promise.set(2));
+  future.onReady(std::tr1::bind(&remember, values, &count,
+                                std::tr1::placeholders::_1));
+  ASSERT_EQ(2, count);
+  EXPECT_EQ(1, values[1]);
+  EXPECT_EQ(1, future.get());
+}
+
+
+TEST(FutureTest, AwaitTimesOut)
+{
+  Promise<int> promise;
+  EXPECT_FALSE(promise.future().await(0.05));
+  EXPECT_FALSE(promise.future().ready());
+
+  promise.set(1);
+  EXPECT_TRUE(promise.future().await(0.05));
+}
+
+
+TEST(FutureTest, AllWaitsForEveryFuture)
+{
+  // Copies of a promise share its value, so make each one separately
+  vector<Promise<int> > promises;
+  vector<Future<int> > futures;
+  for (int i = 0; i < 3; i++) {
+    promises.push_back(Promise<int>());
+    futures.push_back(promises[i].future());
+  }
+
+  Future<vector<int> > future = all(futures);
+
+  promises[2].set(2);
+  promises[0].set(0);
+  EXPECT_FALSE(future.ready());
+
+  // The values are in the order of the futures, not the order they came in
+  promises[1].set(1);
+  ASSERT_TRUE(future.ready());
+  ASSERT_EQ(3, future.get().size());
+  EXPECT_EQ(0, future.get()[0]);
+  EXPECT_EQ(1, future.get()[1]);
+  EXPECT_EQ(2, future.get()[2]);
+
+  EXPECT_TRUE(all(vector<Future<int> >()).ready());
+}
+
+
+TEST(FutureTest, AnyTakesTheFirstValue)
+{
+  vector<Promise<int> > promises;
+  vector<Future<int> > futures;
+  for (int i = 0; i < 2; i++) {
+    promises.push_back(Promise<int>());
+    futures.push_back(promises[i].future());
+  }
+
+  Future<int> future = any(futures);
+  EXPECT_FALSE(future.ready());
+
+  promises[1].set(1);
+  ASSERT_TRUE(future.ready());
+  promises[0].set(0);
+  EXPECT_EQ(1, future.get());
+}
+
+
+TEST(RequestTest, ResponseComesFromTheReceiver)
+{
+  PingedProcess pinged(false);
+  PID pid = Process::spawn(&pinged);
+
+  const string data = "hello";
+  Response response = request(pid, PING, data.data(), data.size()).get();
+  EXPECT_EQ(PONG, response.id);
+  EXPECT_EQ(pid, response.from);
+  EXPECT_EQ(data, response.body);
+
+  Process::post(pid, STOP);
+  Process::wait(pid);
+}
+
+
+TEST(RequestTest, RequesterGoesAwayAfterTimeout)
+{
+  PingedProcess pinged(true);
+  PID pid = Process::spawn(&pinged);
+
+  Future<Response> future = request(pid, PING, 0.05);
+  ASSERT_TRUE(future.await(5));
+  EXPECT_EQ(PROCESS_TIMEOUT, future.get().id);
+
+  // The requester has exited (and been deleted), so a late answer to
+  // it goes nowhere
+  PID requester = pinged.pinger;
+  ASSERT_FALSE(!requester);
+  Process::wait(requester);
+  Process::post(requester, PONG);
+
+  Process::post(pid, STOP);
+  Process::wait(pid);
+}
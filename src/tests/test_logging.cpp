@@ -0,0 +1,116 @@
+#include <pthread.h>
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+
+#include "common/logging.hpp"
+
+using std::ostringstream;
+using std::string;
+
+using namespace mesos;
+using namespace mesos::internal;
+
+
+TEST(LoggingTest, RateLimiterAdmitsEverythingWithoutALimit)
+{
+  LogRateLimiter::rate = 0;
+  LogRateLimiter limiter = LogRateLimiter();
+  for (int i = 0; i < 1000; i++)
+    ASSERT_EQ(1, limiter.admit());
+}
+
+
+TEST(LoggingTest, RateLimiterCountsSuppressedLines)
+{
+  LogRateLimiter::rate = 3;
+  int64_t total = Logging::suppressedLines();
+  LogRateLimiter limiter = LogRateLimiter();
+
+  // Start on a fresh second so that all the lines fall in the same one
+  limiter.second = time(NULL) + 1;
+  while (time(NULL) != limiter.second);
+
+  EXPECT_EQ(1, limiter.admit());
+  EXPECT_EQ(1, limiter.admit());
+  EXPECT_EQ(1, limiter.admit());
+  EXPECT_EQ(0, limiter.admit());
+  EXPECT_EQ(0, limiter.admit());
+  EXPECT_EQ(2, Logging::suppressedLines() - total);
+
+  // The next line that gets through says how many were left out
+  limiter.second--;
+  EXPECT_EQ(3, limiter.admit());
+  EXPECT_EQ(1, limiter.admit());
+
+  LogRateLimiter::rate = 0;
+}
+
+
+namespace {
+
+// Calls admit() a thousand times, adding up the lines it lets through
+void * admitLines(void *arg)
+{
+  LogRateLimiter *limiter = (LogRateLimiter *) arg;
+  int admitted = 0;
+  for (int i = 0; i < 1000; i++)
+    admitted += limiter->admit() > 0;
+  return (void *) (intptr_t) admitted;
+}
+
+} /* namespace */
+
+
+TEST(LoggingTest, RateLimiterSharedByThreads)
+{
+  LogRateLimiter::rate = 100;
+  int64_t total = Logging::suppressedLines();
+  LogRateLimiter limiter = LogRateLimiter();
+
+  // Start on a fresh second so that all the lines fall in the same one
+  time_t start = time(NULL) + 1;
+  while (time(NULL) != start);
+
+  pthread_t threads[4];
+  for (int i = 0; i < 4; i++)
+    ASSERT_EQ(0, pthread_create(&threads[i], NULL, admitLines, &limiter));
+  int admitted = 0;
+  for (int i = 0; i < 4; i++) {
+    void *result;
+    pthread_join(threads[i], &result);
+    admitted += (intptr_t) result;
+  }
+
+  // Every line is either let through or counted as left out, and only
+  // threads starting the second together get past the limit
+  EXPECT_LE(100, admitted);
+  EXPECT_GE(100 + 3, admitted);
+  EXPECT_EQ(4000, admitted + Logging::suppressedLines() - total);
+
+  LogRateLimiter::rate = 0;
+}
+
+
+TEST(LoggingTest, RateLimitedLogIsOneStatement)
+{
+  LogRateLimiter::rate = 0;
+  bool logged = true;
+  if (!logged)
+    LOG_RATE_LIMITED(INFO) << "Not reached";
+  else
+    logged = false;
+  EXPECT_FALSE(logged);
+}
+
+
+TEST(LoggingTest, SuppressedLinesOnlyWrittenWhenSomeWere)
+{
+  ostringstream none, some;
+  none << SuppressedLines(0) << "line";
+  some << SuppressedLines(5) << "line";
+  EXPECT_EQ("line", none.str());
+  EXPECT_EQ("(5 similar lines suppressed) line", some.str());
+}
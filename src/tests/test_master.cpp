@@ -1,3 +1,9 @@
+#include <unistd.h>
+
+#include <netinet/in.h>
+
+#include <sys/socket.h>
+
 #include <gtest/gtest.h>
 
 #include <boost/lexical_cast.hpp>
@@ -9,12 +15,17 @@
 
 #include "local/local.hpp"
 
+#include "master/allocation.hpp"
+#include "master/allocator.hpp"
 #include "master/master.hpp"
 
 #include "slave/isolation_module.hpp"
 #include "slave/process_based_isolation_module.hpp"
 #include "slave/slave.hpp"
 
+#include "testing_utils.hpp"
+
+using std::make_pair;
 using std::string;
 using std::vector;
 
@@ -22,8 +33,19 @@ using boost::lexical_cast;
 
 using namespace mesos;
 using namespace mesos::internal;
+using namespace mesos::internal::test;
 
+using mesos::internal::master::Allocation;
+using mesos::internal::master::Allocator;
+using mesos::internal::master::LoggedFramework;
+using mesos::internal::master::LoggedSlave;
+using mesos::internal::master::LoggedState;
 using mesos::internal::master::Master;
+using mesos::internal::master::SlaveResources;
+using mesos::internal::master::SlotOffer;
+using mesos::internal::master::StateLog;
+using mesos::internal::master::TaskRecord;
+using mesos::internal::master::TaskTable;
 using mesos::internal::slave::Slave;
 using mesos::internal::slave::Framework;
 using mesos::internal::slave::IsolationModule;
@@ -100,6 +122,246 @@ TEST(MasterTest, NoopFrameworkWithMultipleSlaves)
 }
 
 
+TEST(MasterTest, ConcurrentStateRequests)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+  PID master = local::launch(2, 2, 1 * Gigabyte, false, false);
+
+  vector<Future<Response> > futures;
+  for (int i = 0; i < 10; i++)
+    futures.push_back(MesosProcess::request(master, pack<M2M_GET_STATE>()));
+
+  ASSERT_TRUE(all(futures).await(5));
+
+  foreach (const Future<Response>& future, futures) {
+    const Response& response = future.get();
+    ASSERT_EQ(M2M_GET_STATE_REPLY, response.id);
+    master::state::MasterState *state =
+      unpack<M2M_GET_STATE_REPLY, 0>(MesosProcess::body(response));
+    EXPECT_EQ(2, state->slaves.size());
+    delete state;
+  }
+
+  local::shutdown();
+}
+
+
+TEST(MasterTest, StateSnapshotsShareUnchangedSlaves)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  Master m;
+  PID master = Process::spawn(&m);
+
+  ProcessBasedIsolationModule isolationModule;
+  Slave s(Resources(2, 1 * Gigabyte), true, &isolationModule);
+  PID slave = Process::spawn(&s);
+
+  BasicMasterDetector detector(master, slave, true);
+
+  // Asking for the state publishes a new snapshot first
+  master::state::MasterState *state = NULL;
+  while (state == NULL || state->slaves.size() == 0) {
+    delete state;
+    Response response =
+      MesosProcess::request(master, pack<M2M_GET_STATE>()).get();
+    ASSERT_EQ(M2M_GET_STATE_REPLY, response.id);
+    state = unpack<M2M_GET_STATE_REPLY, 0>(MesosProcess::body(response));
+  }
+  delete state;
+
+  std::tr1::shared_ptr<const master::state::Snapshot> first = m.getSnapshot();
+  ASSERT_TRUE(first);
+  ASSERT_EQ(1, first->slaves.size());
+
+  Response response =
+    MesosProcess::request(master, pack<M2M_GET_STATE>()).get();
+  delete unpack<M2M_GET_STATE_REPLY, 0>(MesosProcess::body(response));
+
+  std::tr1::shared_ptr<const master::state::Snapshot> second = m.getSnapshot();
+  EXPECT_LT(first->version, second->version);
+  ASSERT_EQ(1, second->slaves.size());
+  EXPECT_EQ(first->slaves[0].get(), second->slaves[0].get());
+
+  MesosProcess::post(slave, pack<S2S_SHUTDOWN>());
+  Process::wait(slave);
+
+  MesosProcess::post(master, pack<M2M_SHUTDOWN>());
+  Process::wait(master);
+}
+
+
+TEST(MasterTest, StateSnapshotsOnlyPublishedWhenRead)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  Params conf;
+  conf.set("snapshot_interval", 0.01);
+  Master m(conf);
+  PID master = Process::spawn(&m);
+
+  BasicMasterDetector detector(master);
+
+  std::tr1::shared_ptr<const master::state::Snapshot> first;
+  while (!first)
+    first = m.getSnapshot();
+
+  // Reading a snapshot gets one more published, but no more than that
+  // until that one is read too
+  usleep(200000);
+  std::tr1::shared_ptr<const master::state::Snapshot> second = m.getSnapshot();
+  EXPECT_EQ(first->version + 1, second->version);
+
+  // Which leaves an unread one, too old to answer an HTTP request with
+  usleep(200000);
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_LE(0, sock);
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(master.port);
+  addr.sin_addr.s_addr = master.ip;
+  ASSERT_EQ(0, connect(sock, (struct sockaddr *) &addr, sizeof(addr)));
+
+  const string request =
+    "GET /master/stats.json HTTP/1.1\r\nConnection: close\r\n\r\n";
+  ASSERT_EQ(request.size(), send(sock, request.data(), request.size(), 0));
+
+  string response;
+  char buf[4096];
+  ssize_t len;
+  while ((len = recv(sock, buf, sizeof(buf), 0)) > 0)
+    response.append(buf, len);
+  close(sock);
+
+  size_t version = response.find("\"version\":");
+  ASSERT_NE(string::npos, version);
+  EXPECT_LT(second->version + 1, atoll(response.c_str() + version + 10));
+
+  MesosProcess::post(master, pack<M2M_SHUTDOWN>());
+  Process::wait(master);
+}
+
+
+TEST(MasterTest, HttpEndpointsAnswerPipelinedRequestsInOrder)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  Master m;
+  PID master = Process::spawn(&m);
+
+  ProcessBasedIsolationModule isolationModule;
+  Slave s(Resources(2, 1 * Gigabyte), true, &isolationModule);
+  PID slave = Process::spawn(&s);
+
+  BasicMasterDetector detector(master, slave, true);
+
+  // Wait for the slave to register so that both have routed their paths
+  master::state::MasterState *state = NULL;
+  while (state == NULL || state->slaves.size() == 0) {
+    delete state;
+    Response response =
+      MesosProcess::request(master, pack<M2M_GET_STATE>()).get();
+    state = unpack<M2M_GET_STATE_REPLY, 0>(MesosProcess::body(response));
+  }
+  delete state;
+
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_LE(0, sock);
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(master.port);
+  addr.sin_addr.s_addr = master.ip;
+  ASSERT_EQ(0, connect(sock, (struct sockaddr *) &addr, sizeof(addr)));
+
+  // Send every request at once; answers have to come back in order
+  const string requests =
+    "GET /master/stats.json HTTP/1.1\r\n\r\n"
+    "GET /nothing/here HTTP/1.1\r\n\r\n"
+    "GET /slave/state.json HTTP/1.1\r\nConnection: close\r\n\r\n";
+  ASSERT_EQ(requests.size(), send(sock, requests.data(), requests.size(), 0));
+
+  string responses;
+  char buf[4096];
+  ssize_t len;
+  while ((len = recv(sock, buf, sizeof(buf), 0)) > 0)
+    responses.append(buf, len);
+  close(sock);
+
+  size_t stats = responses.find("HTTP/1.1 200 OK");
+  size_t missing = responses.find("HTTP/1.1 404 Not Found");
+  size_t slaveState = responses.find("HTTP/1.1 200 OK", stats + 1);
+  ASSERT_NE(string::npos, stats);
+  ASSERT_NE(string::npos, missing);
+  ASSERT_NE(string::npos, slaveState);
+  EXPECT_LT(stats, missing);
+  EXPECT_LT(missing, slaveState);
+  EXPECT_NE(string::npos, responses.find("\"offers_expired\":"));
+  EXPECT_NE(string::npos, responses.find("\"proc_migrations\":", stats));
+  EXPECT_NE(string::npos, responses.find("\"total_disk\":", stats));
+  EXPECT_NE(string::npos, responses.find("\"offered_net\":", stats));
+  EXPECT_NE(string::npos, responses.find("\"master_pid\":"));
+  EXPECT_NE(string::npos,
+            responses.find("\"io_migrations\":", slaveState));
+  EXPECT_NE(string::npos, responses.find("\"used_net\":", slaveState));
+  EXPECT_NE(string::npos, responses.find("Connection: close", slaveState));
+
+  MesosProcess::post(slave, pack<S2S_SHUTDOWN>());
+  Process::wait(slave);
+
+  MesosProcess::post(master, pack<M2M_SHUTDOWN>());
+  Process::wait(master);
+}
+
+
+TEST(MasterTest, HttpEndpointsRefuseLargeBodies)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  Master m;
+  PID master = Process::spawn(&m);
+
+  BasicMasterDetector detector(master);
+
+  // Once the master answers messages, it has routed its paths
+  Response response =
+    MesosProcess::request(master, pack<M2M_GET_STATE>()).get();
+  delete unpack<M2M_GET_STATE_REPLY, 0>(MesosProcess::body(response));
+
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_LE(0, sock);
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(master.port);
+  addr.sin_addr.s_addr = master.ip;
+  ASSERT_EQ(0, connect(sock, (struct sockaddr *) &addr, sizeof(addr)));
+
+  // The body never comes; the answer has to come anyway
+  const string request =
+    "POST /master/stats.json HTTP/1.1\r\n"
+    "Content-Length: 1000000000\r\n\r\n";
+  ASSERT_EQ(request.size(), send(sock, request.data(), request.size(), 0));
+
+  string responses;
+  char buf[4096];
+  ssize_t len;
+  while ((len = recv(sock, buf, sizeof(buf), 0)) > 0)
+    responses.append(buf, len);
+  close(sock);
+
+  EXPECT_EQ(0, responses.find("HTTP/1.1 413 Request Entity Too Large"));
+  EXPECT_NE(string::npos, responses.find("Connection: close"));
+
+  MesosProcess::post(master, pack<M2M_SHUTDOWN>());
+  Process::wait(master);
+}
+
+
 class FixedResponseScheduler : public Scheduler
 {
 public:
@@ -190,6 +452,64 @@ TEST(MasterTest, TooMuchCpuInTask)
 }
 
 
+class TypedResourcesScheduler : public FixedResponseScheduler
+{
+public:
+  vector<SlaveOffer> offers;
+
+  TypedResourcesScheduler(vector<TaskDescription> _response)
+    : FixedResponseScheduler(_response) {}
+
+  virtual void resourceOffer(SchedulerDriver* d,
+                             OfferID id,
+                             const vector<SlaveOffer>& _offers) {
+    offers = _offers;
+    FixedResponseScheduler::resourceOffer(d, id, _offers);
+  }
+};
+
+
+TEST(MasterTest, TooMuchMemoryInTaskWithTypedResources)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+  DateUtils::setMockDate("200102030405");
+  PID master = local::launch(1, 3, 3 * Gigabyte, false, false);
+  vector<TaskDescription> tasks;
+  tasks.push_back(TaskDescription(1, "200102030405-0-0", "", 1,
+                                  4 * Gigabyte, ""));
+  TypedResourcesScheduler sched(tasks);
+  MesosSchedulerDriver driver(&sched, master);
+  driver.run();
+  EXPECT_EQ("Too many resources accepted", sched.errorMessage);
+  ASSERT_EQ(1, sched.offers.size());
+  EXPECT_EQ(3, sched.offers[0].cpus);
+  EXPECT_EQ(3 * Gigabyte, sched.offers[0].mem);
+  EXPECT_EQ("3", sched.offers[0].params["cpus"]);
+  EXPECT_EQ(lexical_cast<string>(3 * Gigabyte), sched.offers[0].params["mem"]);
+  local::shutdown();
+  DateUtils::clearMockDate();
+}
+
+
+TEST(MasterTest, TooMuchDiskInTask)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+  DateUtils::setMockDate("200102030405");
+  PID master = local::launch(1, 3, 3 * Gigabyte, false, false);
+  vector<TaskDescription> tasks;
+  map<string, string> params;
+  params["disk"] = "1";
+  tasks.push_back(TaskDescription(1, "200102030405-0-0", "", 1,
+                                  1 * Gigabyte, params, ""));
+  FixedResponseScheduler sched(tasks);
+  MesosSchedulerDriver driver(&sched, master);
+  driver.run();
+  EXPECT_EQ("Too many resources accepted", sched.errorMessage);
+  local::shutdown();
+  DateUtils::clearMockDate();
+}
+
+
 TEST(MasterTest, TooLittleCpuInTask)
 {
   ASSERT_TRUE(GTEST_IS_THREADSAFE);
@@ -316,6 +636,67 @@ TEST(MasterTest, ResourcesReofferedAfterBadResponse)
 }
 
 
+class FilterExpiryScheduler : public Scheduler
+{
+public:
+  int offersGotten;
+
+  FilterExpiryScheduler() : offersGotten(0) {}
+
+  virtual ~FilterExpiryScheduler() {}
+
+  virtual ExecutorInfo getExecutorInfo(SchedulerDriver*) {
+    return ExecutorInfo("noexecutor", "");
+  }
+
+  virtual void resourceOffer(SchedulerDriver* d,
+                             OfferID id,
+                             const vector<SlaveOffer>& offers) {
+    LOG(INFO) << "FilterExpiryScheduler got a slot offer";
+    if (++offersGotten == 1) {
+      // Refuse the offer for a second
+      map<string, string> params;
+      params["timeout"] = "1";
+      d->replyToOffer(id, vector<TaskDescription>(), params);
+    } else {
+      d->stop();
+    }
+  }
+};
+
+
+TEST(MasterTest, ResourcesReofferedAfterFilterExpires)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  // Make sure that the offer doesn't come back because of a timer tick
+  Params conf;
+  conf.set("allocation_interval", 1000);
+
+  Master m(conf);
+  PID master = Process::spawn(&m);
+
+  ProcessBasedIsolationModule isolationModule;
+  Slave s(Resources(2, 1 * Gigabyte), true, &isolationModule);
+  PID slave = Process::spawn(&s);
+
+  BasicMasterDetector detector(master, slave, true);
+
+  FilterExpiryScheduler sched;
+  MesosSchedulerDriver driver(&sched, master);
+
+  driver.run();
+
+  EXPECT_EQ(2, sched.offersGotten);
+
+  MesosProcess::post(slave, pack<S2S_SHUTDOWN>());
+  Process::wait(slave);
+
+  MesosProcess::post(master, pack<M2M_SHUTDOWN>());
+  Process::wait(master);
+}
+
+
 class SlaveLostScheduler : public Scheduler
 {
 public:
@@ -373,6 +754,74 @@ TEST(MasterTest, SlaveLost)
 
 
 
+// Registers a framework and unregisters it once it's offered a slave
+class UnregisteringScheduler : public MesosProcess
+{
+public:
+  volatile bool unregistered;
+
+  UnregisteringScheduler(const PID &_master)
+    : unregistered(false), master(_master) {}
+
+protected:
+  void operator () ()
+  {
+    send(master, pack<F2M_REGISTER_FRAMEWORK>(
+          "framework", "user", ExecutorInfo("noexecutor", "")));
+    FrameworkID id;
+    while (true) {
+      switch (receive()) {
+        case M2F_REGISTER_REPLY:
+          tie(id) = unpack<M2F_REGISTER_REPLY>(body());
+          break;
+        case M2F_SLOT_OFFER:
+          if (!unregistered) {
+            send(master, pack<F2M_UNREGISTER_FRAMEWORK>(id));
+            unregistered = true;
+          }
+          break;
+        case M2S_SHUTDOWN:
+          return;
+      }
+    }
+  }
+
+private:
+  PID master;
+};
+
+
+TEST(MasterTest, RemovedFrameworksForgottenBySlaves)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  Master m;
+  PID master = Process::spawn(&m);
+
+  ProcessBasedIsolationModule isolationModule;
+  Slave s(Resources(2, 1 * Gigabyte), true, &isolationModule);
+  PID slave = Process::spawn(&s);
+
+  BasicMasterDetector detector(master, slave, true);
+
+  UnregisteringScheduler removed(master);
+  PID removedPid = Process::spawn(&removed);
+  while (!removed.unregistered)
+    usleep(10000);
+
+  // The master gets this after the framework's unregistration
+  MesosProcess::post(master, pack<M2M_SHUTDOWN>());
+  Process::wait(master);
+  Process::wait(slave);
+
+  vector<master::Slave *> slaves = m.getActiveSlaves();
+  ASSERT_EQ(1, slaves.size());
+  EXPECT_TRUE(slaves[0]->interested.empty());
+
+  MesosProcess::post(removedPid, pack<M2S_SHUTDOWN>());
+  Process::wait(removedPid);
+}
+
 class FailoverScheduler : public Scheduler
 {
 public:
@@ -527,63 +976,748 @@ TEST(MasterTest, OfferRescinded)
 }
 
 
-class SlavePartitionedScheduler : public Scheduler
+class OfferTimeoutScheduler : public Scheduler
 {
 public:
-  bool slaveLostCalled;
-  
-  SlavePartitionedScheduler()
-    : slaveLostCalled(false) {}
+  bool offerRescindedCalled;
 
-  virtual ~SlavePartitionedScheduler() {}
+  OfferTimeoutScheduler() : offerRescindedCalled(false) {}
+
+  virtual ~OfferTimeoutScheduler() {}
 
   virtual ExecutorInfo getExecutorInfo(SchedulerDriver*) {
     return ExecutorInfo("noexecutor", "");
   }
 
-  virtual void slaveLost(SchedulerDriver* d, SlaveID slaveId) {
-    slaveLostCalled = true;
-    d->stop();
+  virtual void resourceOffer(SchedulerDriver* d,
+                             OfferID id,
+                             const vector<SlaveOffer>& offers) {
+    LOG(INFO) << "OfferTimeoutScheduler got a slot offer and is sitting on it";
   }
-};
-
 
-class HeartbeatMessageFilter : public MessageFilter
-{
-public:
-  virtual bool filter(struct msg *msg) {
-    return msg->id == SH2M_HEARTBEAT;
+  virtual void offerRescinded(SchedulerDriver* d, OfferID)
+  {
+    offerRescindedCalled = true;
+    d->stop();
   }
 };
 
 
-TEST(MasterTest, SlavePartitioned)
+TEST(MasterTest, OfferTimesOut)
 {
   ASSERT_TRUE(GTEST_IS_THREADSAFE);
 
-  HeartbeatMessageFilter filter;
-  Process::filter(&filter);
+  Params conf;
+  conf.set("offer_timeout", 0.5);
 
-  ProcessClock::pause();
+  Master m(conf);
+  PID master = Process::spawn(&m);
 
-  PID master = local::launch(1, 2, 1 * Gigabyte, false, false);
+  ProcessBasedIsolationModule isolationModule;
+  Slave s(Resources(2, 1 * Gigabyte), true, &isolationModule);
+  PID slave = Process::spawn(&s);
 
-  SlavePartitionedScheduler sched;
-  MesosSchedulerDriver driver(&sched, master);
+  BasicMasterDetector detector(master, slave, true);
 
-  driver.start();
+  OfferTimeoutScheduler sched;
+  MesosSchedulerDriver driver(&sched, master);
 
-  ProcessClock::advance(master::HEARTBEAT_TIMEOUT);
+  driver.run();
 
-  driver.join();
+  EXPECT_TRUE(sched.offerRescindedCalled);
 
-  EXPECT_TRUE(sched.slaveLostCalled);
+  MesosProcess::post(slave, pack<S2S_SHUTDOWN>());
+  Process::wait(slave);
 
-  local::shutdown();
+  MesosProcess::post(master, pack<M2M_SHUTDOWN>());
+  Process::wait(master);
+}
 
-  ProcessClock::resume();
 
-  Process::filter(NULL);
+class HintsScheduler : public Scheduler
+{
+public:
+  volatile bool registeredCalled;
+  int offersGotten;
+
+  HintsScheduler() : registeredCalled(false), offersGotten(0) {}
+
+  virtual ~HintsScheduler() {}
+
+  virtual ExecutorInfo getExecutorInfo(SchedulerDriver*) {
+    return ExecutorInfo("noexecutor", "");
+  }
+
+  virtual void registered(SchedulerDriver*, FrameworkID fid) {
+    registeredCalled = true;
+  }
+
+  virtual void resourceOffer(SchedulerDriver* d,
+                             OfferID id,
+                             const vector<SlaveOffer>& offers) {
+    LOG(INFO) << "HintsScheduler got a slot offer";
+    offersGotten++;
+    // Only the slave with 2 CPUs should ever be offered
+    EXPECT_EQ(1, offers.size());
+    foreach (const SlaveOffer& offer, offers)
+      EXPECT_EQ("2", offer.params.find("cpus")->second);
+    d->replyToOffer(id, vector<TaskDescription>(), map<string, string>());
+    d->stop();
+  }
+};
+
+
+TEST(MasterTest, HintsFilterOffers)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  Master m;
+  PID master = Process::spawn(&m);
+
+  BasicMasterDetector masterDetector(master);
+
+  HintsScheduler sched;
+  MesosSchedulerDriver driver(&sched, master);
+
+  map<string, string> hints;
+  hints["min_cpus"] = "2";
+
+  driver.start();
+  EXPECT_EQ(0, driver.sendHints(hints));
+
+  // Only add the slaves once the hints have been sent (they go out
+  // with the registration reply)
+  while (!sched.registeredCalled)
+    usleep(10000);
+
+  ProcessBasedIsolationModule isolationModule1;
+  Slave s1(Resources(1, 1 * Gigabyte), true, &isolationModule1);
+  PID slave1 = Process::spawn(&s1);
+
+  ProcessBasedIsolationModule isolationModule2;
+  Slave s2(Resources(2, 1 * Gigabyte), true, &isolationModule2);
+  PID slave2 = Process::spawn(&s2);
+
+  vector<PID> slaves;
+  slaves.push_back(slave1);
+  slaves.push_back(slave2);
+  BasicMasterDetector slaveDetector(master, slaves);
+
+  driver.join();
+
+  EXPECT_EQ(1, sched.offersGotten);
+
+  MesosProcess::post(slave1, pack<S2S_SHUTDOWN>());
+  Process::wait(slave1);
+
+  MesosProcess::post(slave2, pack<S2S_SHUTDOWN>());
+  Process::wait(slave2);
+
+  MesosProcess::post(master, pack<M2M_SHUTDOWN>());
+  Process::wait(master);
+}
+
+
+// Pretends to be a slave that was registered with a previous master
+class ReregisteringSlave : public MesosProcess
+{
+public:
+  volatile bool reregistered;
+
+  ReregisteringSlave(const PID& _master, const SlaveID& _id)
+    : reregistered(false), master(_master), id(_id) {}
+
+protected:
+  void operator () ()
+  {
+    send(master, pack<S2M_REREGISTER_SLAVE>(id, "host-" + id.s, "",
+                                            Resources(2, 1 * Gigabyte),
+                                            vector<Task>(),
+                                            vector<FrameworkID>()));
+    while (true) {
+      switch (receive()) {
+        case M2S_REREGISTER_REPLY:
+          reregistered = true;
+          break;
+        case M2S_SHUTDOWN:
+          return;
+      }
+    }
+  }
+
+private:
+  PID master;
+  SlaveID id;
+};
+
+
+TEST(MasterTest, NoOffersUntilEnoughSlavesReregister)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  Params conf;
+  conf.set("recovery_timeout", 1000);
+  conf.set("recovery_slaves", 2);
+  conf.set("reregistration_rate", 100);
+  Master m(conf);
+  PID master = Process::spawn(&m);
+
+  BasicMasterDetector masterDetector(master);
+
+  NoopScheduler sched(2);
+  MesosSchedulerDriver driver(&sched, master);
+  driver.start();
+
+  while (!sched.registeredCalled)
+    usleep(10000);
+
+  ReregisteringSlave s1(master, "previous-0");
+  PID slave1 = Process::spawn(&s1);
+  while (!s1.reregistered)
+    usleep(10000);
+
+  // One slave isn't enough to end recovery, so nothing was offered
+  Response response =
+    MesosProcess::request(master, pack<M2M_GET_STATE>()).get();
+  master::state::MasterState *state =
+    unpack<M2M_GET_STATE_REPLY, 0>(MesosProcess::body(response));
+  ASSERT_EQ(1, state->slaves.size());
+  ASSERT_EQ(1, state->frameworks.size());
+  EXPECT_EQ(0, state->frameworks[0]->offers.size());
+  delete state;
+  EXPECT_EQ(0, sched.offersGotten);
+
+  // The second one ends it, and both slaves get offered together
+  ReregisteringSlave s2(master, "previous-1");
+  PID slave2 = Process::spawn(&s2);
+
+  driver.join();
+
+  EXPECT_EQ(1, sched.offersGotten);
+
+  MesosProcess::post(master, pack<M2M_SHUTDOWN>());
+  Process::wait(master);
+
+  Process::wait(slave1);
+  Process::wait(slave2);
+}
+
+
+TEST_WITH_WORKDIR(MasterTest, StateLogSurvivesRestartAndTornRecords)
+{
+  LoggedFramework framework;
+  framework.id = "previous-0000";
+  framework.name = "framework";
+  framework.user = "user";
+  framework.executorInfo.uri = "noexecutor";
+
+  LoggedSlave slave;
+  slave.id = "previous-0";
+  slave.hostname = "host";
+  slave.resources = Resources(2, 1 * Gigabyte);
+
+  {
+    // Compact every 4 records so that the state is split across the
+    // snapshot and the log
+    StateLog log("state", 4);
+    log.addFramework(framework);
+    log.addSlave(slave);
+    for (int i = 0; i < 3; i++)
+      log.addTask(Task(i, framework.id, Resources(1, 64 * Megabyte),
+                       TASK_STARTING, "task", "", slave.id));
+    log.updateTask(framework.id, 1, TASK_RUNNING);
+    log.removeTask(framework.id, 2);
+  }
+
+  // Pretend that we crashed halfway through appending a record
+  FILE *file = fopen("state/log", "a");
+  ASSERT_TRUE(file != NULL);
+  fwrite("\0\0\1\0junk", 1, 8, file);
+  fclose(file);
+
+  StateLog log("state", 4);
+  EXPECT_EQ(0, access("state/format", F_OK));
+  const LoggedState& state = log.getState();
+  ASSERT_EQ(1, state.frameworks.size());
+  EXPECT_EQ("user", state.frameworks.begin()->second.user);
+  EXPECT_EQ("noexecutor", state.frameworks.begin()->second.executorInfo.uri);
+  ASSERT_EQ(1, state.slaves.size());
+  EXPECT_EQ("host", state.slaves.begin()->second.hostname);
+  ASSERT_EQ(2, state.tasks.size());
+  EXPECT_EQ(TASK_STARTING,
+            state.tasks.find(make_pair(framework.id, 0))->second.state);
+  EXPECT_EQ(TASK_RUNNING,
+            state.tasks.find(make_pair(framework.id, 1))->second.state);
+
+  // Removing a slave takes its tasks with it, and only those
+  LoggedSlave other = slave;
+  other.id = "previous-1";
+  log.addSlave(other);
+  log.addTask(Task(3, framework.id, Resources(1, 64 * Megabyte),
+                   TASK_RUNNING, "task", "", other.id));
+  log.removeSlave(slave.id);
+  EXPECT_EQ(1, state.slaves.size());
+  ASSERT_EQ(1, state.tasks.size());
+  EXPECT_EQ(other.id, state.tasks.begin()->second.slaveId);
+  EXPECT_EQ(1, state.frameworks.size());
+  EXPECT_EQ(0, state.slaveTasks.count(slave.id));
+
+  // As does removing the task's framework
+  log.removeFramework(framework.id);
+  EXPECT_EQ(0, state.tasks.size());
+  EXPECT_EQ(0, state.slaveTasks.size());
+}
+
+
+TEST_WITH_WORKDIR(MasterTest, StateLogFinishesInterruptedCompaction)
+{
+  LoggedSlave slave;
+  slave.id = "previous-0";
+  slave.hostname = "host";
+  slave.resources = Resources(2, 1 * Gigabyte);
+
+  {
+    StateLog log("state", 0);
+    log.addSlave(slave);
+    log.addTask(Task(1, "previous-0000", Resources(1, 64 * Megabyte),
+                     TASK_RUNNING, "task", "", slave.id));
+  }
+
+  // Pretend that we stopped after moving the log aside for a snapshot,
+  // and then logged another change
+  ASSERT_EQ(0, rename("state/log", "state/log.old"));
+  {
+    StateLog log("state", 0);
+    EXPECT_EQ(1, log.getState().tasks.size());
+    log.removeTask("previous-0000", 1);
+  }
+
+  StateLog log("state", 0);
+  EXPECT_EQ(0, access("state/snapshot", F_OK));
+  EXPECT_NE(0, access("state/log.old", F_OK));
+  EXPECT_EQ(1, log.getState().slaves.size());
+  EXPECT_EQ(0, log.getState().tasks.size());
+}
+
+
+TEST(MasterTest, TaskTableReusesRecords)
+{
+  TaskTable table(2);
+
+  TaskRecord *a = table.add(1, "framework", Resources(1, 32), TASK_STARTING,
+                            "a task with a name too long to fit in the string",
+                            "slave");
+  TaskRecord *b = table.add(Task(2, "framework", Resources(2, 64),
+                                 TASK_RUNNING, "b", "message", "slave"));
+  EXPECT_EQ(2, table.size());
+  EXPECT_EQ(2, table.capacity());
+  EXPECT_EQ(1, a->id);
+  EXPECT_EQ("slave", table.slaveId(a).s);
+  EXPECT_EQ(TASK_RUNNING, b->state);
+
+  // Messages aren't kept, and a whole task is only built on demand
+  Task whole = table.task(b);
+  EXPECT_EQ(2, whole.id);
+  EXPECT_EQ("framework", whole.frameworkId.s);
+  EXPECT_EQ("slave", whole.slaveId.s);
+  EXPECT_EQ("b", whole.name);
+  EXPECT_EQ("", whole.message);
+
+  // The framework and slave IDs are kept once for both tasks
+  EXPECT_EQ(4, table.strings());
+
+  // A third task needs another chunk, which doesn't move the others
+  TaskRecord *c = table.add(3, "framework", Resources(1, 32), TASK_STARTING,
+                            "c", "slave");
+  EXPECT_EQ(4, table.capacity());
+  EXPECT_EQ(1, a->id);
+  EXPECT_EQ(2, b->id);
+  EXPECT_EQ(3, c->id);
+  EXPECT_EQ(5, table.strings());
+
+  // A removed record is handed out again, and its name is let go of
+  table.remove(a);
+  EXPECT_EQ(2, table.size());
+  EXPECT_EQ(4, table.strings());
+  TaskRecord *d = table.add(4, "other", Resources(1, 32), TASK_STARTING, "d",
+                            "slave");
+  EXPECT_EQ(a, d);
+  EXPECT_EQ("d", table.name(d));
+  EXPECT_EQ("other", table.frameworkId(d).s);
+  EXPECT_EQ("framework", table.frameworkId(b).s);
+  EXPECT_EQ(4, table.capacity());
+  EXPECT_EQ(6, table.strings());
+
+  // IDs go once the last task using them does
+  table.remove(b);
+  table.remove(c);
+  EXPECT_EQ(3, table.strings());
+  EXPECT_EQ("slave", table.slaveId(d).s);
+}
+
+
+// Stands in for a scheduler or slave of a previous master, counting
+// the tasks it's told were lost
+class IdleProcess : public MesosProcess
+{
+public:
+  volatile int lostTasks;
+
+  IdleProcess() : lostTasks(0) {}
+
+protected:
+  void operator () ()
+  {
+    while (true) {
+      switch (receive()) {
+        case M2F_STATUS_UPDATE: {
+          TaskID tid;
+          TaskState state;
+          string data;
+          tie(tid, state, data) = unpack<M2F_STATUS_UPDATE>(body());
+          if (state == TASK_LOST)
+            lostTasks++;
+          break;
+        }
+        case M2S_SHUTDOWN:
+          return;
+      }
+    }
+  }
+};
+
+
+TEST_WITH_WORKDIR(MasterTest, MasterRecoversStateFromLog)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  IdleProcess scheduler, oldSlave;
+  PID schedulerPid = Process::spawn(&scheduler);
+  PID oldSlavePid = Process::spawn(&oldSlave);
+
+  // What a previous master would have recorded
+  {
+    StateLog log("state", 0);
+
+    LoggedFramework framework;
+    framework.id = "previous-0000";
+    framework.name = "framework";
+    framework.user = "user";
+    framework.executorInfo.uri = "noexecutor";
+    framework.pid = schedulerPid;
+    log.addFramework(framework);
+
+    LoggedSlave slave;
+    slave.id = "previous-0";
+    slave.hostname = "host-previous-0";
+    slave.resources = Resources(2, 1 * Gigabyte);
+    slave.pid = oldSlavePid;
+    log.addSlave(slave);
+
+    log.addTask(Task(1, framework.id, Resources(1, 64 * Megabyte),
+                     TASK_RUNNING, "task", "", slave.id));
+  }
+
+  Params conf;
+  conf.set("state_dir", "state");
+  Master m(conf);
+  PID master = Process::spawn(&m);
+
+  BasicMasterDetector masterDetector(master);
+
+  Response response =
+    MesosProcess::request(master, pack<M2M_GET_STATE>()).get();
+  master::state::MasterState *state =
+    unpack<M2M_GET_STATE_REPLY, 0>(MesosProcess::body(response));
+  ASSERT_EQ(1, state->slaves.size());
+  EXPECT_EQ("host-previous-0", state->slaves[0]->host);
+  ASSERT_EQ(1, state->frameworks.size());
+  EXPECT_EQ(FrameworkID("previous-0000"), state->frameworks[0]->id);
+  ASSERT_EQ(1, state->frameworks[0]->tasks.size());
+  EXPECT_EQ(1, state->frameworks[0]->tasks[0]->id);
+  delete state;
+
+  // The slave comes back (from somewhere else) without the task, so
+  // it's lost rather than the slave being added twice
+  ReregisteringSlave newSlave(master, "previous-0");
+  PID newSlavePid = Process::spawn(&newSlave);
+  while (!newSlave.reregistered)
+    usleep(10000);
+
+  response = MesosProcess::request(master, pack<M2M_GET_STATE>()).get();
+  state = unpack<M2M_GET_STATE_REPLY, 0>(MesosProcess::body(response));
+  ASSERT_EQ(1, state->slaves.size());
+  ASSERT_EQ(1, state->frameworks.size());
+  EXPECT_EQ(0, state->frameworks[0]->tasks.size());
+  delete state;
+
+  while (scheduler.lostTasks == 0)
+    usleep(10000);
+  EXPECT_EQ(1, scheduler.lostTasks);
+
+  MesosProcess::post(master, pack<M2M_SHUTDOWN>());
+  Process::wait(master);
+
+  MesosProcess::post(schedulerPid, pack<M2S_SHUTDOWN>());
+  MesosProcess::post(oldSlavePid, pack<M2S_SHUTDOWN>());
+  Process::wait(schedulerPid);
+  Process::wait(oldSlavePid);
+  Process::wait(newSlavePid);
+}
+
+
+// Registers as a new slave, remembering the ID it's given
+class RegisteringSlave : public MesosProcess
+{
+public:
+  SlaveID id;
+  volatile bool registered;
+
+  RegisteringSlave(const PID& _master) : registered(false), master(_master) {}
+
+protected:
+  void operator () ()
+  {
+    send(master, pack<S2M_REGISTER_SLAVE>("host", "",
+                                          Resources(2, 1 * Gigabyte)));
+    while (true) {
+      switch (receive()) {
+        case M2S_REGISTER_REPLY: {
+          double interval;
+          tie(id, interval) = unpack<M2S_REGISTER_REPLY>(body());
+          registered = true;
+          break;
+        }
+        case M2S_SHUTDOWN:
+          return;
+      }
+    }
+  }
+
+private:
+  PID master;
+};
+
+
+TEST_WITH_WORKDIR(MasterTest, RestartedMasterDoesNotReuseIds)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+  DateUtils::setMockDate("200102030405");
+
+  IdleProcess oldSlave;
+  PID oldSlavePid = Process::spawn(&oldSlave);
+
+  // A previous master in the same minute registered one slave
+  {
+    StateLog log("state", 0);
+    LoggedSlave slave;
+    slave.id = "200102030405-0-0";
+    slave.hostname = "host";
+    slave.resources = Resources(2, 1 * Gigabyte);
+    slave.pid = oldSlavePid;
+    log.addSlave(slave);
+    log.setNextIds(0, 1);
+  }
+
+  Params conf;
+  conf.set("state_dir", "state");
+  Master m(conf);
+  PID master = Process::spawn(&m);
+
+  BasicMasterDetector masterDetector(master);
+
+  RegisteringSlave newSlave(master);
+  PID newSlavePid = Process::spawn(&newSlave);
+  while (!newSlave.registered)
+    usleep(10000);
+  EXPECT_EQ("200102030405-0-1", newSlave.id.s);
+
+  MesosProcess::post(master, pack<M2M_SHUTDOWN>());
+  Process::wait(master);
+
+  // The new counters are in the log for the next master
+  StateLog log("state", 0);
+  EXPECT_EQ(2, log.getState().nextSlaveId);
+
+  MesosProcess::post(oldSlavePid, pack<M2S_SHUTDOWN>());
+  MesosProcess::post(newSlavePid, pack<M2S_SHUTDOWN>());
+  Process::wait(oldSlavePid);
+  Process::wait(newSlavePid);
+  DateUtils::clearMockDate();
+}
+
+
+// Stands in for the scheduler of a framework that a previous master
+// knew, re-registering with the new master once 'master' is set and
+// adding up the resources it's offered
+class RecoveredScheduler : public MesosProcess
+{
+public:
+  volatile int offers;
+  volatile int32_t offeredCpus;
+  volatile int64_t offeredMem;
+  PID master;
+  volatile bool reregister;
+
+  RecoveredScheduler(const FrameworkID& _id)
+    : offers(0), offeredCpus(0), offeredMem(0), reregister(false), id(_id) {}
+
+protected:
+  void operator () ()
+  {
+    bool reregistered = false;
+    while (true) {
+      switch (receive(0.01)) {
+        case PROCESS_TIMEOUT:
+          if (reregister && !reregistered) {
+            send(master, pack<F2M_REREGISTER_FRAMEWORK>(
+                  id, "framework", "user", ExecutorInfo("noexecutor", ""),
+                  1));
+            reregistered = true;
+          }
+          break;
+        case M2F_SLOT_OFFER: {
+          OfferID oid;
+          vector<SlaveOffer> slaveOffers;
+          map<SlaveID, PID> pids;
+          tie(oid, slaveOffers, pids) = unpack<M2F_SLOT_OFFER>(body());
+          foreach (const SlaveOffer& offer, slaveOffers) {
+            offeredCpus += offer.cpus;
+            offeredMem += offer.mem;
+          }
+          offers++;
+          break;
+        }
+        case M2S_SHUTDOWN:
+          return;
+      }
+    }
+  }
+
+private:
+  FrameworkID id;
+};
+
+
+TEST_WITH_WORKDIR(MasterTest, NoOffersOfRecoveredTasksResources)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  RecoveredScheduler scheduler("previous-0000");
+  IdleProcess oldSlave;
+  PID schedulerPid = Process::spawn(&scheduler);
+  PID oldSlavePid = Process::spawn(&oldSlave);
+
+  {
+    StateLog log("state", 0);
+
+    LoggedFramework framework;
+    framework.id = "previous-0000";
+    framework.name = "framework";
+    framework.user = "user";
+    framework.executorInfo.uri = "noexecutor";
+    framework.pid = schedulerPid;
+    log.addFramework(framework);
+
+    LoggedSlave slave;
+    slave.id = "previous-0";
+    slave.hostname = "host-previous-0";
+    slave.resources = Resources(2, 1 * Gigabyte);
+    slave.pid = oldSlavePid;
+    log.addSlave(slave);
+
+    log.addTask(Task(1, framework.id, Resources(1, 64 * Megabyte),
+                     TASK_RUNNING, "task", "", slave.id));
+  }
+
+  Params conf;
+  conf.set("state_dir", "state");
+  conf.set("allocation_interval", 0.05);
+  Master m(conf);
+  PID master = Process::spawn(&m);
+
+  BasicMasterDetector masterDetector(master);
+
+  // Nothing is offered to the scheduler before it re-registers
+  usleep(200000);
+  EXPECT_EQ(0, scheduler.offers);
+
+  // Once it has, it's only offered what the recovered task isn't using
+  scheduler.master = master;
+  scheduler.reregister = true;
+  while (scheduler.offers == 0)
+    usleep(10000);
+  EXPECT_EQ(1, scheduler.offers);
+  EXPECT_EQ(1, scheduler.offeredCpus);
+  EXPECT_EQ(1 * Gigabyte - 64 * Megabyte, scheduler.offeredMem);
+
+  MesosProcess::post(master, pack<M2M_SHUTDOWN>());
+  Process::wait(master);
+
+  MesosProcess::post(schedulerPid, pack<M2S_SHUTDOWN>());
+  MesosProcess::post(oldSlavePid, pack<M2S_SHUTDOWN>());
+  Process::wait(schedulerPid);
+  Process::wait(oldSlavePid);
+}
+
+
+class SlavePartitionedScheduler : public Scheduler
+{
+public:
+  bool slaveLostCalled;
+  
+  SlavePartitionedScheduler()
+    : slaveLostCalled(false) {}
+
+  virtual ~SlavePartitionedScheduler() {}
+
+  virtual ExecutorInfo getExecutorInfo(SchedulerDriver*) {
+    return ExecutorInfo("noexecutor", "");
+  }
+
+  virtual void slaveLost(SchedulerDriver* d, SlaveID slaveId) {
+    slaveLostCalled = true;
+    d->stop();
+  }
+};
+
+
+class HeartbeatMessageFilter : public MessageFilter
+{
+public:
+  virtual bool filter(struct msg *msg) {
+    return msg->id == SH2M_HEARTBEAT;
+  }
+};
+
+
+TEST(MasterTest, SlavePartitioned)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  HeartbeatMessageFilter filter;
+  Process::filter(&filter);
+
+  ProcessClock::pause();
+
+  PID master = local::launch(1, 2, 1 * Gigabyte, false, false);
+
+  SlavePartitionedScheduler sched;
+  MesosSchedulerDriver driver(&sched, master);
+
+  driver.start();
+
+  ProcessClock::advance(master::HEARTBEAT_TIMEOUT);
+
+  driver.join();
+
+  EXPECT_TRUE(sched.slaveLostCalled);
+
+  local::shutdown();
+
+  ProcessClock::resume();
+
+  Process::filter(NULL);
 }
 
 
@@ -708,6 +1842,786 @@ TEST(MasterTest, TaskRunning)
 }
 
 
+// Registers a slave and counts the tasks it's asked to run and kill
+class TaskCountingSlave : public MesosProcess
+{
+public:
+  volatile int tasksRun;
+  volatile int tasksKilled;
+
+  TaskCountingSlave(const PID& _master)
+    : tasksRun(0), tasksKilled(0), master(_master) {}
+
+protected:
+  void operator () ()
+  {
+    send(master, pack<S2M_REGISTER_SLAVE>("host", "",
+                                          Resources(2, 1 * Gigabyte)));
+    while (true) {
+      switch (receive()) {
+        case M2S_RUN_TASKS: {
+          FrameworkID fid;
+          vector<TaskDescription> tasks;
+          tie(fid, tasks) = unpack<M2S_RUN_TASKS>(body());
+          tasksRun += tasks.size();
+          break;
+        }
+        case M2S_KILL_TASK:
+          tasksKilled++;
+          break;
+        case M2S_SHUTDOWN:
+          return;
+      }
+    }
+  }
+
+private:
+  PID master;
+};
+
+
+// Launches a task on the first slave it's offered and asks for it to be
+// killed right after, counting the tasks it's told were lost
+class LaunchAndKillScheduler : public MesosProcess
+{
+public:
+  volatile int lostTasks;
+
+  LaunchAndKillScheduler(const PID& _master)
+    : lostTasks(0), master(_master) {}
+
+protected:
+  void operator () ()
+  {
+    send(master, pack<F2M_REGISTER_FRAMEWORK>(
+          "framework", "user", ExecutorInfo("noexecutor", "")));
+    FrameworkID fid;
+    bool launched = false;
+    while (true) {
+      switch (receive()) {
+        case M2F_REGISTER_REPLY:
+          tie(fid) = unpack<M2F_REGISTER_REPLY>(body());
+          break;
+        case M2F_SLOT_OFFER: {
+          OfferID oid;
+          vector<SlaveOffer> offers;
+          map<SlaveID, PID> pids;
+          tie(oid, offers, pids) = unpack<M2F_SLOT_OFFER>(body());
+          vector<TaskDescription> tasks;
+          if (!launched)
+            tasks.push_back(TaskDescription(1, offers[0].slaveId, "task",
+                                            1, 64 * Megabyte, ""));
+          send(master, pack<F2M_SLOT_OFFER_REPLY>(fid, oid, tasks, Params()));
+          if (!launched)
+            send(master, pack<F2M_KILL_TASK>(fid, 1));
+          launched = true;
+          break;
+        }
+        case M2F_STATUS_UPDATE: {
+          TaskID tid;
+          TaskState state;
+          string message;
+          tie(tid, state, message) = unpack<M2F_STATUS_UPDATE>(body());
+          if (state == TASK_LOST)
+            lostTasks++;
+          break;
+        }
+        case M2S_SHUTDOWN:
+          return;
+      }
+    }
+  }
+
+private:
+  PID master;
+};
+
+
+TEST(MasterTest, KillTaskWaitsForDecodedOfferReply)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  Params conf;
+  conf.set("decode_threads", 2);
+
+  Master m(conf);
+  PID master = Process::spawn(&m);
+
+  BasicMasterDetector detector(master);
+
+  TaskCountingSlave slave(master);
+  PID slavePid = Process::spawn(&slave);
+
+  LaunchAndKillScheduler sched(master);
+  PID schedPid = Process::spawn(&sched);
+
+  // The kill has to get to the slave after the task, not be answered
+  // with TASK_LOST because the task isn't decoded yet
+  while (slave.tasksKilled == 0 && sched.lostTasks == 0)
+    usleep(10000);
+  EXPECT_EQ(1, slave.tasksRun);
+  EXPECT_EQ(1, slave.tasksKilled);
+  EXPECT_EQ(0, sched.lostTasks);
+
+  MesosProcess::post(master, pack<M2M_SHUTDOWN>());
+  Process::wait(master);
+
+  MesosProcess::post(schedPid, pack<M2S_SHUTDOWN>());
+  Process::wait(schedPid);
+  Process::wait(slavePid);
+}
+
+// A master that is never spawned: tests call into its allocator
+// directly, and the offers it makes are only written down (the way the
+// allocator benchmark's master does it)
+class OfferRecordingMaster : public Master
+{
+public:
+  // The slaves in each offer made, in order, and who it was made to
+  vector<vector<SlaveID> > offers;
+  vector<FrameworkID> offeredTo;
+
+  OfferRecordingMaster(const Params& conf) : Master(conf)
+  {
+    allocator = createAllocator();
+  }
+
+  virtual OfferID makeOffer(master::Framework *framework,
+                            const vector<SlaveResources>& resources)
+  {
+    OfferID oid = lexical_cast<string>(nextSlotOfferId++);
+    SlotOffer *offer = new SlotOffer(oid, framework->id, resources, 0);
+    slotOffers[offer->id] = offer;
+    framework->addOffer(offer);
+    vector<SlaveID> offered;
+    foreach (const SlaveResources& r, resources) {
+      r.slave->slotOffers.insert(offer);
+      r.slave->resourcesOffered += r.resources;
+      offered.push_back(r.slave->id);
+    }
+    offers.push_back(offered);
+    offeredTo.push_back(framework->id);
+    return oid;
+  }
+
+  void addFramework(const FrameworkID& id)
+  {
+    master::Framework *framework = new master::Framework(PID(), id, 0);
+    framework->allocator = allocator;
+    frameworks[id] = framework;
+    allocator->frameworkAdded(framework);
+  }
+
+  void addSlave(const SlaveID& id,
+                const Resources& resources = Resources(2, 1 * Gigabyte))
+  {
+    master::Slave *slave = new master::Slave(PID(), id, 0);
+    slave->hostname = "host-" + id.s;
+    slave->resources = resources;
+    slaves[id] = slave;
+    allocator->slaveAdded(slave);
+  }
+
+  void removeSlave(const SlaveID& id)
+  {
+    master::Slave *slave = lookupSlave(id);
+    slaves.erase(id);
+    allocator->slaveRemoved(slave);
+    delete slave;
+  }
+
+  // Has a framework turn down all its offers
+  void declineOffers(const FrameworkID& id)
+  {
+    master::Framework *framework = lookupFramework(id);
+    vector<SlotOffer *> offers(framework->slotOffers.begin(),
+                               framework->slotOffers.end());
+    foreach (SlotOffer *offer, offers) {
+      vector<SlaveResources> resourcesLeft = offer->resources;
+      removeSlotOffer(offer, master::ORR_FRAMEWORK_REPLIED, resourcesLeft);
+    }
+  }
+
+  void setFrameworkResources(const FrameworkID& id,
+                             const Resources& resources)
+  {
+    master::Framework *framework = lookupFramework(id);
+    framework->resources = resources;
+    allocator->frameworkResourcesChanged(framework);
+  }
+
+  Allocator * getAllocator() { return allocator; }
+};
+
+
+TEST(MasterTest, BatchedAllocationsCoverEverySlaveInOnePass)
+{
+  Params conf;
+  conf.set("batch_allocations", true);
+  OfferRecordingMaster m(conf);
+
+  m.addFramework("framework");
+  m.addSlave("a");
+  m.addSlave("b");
+  m.addSlave("c");
+
+  // Nothing is offered until the timer ticks, and then in one offer
+  EXPECT_EQ(0, m.offers.size());
+  m.getAllocator()->timerTick();
+  ASSERT_EQ(1, m.offers.size());
+  EXPECT_EQ(3, m.offers[0].size());
+
+  // Ticks with no slaves changed since don't offer anything
+  m.getAllocator()->timerTick();
+  EXPECT_EQ(1, m.offers.size());
+}
+
+
+TEST(MasterTest, BatchedAllocationsRevisitSlavesSkippedAtTheOfferLimit)
+{
+  Params conf;
+  conf.set("batch_allocations", true);
+  conf.set("max_offers_per_framework", 1);
+  OfferRecordingMaster m(conf);
+
+  m.addFramework("framework");
+  m.addSlave("a");
+  m.getAllocator()->timerTick();
+  ASSERT_EQ(1, m.offers.size());
+
+  // Slave b comes while the framework has as many offers as it may have
+  m.addSlave("b");
+  m.getAllocator()->timerTick();
+  EXPECT_EQ(1, m.offers.size());
+
+  // Turning down the offer of a leaves room for one with b in it too
+  m.declineOffers("framework");
+  m.getAllocator()->timerTick();
+  ASSERT_EQ(2, m.offers.size());
+  EXPECT_EQ(2, m.offers[1].size());
+}
+
+
+TEST(MasterTest, BatchedAllocationsRunOnceBatchSizeIsReached)
+{
+  Params conf;
+  conf.set("batch_allocations", true);
+  conf.set("allocation_batch_size", 2);
+  OfferRecordingMaster m(conf);
+
+  // The framework and the first slave make a batch, as do the next two
+  // slaves, without waiting for the timer to tick
+  m.addFramework("framework");
+  EXPECT_EQ(0, m.offers.size());
+  m.addSlave("a");
+  ASSERT_EQ(1, m.offers.size());
+  EXPECT_EQ(1, m.offers[0].size());
+  m.addSlave("b");
+  EXPECT_EQ(1, m.offers.size());
+  m.addSlave("c");
+  ASSERT_EQ(2, m.offers.size());
+  EXPECT_EQ(2, m.offers[1].size());
+}
+
+
+TEST(MasterTest, UnbatchedAllocationsOfferEachSlaveAsItComes)
+{
+  OfferRecordingMaster m((Params()));
+
+  m.addFramework("framework");
+  m.addSlave("a");
+  m.addSlave("b");
+  m.addSlave("c");
+
+  ASSERT_EQ(3, m.offers.size());
+  EXPECT_EQ(1, m.offers[0].size());
+  EXPECT_EQ(1, m.offers[1].size());
+  EXPECT_EQ(1, m.offers[2].size());
+}
+
+
+TEST(MasterTest, AllocationsFollowDominantSharesAsTheyChange)
+{
+  OfferRecordingMaster m((Params()));
+
+  // A uses CPUs and B memory; the lowest dominant share is offered first
+  // and, since it's a single framework's turn, gets the whole slave
+  m.addFramework("A");
+  m.addFramework("B");
+  m.setFrameworkResources("A", Resources(2, 0));
+  m.setFrameworkResources("B", Resources(0, 1 * Gigabyte));
+
+  // Shares out of <4 CPUs, 4 GB>: A 1/2, B 1/4
+  m.addSlave("a", Resources(4, 4 * Gigabyte));
+  ASSERT_EQ(1, m.offeredTo.size());
+  EXPECT_EQ("B", m.offeredTo[0].s);
+
+  // Out of <16 CPUs, 5 GB>: A 1/8, B 1/5
+  m.addSlave("b", Resources(12, 1 * Gigabyte));
+  ASSERT_EQ(2, m.offeredTo.size());
+  EXPECT_EQ("A", m.offeredTo[1].s);
+
+  // Out of <17 CPUs, 6 GB> with B's tasks gone: A 2/17, B 0
+  m.setFrameworkResources("B", Resources());
+  m.addSlave("c", Resources(1, 1 * Gigabyte));
+  ASSERT_EQ(3, m.offeredTo.size());
+  EXPECT_EQ("B", m.offeredTo[2].s);
+
+  // Losing slave b leaves <5 CPUs, 5 GB>: A 2/5, B 1/5
+  m.setFrameworkResources("B", Resources(0, 1 * Gigabyte));
+  m.removeSlave("b");
+  m.addSlave("d", Resources(1, 1 * Gigabyte));
+  ASSERT_EQ(4, m.offeredTo.size());
+  EXPECT_EQ("B", m.offeredTo[3].s);
+}
+
+
+TEST(MasterTest, StaleAllocationsCheckedBeforeOffering)
+{
+  Params conf;
+  conf.set("allocation_thread", true);
+  OfferRecordingMaster m(conf);
+
+  // Passes started on the allocation thread are handed back to a master
+  // that isn't running, so the test hands in a result of its own, made
+  // stale by what changed since the pass started
+  m.addFramework("framework");
+  m.addSlave("a");
+  m.addSlave("b");
+  m.addSlave("c");
+  m.removeSlave("b");
+
+  vector<pair<SlaveID, Resources> > resources;
+  resources.push_back(make_pair(SlaveID("a"), Resources(2, 1 * Gigabyte)));
+  resources.push_back(make_pair(SlaveID("b"), Resources(2, 1 * Gigabyte)));
+  resources.push_back(make_pair(SlaveID("c"), Resources(4, 1 * Gigabyte)));
+  Allocation allocation;
+  allocation.offers.push_back(make_pair(FrameworkID("framework"), resources));
+  allocation.offers.push_back(make_pair(FrameworkID("gone"), resources));
+
+  // Only the slave that's still there with the resources free is offered
+  m.getAllocator()->allocationFinished(allocation);
+  ASSERT_EQ(1, m.offers.size());
+  ASSERT_EQ(1, m.offers[0].size());
+  EXPECT_EQ("a", m.offers[0][0].s);
+}
+
+
+// Launches two tasks and expects to hear about both of them in one batch
+class BatchedUpdatesScheduler : public TaskRunningScheduler
+{
+public:
+  int batches;
+  vector<TaskStatus> statuses;
+
+  BatchedUpdatesScheduler() : batches(0) {}
+
+  virtual void resourceOffer(SchedulerDriver* d,
+                             OfferID id,
+                             const vector<SlaveOffer>& offers) {
+    ASSERT_TRUE(offers.size() == 1);
+    map<string, string> params;
+    params["cpus"] = "1";
+    params["mem"] = lexical_cast<string>(512 * Megabyte);
+    vector<TaskDescription> tasks;
+    tasks.push_back(TaskDescription(0, offers[0].slaveId, "", params, ""));
+    tasks.push_back(TaskDescription(1, offers[0].slaveId, "", params, ""));
+    d->replyToOffer(id, tasks, map<string, string>());
+  }
+
+  virtual void statusUpdate(SchedulerDriver* d, const TaskStatus& status) {
+    statuses.push_back(status);
+    d->stop();
+  }
+
+  virtual void statusUpdates(SchedulerDriver* d,
+                             const vector<TaskStatus>& statuses) {
+    batches++;
+    this->statuses.insert(this->statuses.end(),
+                          statuses.begin(), statuses.end());
+    d->stop();
+  }
+};
+
+
+// Finishes both tasks with one call once the second one is launched
+class BatchedUpdatesExecutor : public Executor
+{
+public:
+  vector<TaskID> launched;
+
+  virtual void launchTask(ExecutorDriver* d, const TaskDescription& task) {
+    launched.push_back(task.taskId);
+    if (launched.size() == 2) {
+      vector<TaskStatus> statuses;
+      foreach (TaskID tid, launched)
+        statuses.push_back(TaskStatus(tid, TASK_FINISHED, ""));
+      d->sendStatusUpdates(statuses);
+    }
+  }
+};
+
+
+TEST(MasterTest, StatusUpdatesBatchedBySlave)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  Master m;
+  PID master = Process::spawn(&m);
+
+  BatchedUpdatesExecutor exec;
+  LocalIsolationModule isolationModule(&exec);
+
+  // Hold updates until all four (running and finished for each task)
+  // can go together
+  Params conf;
+  conf.set("cpus", 2);
+  conf.set("mem", 1 * Gigabyte);
+  conf.set("status_update_interval", 60);
+  conf.set("status_update_batch_size", 4);
+  Slave s(conf, true, &isolationModule);
+  PID slave = Process::spawn(&s);
+
+  BasicMasterDetector detector(master, slave, true);
+
+  BatchedUpdatesScheduler sched;
+  MesosSchedulerDriver driver(&sched, master);
+
+  driver.run();
+
+  EXPECT_EQ("", sched.errorMessage);
+  EXPECT_EQ(1, sched.batches);
+  ASSERT_EQ(4, sched.statuses.size());
+  EXPECT_EQ(TASK_RUNNING, sched.statuses[0].state);
+  EXPECT_EQ(TASK_RUNNING, sched.statuses[1].state);
+  EXPECT_EQ(TASK_FINISHED, sched.statuses[2].state);
+  EXPECT_EQ(TASK_FINISHED, sched.statuses[3].state);
+
+  MesosProcess::post(slave, pack<S2S_SHUTDOWN>());
+  Process::wait(slave);
+
+  MesosProcess::post(master, pack<M2M_SHUTDOWN>());
+  Process::wait(master);
+}
+
+
+// Collects status updates until one says its task is done
+class TaskDoneScheduler : public TaskRunningScheduler
+{
+public:
+  vector<TaskState> states;
+
+  virtual void statusUpdate(SchedulerDriver* d, const TaskStatus& status) {
+    states.push_back(status.state);
+    if (status.state != TASK_STARTING && status.state != TASK_RUNNING)
+      d->stop();
+  }
+};
+
+
+// Finishes its task and exits right away
+class FinishAndExitExecutor : public Executor
+{
+public:
+  virtual void launchTask(ExecutorDriver* d, const TaskDescription& task) {
+    d->sendStatusUpdate(TaskStatus(task.taskId, TASK_FINISHED, ""));
+    d->stop();
+  }
+};
+
+
+TEST(MasterTest, HeldStatusUpdatesSentWhenExecutorExits)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  Master m;
+  PID master = Process::spawn(&m);
+
+  FinishAndExitExecutor exec;
+  LocalIsolationModule isolationModule(&exec);
+
+  // Hold updates for longer than the test runs
+  Params conf;
+  conf.set("cpus", 2);
+  conf.set("mem", 1 * Gigabyte);
+  conf.set("status_update_interval", 60);
+  Slave s(conf, true, &isolationModule);
+  PID slave = Process::spawn(&s);
+
+  BasicMasterDetector detector(master, slave, true);
+
+  TaskDoneScheduler sched;
+  MesosSchedulerDriver driver(&sched, master);
+
+  driver.run();
+
+  EXPECT_EQ("", sched.errorMessage);
+  ASSERT_FALSE(sched.states.empty());
+  EXPECT_EQ(TASK_FINISHED, sched.states.back());
+
+  MesosProcess::post(slave, pack<S2S_SHUTDOWN>());
+  Process::wait(slave);
+
+  MesosProcess::post(master, pack<M2M_SHUTDOWN>());
+  Process::wait(master);
+}
+
+
+// Stands in for a master that registers a slave and gives it a task,
+// recording the status updates the slave sends on their own and the
+// statuses that come with the executor being lost
+class LostExecutorMaster : public MesosProcess
+{
+public:
+  int updates;
+  vector<TaskStatus> lostStatuses;
+  volatile bool done;
+
+  LostExecutorMaster() : updates(0), done(false) {}
+
+protected:
+  void operator () ()
+  {
+    while (true) {
+      switch (receive()) {
+        case S2M_REGISTER_SLAVE: {
+          send(from(), pack<M2S_REGISTER_REPLY>("slave", 10));
+          ExecutorInfo executorInfo;
+          executorInfo.uri = "noexecutor";
+          send(from(), pack<M2S_ADD_FRAMEWORK>("framework", "name", "user",
+                                               executorInfo, PID()));
+          vector<TaskDescription> tasks;
+          tasks.push_back(TaskDescription(7, "slave", "", 1, 32, ""));
+          send(from(), pack<M2S_RUN_TASKS>("framework", tasks));
+          break;
+        }
+        case S2M_STATUS_UPDATE:
+        case S2M_FT_STATUS_UPDATE:
+        case S2M_FT_STATUS_UPDATES:
+          updates++;
+          break;
+        case S2M_LOST_EXECUTOR: {
+          SlaveID sid;
+          FrameworkID fid;
+          int32_t status;
+          tie(sid, fid, status, lostStatuses) =
+            unpack<S2M_LOST_EXECUTOR>(body());
+          done = true;
+          break;
+        }
+        case M2M_SHUTDOWN:
+          return;
+      }
+    }
+  }
+};
+
+
+TEST(MasterTest, HeldStatusUpdatesGoWithLostExecutor)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  LostExecutorMaster m;
+  PID master = Process::spawn(&m);
+
+  FinishAndExitExecutor exec;
+  LocalIsolationModule isolationModule(&exec);
+
+  // Hold updates for longer than the test runs
+  Params conf;
+  conf.set("cpus", 2);
+  conf.set("mem", 1 * Gigabyte);
+  conf.set("status_update_interval", 60);
+  Slave s(conf, true, &isolationModule);
+  PID slave = Process::spawn(&s);
+
+  BasicMasterDetector detector(master, slave, true);
+
+  while (!m.done)
+    usleep(10000);
+
+  // The task's final state isn't left to an update whose retries the
+  // slave cancels as it cleans up after the executor
+  EXPECT_EQ(0, m.updates);
+  ASSERT_FALSE(m.lostStatuses.empty());
+  foreach (const TaskStatus& status, m.lostStatuses)
+    EXPECT_EQ(7, status.taskId);
+  EXPECT_EQ(TASK_FINISHED, m.lostStatuses.back().state);
+
+  MesosProcess::post(slave, pack<S2S_SHUTDOWN>());
+  Process::wait(slave);
+
+  MesosProcess::post(master, pack<M2M_SHUTDOWN>());
+  Process::wait(master);
+}
+
+
+// Stands in for a master that registers a slave and then gives it a
+// task for a framework it never added, recording what the slave says
+class RunTasksForUnknownFrameworkMaster : public MesosProcess
+{
+public:
+  vector<pair<TaskID, TaskState> > updates;
+  volatile int lostExecutors;
+  volatile bool done;
+
+  RunTasksForUnknownFrameworkMaster() : lostExecutors(0), done(false) {}
+
+protected:
+  void operator () ()
+  {
+    while (true) {
+      switch (receive()) {
+        case S2M_REGISTER_SLAVE: {
+          send(from(), pack<M2S_REGISTER_REPLY>("slave", 10));
+          vector<TaskDescription> tasks;
+          tasks.push_back(TaskDescription(7, "slave", "", 1, 32, ""));
+          send(from(), pack<M2S_RUN_TASKS>("framework", tasks));
+          break;
+        }
+        case S2M_STATUS_UPDATE: {
+          SlaveID sid;
+          FrameworkID fid;
+          TaskID tid;
+          TaskState state;
+          string data;
+          tie(sid, fid, tid, state, data) = unpack<S2M_STATUS_UPDATE>(body());
+          updates.push_back(make_pair(tid, state));
+          done = true;
+          break;
+        }
+        case S2M_LOST_EXECUTOR:
+          lostExecutors++;
+          done = true;
+          break;
+        case M2M_SHUTDOWN:
+          return;
+      }
+    }
+  }
+};
+
+
+TEST(MasterTest, SlaveReportsTasksForUnknownFrameworkLost)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  RunTasksForUnknownFrameworkMaster m;
+  PID master = Process::spawn(&m);
+
+  TaskRunningExecutor exec;
+  LocalIsolationModule isolationModule(&exec);
+
+  Slave s(Resources(2, 1 * Gigabyte), true, &isolationModule);
+  PID slave = Process::spawn(&s);
+
+  BasicMasterDetector detector(master, slave, true);
+
+  while (!m.done)
+    usleep(10000);
+
+  EXPECT_EQ(0, m.lostExecutors);
+  ASSERT_EQ(1, m.updates.size());
+  EXPECT_EQ(7, m.updates[0].first);
+  EXPECT_EQ(TASK_LOST, m.updates[0].second);
+
+  MesosProcess::post(slave, pack<S2S_SHUTDOWN>());
+  Process::wait(slave);
+
+  MesosProcess::post(master, pack<M2M_SHUTDOWN>());
+  Process::wait(master);
+}
+
+
+// Launches one task per offer until two are running on the same slave
+class TwoLaunchesScheduler : public TaskRunningScheduler
+{
+public:
+  int launched;
+  int running;
+
+  TwoLaunchesScheduler() : launched(0), running(0) {}
+
+  virtual void resourceOffer(SchedulerDriver* d,
+                             OfferID id,
+                             const vector<SlaveOffer>& offers) {
+    ASSERT_TRUE(offers.size() == 1);
+    vector<TaskDescription> tasks;
+    if (launched < 2) {
+      map<string, string> params;
+      params["cpus"] = "1";
+      params["mem"] = lexical_cast<string>(512 * Megabyte);
+      tasks.push_back(TaskDescription(launched++, offers[0].slaveId, "",
+                                      params, ""));
+    }
+    d->replyToOffer(id, tasks, map<string, string>());
+  }
+
+  virtual void statusUpdate(SchedulerDriver* d, const TaskStatus& status) {
+    EXPECT_EQ(TASK_RUNNING, status.state);
+    if (++running == 2)
+      d->stop();
+  }
+};
+
+
+// Counts the task launch messages that the master sends to slaves
+class LaunchMessageFilter : public MessageFilter
+{
+public:
+  int addFrameworks;
+  int runTasks;
+
+  LaunchMessageFilter() : addFrameworks(0), runTasks(0) {}
+
+  virtual bool filter(struct msg *msg) {
+    if (msg->id == M2S_ADD_FRAMEWORK)
+      addFrameworks++;
+    else if (msg->id == M2S_RUN_TASKS)
+      runTasks++;
+    return false;
+  }
+};
+
+
+TEST(MasterTest, ExecutorInfoSentOncePerSlave)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  LaunchMessageFilter filter;
+  Process::filter(&filter);
+
+  Master m;
+  PID master = Process::spawn(&m);
+
+  TaskRunningExecutor exec;
+  LocalIsolationModule isolationModule(&exec);
+
+  Slave s(Resources(2, 1 * Gigabyte), true, &isolationModule);
+  PID slave = Process::spawn(&s);
+
+  BasicMasterDetector detector(master, slave, true);
+
+  TwoLaunchesScheduler sched;
+  MesosSchedulerDriver driver(&sched, master);
+
+  driver.run();
+
+  EXPECT_EQ("", sched.errorMessage);
+  EXPECT_EQ(2, sched.running);
+  EXPECT_EQ(1, filter.addFrameworks);
+  EXPECT_EQ(2, filter.runTasks);
+
+  Process::filter(NULL);
+
+  MesosProcess::post(slave, pack<S2S_SHUTDOWN>());
+  Process::wait(slave);
+
+  MesosProcess::post(master, pack<M2M_SHUTDOWN>());
+  Process::wait(master);
+}
+
+
 class SchedulerFailoverStatusUpdateScheduler : public TaskRunningScheduler
 {
  public:
@@ -0,0 +1,274 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <netinet/in.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+
+#include <process.hpp>
+
+using std::istringstream;
+using std::ostringstream;
+using std::string;
+
+
+namespace {
+
+const MSGID STOP = PROCESS_MSGID + 1;
+const MSGID PING = PROCESS_MSGID + 2;
+const MSGID PONG = PROCESS_MSGID + 3;
+
+
+// Answers every HTTP request it is routed with the path asked for
+class PathEchoingProcess : public Process
+{
+protected:
+  void operator () ()
+  {
+    while (true) {
+      switch (receive()) {
+        case PROCESS_HTTP: {
+          size_t length;
+          const char *data = body(&length);
+          HttpRequest request(data, length);
+          Process::respond(request.id, "200 OK", "text/plain",
+                           "path=" + request.path);
+          break;
+        }
+        case STOP:
+          return;
+      }
+    }
+  }
+};
+
+
+// Sends 'requests' to the libprocess port of 'pid' and returns all that
+// comes back until the connection is closed
+string fetch(const PID &pid, const string &requests)
+{
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  if (sock < 0)
+    return "";
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(pid.port);
+  addr.sin_addr.s_addr = pid.ip;
+  if (connect(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+      send(sock, requests.data(), requests.size(), 0) != requests.size()) {
+    close(sock);
+    return "";
+  }
+
+  string responses;
+  char buf[4096];
+  ssize_t len;
+  while ((len = recv(sock, buf, sizeof(buf), 0)) > 0)
+    responses.append(buf, len);
+  close(sock);
+  return responses;
+}
+
+
+// Counts the sockets of this OS process that are connected to 'peer',
+// over TCP if 'family' is AF_INET or over its Unix domain socket in
+// 'dir' if it is AF_UNIX
+int connectionsTo(const PID &peer, int family, const string &dir)
+{
+  DIR *fds = opendir("/proc/self/fd");
+  if (fds == NULL)
+    return -1;
+
+  ostringstream path;
+  path << dir << "/" << peer.port;
+
+  int count = 0;
+  struct dirent *entry;
+  while ((entry = readdir(fds)) != NULL) {
+    struct sockaddr_storage addr;
+    socklen_t length = sizeof(addr);
+    if (entry->d_name[0] == '.' ||
+        getpeername(atoi(entry->d_name), (struct sockaddr *) &addr,
+                    &length) < 0 ||
+        addr.ss_family != family)
+      continue;
+    if (family == AF_INET) {
+      struct sockaddr_in *in = (struct sockaddr_in *) &addr;
+      if (in->sin_addr.s_addr == peer.ip && ntohs(in->sin_port) == peer.port)
+        count++;
+    } else if (path.str() == ((struct sockaddr_un *) &addr)->sun_path) {
+      count++;
+    }
+  }
+  closedir(fds);
+  return count;
+}
+
+
+// Answers PINGs with PONGs until it is stopped
+class PongingProcess : public Process
+{
+protected:
+  void operator () ()
+  {
+    while (true) {
+      switch (receive()) {
+        case PING:
+          send(from(), PONG);
+          break;
+        case STOP:
+          return;
+      }
+    }
+  }
+};
+
+
+// Links to a process and pings it, and once the PONG is in, counts the
+// connections of each kind to it (the link's socket is kept open)
+class PingingProcess : public Process
+{
+public:
+  bool ponged;
+  int unixSockets;
+  int inetSockets;
+
+  PingingProcess(const PID &_peer, const string &_dir)
+    : ponged(false), unixSockets(0), inetSockets(0), peer(_peer),
+      dir(_dir) {}
+
+protected:
+  void operator () ()
+  {
+    link(peer);
+    send(peer, PING);
+    if (receive(5) == PONG) {
+      ponged = true;
+      unixSockets = connectionsTo(peer, AF_UNIX, dir);
+      inetSockets = connectionsTo(peer, AF_INET, dir);
+    }
+  }
+
+private:
+  const PID peer;
+  const string dir;
+};
+
+
+// Starts a PongingProcess in another OS process, which listens on a Unix
+// domain socket only if 'peerListens', and pings it from this one with
+// LIBPROCESS_SOCKET_DIR set. Exits with 0 if the PONG came back and the
+// connections to the peer were all of the given address family. This has
+// to run before libprocess is initialized, so it's only called in a death
+// test's child.
+void pingPeer(bool peerListens, int family)
+{
+  char dir[] = "/tmp/libprocess-test-XXXXXX";
+  int fds[2];
+  if (mkdtemp(dir) == NULL || pipe(fds) < 0) {
+    perror("pingPeer");
+    exit(2);
+  }
+
+  pid_t child = fork();
+  if (child == 0) {
+    close(fds[0]);
+    if (peerListens)
+      setenv("LIBPROCESS_SOCKET_DIR", dir, true);
+    PongingProcess process;
+    PID pid = Process::spawn(&process);
+    ostringstream out;
+    out << pid;
+    write(fds[1], out.str().data(), out.str().size());
+    close(fds[1]);
+    Process::wait(pid);
+    _exit(0);
+  }
+
+  close(fds[1]);
+  setenv("LIBPROCESS_SOCKET_DIR", dir, true);
+
+  string data;
+  char buf[256];
+  ssize_t len;
+  while ((len = read(fds[0], buf, sizeof(buf))) > 0)
+    data.append(buf, len);
+  close(fds[0]);
+  PID peer;
+  istringstream in(data);
+  in >> peer;
+
+  PingingProcess pinger(peer, dir);
+  Process::wait(Process::spawn(&pinger));
+  Process::post(peer, STOP);
+  waitpid(child, NULL, 0);
+
+  // Neither side got to remove its socket, so do it for them
+  DIR *sockets = opendir(dir);
+  struct dirent *entry;
+  while (sockets != NULL && (entry = readdir(sockets)) != NULL) {
+    if (entry->d_name[0] != '.')
+      unlink((string(dir) + "/" + entry->d_name).c_str());
+  }
+  if (sockets != NULL)
+    closedir(sockets);
+  rmdir(dir);
+
+  int used = family == AF_UNIX ? pinger.unixSockets : pinger.inetSockets;
+  int unused = family == AF_UNIX ? pinger.inetSockets : pinger.unixSockets;
+  // Shown by gtest if the death test fails
+  fprintf(stderr, "ponged=%d unix=%d inet=%d\n", pinger.ponged,
+          pinger.unixSockets, pinger.inetSockets);
+  // Leave without running destructors under libprocess's threads
+  _exit(pinger.ponged && used > 0 && unused == 0 ? 0 : 1);
+}
+
+} /* namespace */
+
+
+TEST(ProcessTest, RootRouteMatchesEveryPath)
+{
+  PathEchoingProcess process;
+  PID pid = Process::spawn(&process);
+  Process::route("/", pid);
+
+  const string responses = fetch(pid,
+    "GET / HTTP/1.1\r\n\r\n"
+    "GET /not/routed/anywhere/else HTTP/1.1\r\n"
+    "Connection: close\r\n\r\n");
+
+  size_t root = responses.find("HTTP/1.1 200 OK");
+  ASSERT_NE(string::npos, root);
+  size_t other = responses.find("HTTP/1.1 200 OK", root + 1);
+  ASSERT_NE(string::npos, other);
+  EXPECT_LT(responses.find("path=/", root), other);
+  EXPECT_NE(string::npos,
+            responses.find("path=/not/routed/anywhere/else", other));
+
+  Process::post(pid, STOP);
+  Process::wait(pid);
+}
+
+
+TEST(ProcessTest, PeersOnOneHostTalkOverUnixSockets)
+{
+  EXPECT_EXIT(pingPeer(true, AF_UNIX), testing::ExitedWithCode(0), "");
+}
+
+
+TEST(ProcessTest, PeersWithoutUnixSocketsTalkOverTcp)
+{
+  EXPECT_EXIT(pingPeer(false, AF_INET), testing::ExitedWithCode(0), "");
+}
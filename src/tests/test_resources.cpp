@@ -5,6 +5,14 @@
 
 #include "master/master.hpp"
 
+#include "messaging/messages.hpp"
+
+using std::istringstream;
+using std::ostringstream;
+
+using process::tuples::deserializer;
+using process::tuples::serializer;
+
 using namespace mesos;
 using namespace mesos::internal;
 using namespace mesos::internal::master;
@@ -13,8 +21,8 @@ using namespace mesos::internal::master;
 TEST(ResourcesTest, InitializedWithZero)
 {
   Resources r;
-  EXPECT_EQ(0, r.cpus);
-  EXPECT_EQ(0, r.mem);
+  EXPECT_EQ(0, r.cpus());
+  EXPECT_EQ(0, r.mem());
 }
 
 
@@ -23,15 +31,15 @@ TEST(ResourcesTest, Addition)
   Resources r1(1, 5);
   Resources r2(2, 10);
   Resources sum = r1 + r2;
-  EXPECT_EQ(3, sum.cpus);
-  EXPECT_EQ(15, sum.mem);
+  EXPECT_EQ(3, sum.cpus());
+  EXPECT_EQ(15, sum.mem());
   Resources r;
   r += r1;
-  EXPECT_EQ(1, r.cpus);
-  EXPECT_EQ(5, r.mem);
+  EXPECT_EQ(1, r.cpus());
+  EXPECT_EQ(5, r.mem());
   r += r2;
-  EXPECT_EQ(3, r.cpus);
-  EXPECT_EQ(15, r.mem);
+  EXPECT_EQ(3, r.cpus());
+  EXPECT_EQ(15, r.mem());
 }
 
 
@@ -40,15 +48,15 @@ TEST(ResourcesTest, Subtraction)
   Resources r1(1, 5);
   Resources r2(2, 10);
   Resources dif = r1 - r2;
-  EXPECT_EQ(-1, dif.cpus);
-  EXPECT_EQ(-5, dif.mem);
+  EXPECT_EQ(-1, dif.cpus());
+  EXPECT_EQ(-5, dif.mem());
   Resources r;
   r -= r1;
-  EXPECT_EQ(-1, r.cpus);
-  EXPECT_EQ(-5, r.mem);
+  EXPECT_EQ(-1, r.cpus());
+  EXPECT_EQ(-5, r.mem());
   r -= r2;
-  EXPECT_EQ(-3, r.cpus);
-  EXPECT_EQ(-15, r.mem);
+  EXPECT_EQ(-3, r.cpus());
+  EXPECT_EQ(-15, r.mem());
 }
 
 
@@ -59,3 +67,107 @@ TEST(ResourcesTest, PrettyPrinting)
   oss << r;
   EXPECT_EQ("<3 CPUs, 1001001001 MEM>", oss.str());
 }
+
+
+TEST(ResourcesTest, ExtraResources)
+{
+  Resources r1(1, 5, 100, 10);
+  Resources r2(2, 10, 0, 5);
+  Resources sum = r1 + r2;
+  EXPECT_EQ(3, sum.cpus());
+  EXPECT_EQ(15, sum.mem());
+  EXPECT_EQ(100, sum.disk());
+  EXPECT_EQ(15, sum.net());
+  Resources dif = r2 - r1;
+  EXPECT_EQ(-100, dif.amounts[DISK]);
+  EXPECT_EQ(-5, dif.amounts[NET]);
+  ostringstream oss;
+  oss << sum;
+  EXPECT_EQ("<3 CPUs, 15 MEM, 100 DISK, 15 NET>", oss.str());
+}
+
+
+TEST(ResourcesTest, Comparisons)
+{
+  Resources offered(4, 1024, 100, 0);
+  EXPECT_TRUE(Resources(4, 1024).fitsIn(offered));
+  EXPECT_TRUE(Resources(1, 512, 100, 0).fitsIn(offered));
+  EXPECT_FALSE(Resources(1, 512, 101, 0).fitsIn(offered));
+  EXPECT_FALSE(Resources(1, 512, 0, 1).fitsIn(offered));
+  EXPECT_TRUE(Resources().isZero());
+  EXPECT_FALSE(Resources(0, 0, 0, 1).isZero());
+  EXPECT_TRUE(Resources(-1, 0, 1, 0).anyPositive());
+  EXPECT_FALSE(Resources(-1, 0, 0, 0).anyPositive());
+  EXPECT_TRUE(Resources(1, 0, -1, 0).anyNegative());
+  EXPECT_FALSE(Resources(1, 0, 0, 0).anyNegative());
+}
+
+
+TEST(ResourcesTest, DominantShare)
+{
+  Resources total(10, 1000, 100, 0);
+  EXPECT_DOUBLE_EQ(0.2, Resources(2, 100).dominantShare(total));
+  EXPECT_DOUBLE_EQ(0.5, Resources(2, 100, 50, 0).dominantShare(total));
+  EXPECT_DOUBLE_EQ(0, Resources().dominantShare(total));
+  // Resources the total has none of are left out
+  EXPECT_DOUBLE_EQ(0, Resources(0, 0, 0, 3).dominantShare(total));
+  EXPECT_DOUBLE_EQ(0.1, Resources(1, 0, 0, 3).dominantShare(total));
+}
+
+
+TEST(ResourcesTest, Params)
+{
+  map<string, string> params;
+  Resources(2, 100, 50, 0).writeParams(&params);
+  EXPECT_EQ(1, params.size());
+  EXPECT_EQ("50", params["disk"]);
+
+  params["net"] = "20";
+  Resources r(2, 100);
+  r.readParams(params);
+  EXPECT_EQ(2, r.cpus());
+  EXPECT_EQ(100, r.mem());
+  EXPECT_EQ(50, r.disk());
+  EXPECT_EQ(20, r.net());
+
+  params["disk"] = "lots";
+  r.readParams(params);
+  EXPECT_EQ(-1, r.disk());
+  EXPECT_TRUE(r.anyNegative());
+}
+
+
+TEST(ResourcesTest, Serialization)
+{
+  ostringstream out;
+  serializer s(out);
+  s & Resources(1, 2, 3, 4);
+
+  // As if from a sender with two more resources than we know about
+  s & (int32_t) (NUM_RESOURCES + 2);
+  for (int32_t i = 0; i < NUM_RESOURCES + 2; i++)
+    s & (int32_t) (i + 1);
+
+  // A corrupt count
+  s & (int32_t) 0x7fffffff;
+
+  istringstream in(out.str());
+  deserializer d(in);
+  Resources r;
+  d & r;
+  EXPECT_EQ(1, r.cpus());
+  EXPECT_EQ(2, r.mem());
+  EXPECT_EQ(3, r.disk());
+  EXPECT_EQ(4, r.net());
+
+  d & r;
+  EXPECT_FALSE(in.fail());
+  for (int i = 0; i < NUM_RESOURCES; i++)
+    EXPECT_EQ(i + 1, r.amounts[i]);
+  for (int i = NUM_RESOURCES; i < MAX_RESOURCES; i++)
+    EXPECT_EQ(0, r.amounts[i]);
+
+  d & r;
+  EXPECT_TRUE(in.fail());
+  EXPECT_TRUE(r.isZero());
+}
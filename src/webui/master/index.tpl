@@ -63,6 +63,8 @@ Total in Cluster: {{total_cpus}} CPUs, {{format_mem(total_mem)}} MEM<br />
 In Use: {{running_cpus}} CPUs, {{format_mem(running_mem)}} MEM<br />
 Offered: {{offered_cpus}} CPUs, {{format_mem(offered_mem)}} MEM<br />
 Idle: {{idle_cpus}} CPUs, {{format_mem(idle_mem)}} MEM<br />
+Oldest Offer: {{"%.1f" % master.oldest_offer_age}} seconds<br />
+Offers Timed Out: {{master.offers_expired}}<br />
 </p>
 
 <h2>Frameworks</h2>
@@ -142,6 +144,7 @@ Idle: {{idle_cpus}} CPUs, {{format_mem(idle_mem)}} MEM<br />
   <th>Framework ID</th>
   <th>CPUs</th>
   <th>MEM</th>
+  <th>Age</th>
   <th>Slave IDs</th>
   </tr>
   %for f in master.frameworks:
@@ -159,6 +162,7 @@ Idle: {{idle_cpus}} CPUs, {{format_mem(idle_mem)}} MEM<br />
       <td>{{o.framework_id}}</td>
       <td>{{cpus}}</td>
       <td>{{format_mem(mem)}}</td>
+      <td>{{"%.1f" % o.age}}s</td>
       <td>{{", ".join(slave_ids)}}</td>
       </tr>
     %end
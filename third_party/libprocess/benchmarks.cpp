@@ -0,0 +1,602 @@
+/*
+ * Microbenchmarks for libprocess. Each benchmark reports how many
+ * operations it performed and how long they took, and the results
+ * are printed to stdout as JSON so that they can be compared across
+ * changes to process.cpp.
+ *
+ * Usage: benchmarks [iterations]
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "fatal.hpp"
+#include "process.hpp"
+
+#include "tuples/tuples.hpp"
+
+using std::cout;
+using std::endl;
+using std::map;
+using std::string;
+using std::vector;
+
+
+namespace benchmarks {
+
+enum {
+  PING = PROCESS_MSGID,
+  PONG,
+  DATA,
+  DONE,
+
+  /* Messages shaped like M2F_SLOT_OFFER and M2S_RUN_TASK in Mesos. */
+  SLOT_OFFER,
+  RUN_TASK,
+};
+
+
+struct SlaveOffer
+{
+  string slaveId;
+  string host;
+  map<string, string> params;
+};
+
+
+struct ExecutorInfo
+{
+  string uri;
+  string data;
+  map<string, string> params;
+};
+
+
+template<typename T>
+void operator & (process::tuples::serializer& s, const vector<T>& v)
+{
+  int32_t size = (int32_t) v.size();
+  s & size;
+  for (int32_t i = 0; i < size; i++)
+    s & v[i];
+}
+
+
+template<typename T>
+void operator & (process::tuples::deserializer& d, vector<T>& v)
+{
+  int32_t size;
+  d & size;
+  v.resize(size);
+  for (int32_t i = 0; i < size; i++)
+    d & v[i];
+}
+
+
+template<typename K, typename V>
+void operator & (process::tuples::serializer& s, const map<K, V>& m)
+{
+  int32_t size = (int32_t) m.size();
+  s & size;
+  for (typename map<K, V>::const_iterator it = m.begin(); it != m.end(); ++it) {
+    s & it->first;
+    s & it->second;
+  }
+}
+
+
+template<typename K, typename V>
+void operator & (process::tuples::deserializer& d, map<K, V>& m)
+{
+  m.clear();
+  int32_t size;
+  d & size;
+  K k;
+  V v;
+  for (int32_t i = 0; i < size; i++) {
+    d & k;
+    d & v;
+    m[k] = v;
+  }
+}
+
+
+void operator & (process::tuples::serializer& s, const SlaveOffer& offer)
+{
+  s & offer.slaveId;
+  s & offer.host;
+  s & offer.params;
+}
+
+
+void operator & (process::tuples::deserializer& d, SlaveOffer& offer)
+{
+  d & offer.slaveId;
+  d & offer.host;
+  d & offer.params;
+}
+
+
+void operator & (process::tuples::serializer& s, const ExecutorInfo& info)
+{
+  s & info.uri;
+  s & info.data;
+  s & info.params;
+}
+
+
+void operator & (process::tuples::deserializer& d, ExecutorInfo& info)
+{
+  d & info.uri;
+  d & info.data;
+  d & info.params;
+}
+
+
+#include <tuples/details.hpp>
+
+
+TUPLE(SLOT_OFFER,
+      (string /*offerId*/,
+       vector<SlaveOffer>,
+       map<string, PID>));
+
+TUPLE(RUN_TASK,
+      (string /*frameworkId*/,
+       int32_t /*taskId*/,
+       string /*frameworkName*/,
+       string /*user*/,
+       ExecutorInfo,
+       string /*taskName*/,
+       string /*taskArgs*/,
+       map<string, string> /*params*/,
+       PID /*framework PID*/));
+
+
+/* Size of the body of DATA messages. */
+const size_t DATA_SIZE = 64;
+
+
+double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+struct Result
+{
+  Result(const string &_name, int _operations, double _secs)
+    : name(_name), operations(_operations), secs(_secs) {}
+
+  string name;
+  int operations;
+  double secs;
+};
+
+
+vector<Result> results;
+
+
+/* Replies to each PING with a PONG until it gets a DONE. */
+class Ponger : public Process
+{
+private:
+  double secs;
+
+protected:
+  void operator () ()
+  {
+    while (true) {
+      switch (secs > 0 ? receive(secs) : receive()) {
+        case PING:
+          send(from(), PONG);
+          break;
+        case DONE:
+          return;
+        default:
+          fatal("ponger received unexpected message %d", msgid());
+      }
+    }
+  }
+
+public:
+  /* A non-zero 'secs' makes every receive start (and cancel) a timer. */
+  Ponger(double _secs = 0) : secs(_secs) {}
+};
+
+
+/* Sends a PING and waits for the PONG 'count' times. */
+class Pinger : public Process
+{
+private:
+  const PID ponger;
+  const int count;
+  double secs;
+
+protected:
+  void operator () ()
+  {
+    link(ponger);
+    for (int i = 0; i < count; i++) {
+      send(ponger, PING);
+      if ((secs > 0 ? receive(secs) : receive()) != PONG)
+        fatal("pinger received unexpected message %d", msgid());
+    }
+    send(ponger, DONE);
+  }
+
+public:
+  Pinger(const PID &_ponger, int _count, double _secs = 0)
+    : ponger(_ponger), count(_count), secs(_secs) {}
+};
+
+
+/* Counts DATA messages and exits once it has seen 'count' of them. */
+class Sink : public Process
+{
+private:
+  const int count;
+
+protected:
+  void operator () ()
+  {
+    for (int i = 0; i < count; i++) {
+      if (receive() != DATA)
+        fatal("sink received unexpected message %d", msgid());
+    }
+  }
+
+public:
+  Sink(int _count) : count(_count) {}
+};
+
+
+/* Sends 'count' DATA messages to each of its targets. */
+class Source : public Process
+{
+private:
+  const vector<PID> targets;
+  const int count;
+
+protected:
+  void operator () ()
+  {
+    char data[DATA_SIZE];
+    memset(data, 0, sizeof(data));
+    for (int i = 0; i < count; i++) {
+      for (size_t j = 0; j < targets.size(); j++)
+        send(targets[j], DATA, data, sizeof(data));
+    }
+  }
+
+public:
+  Source(const vector<PID> &_targets, int _count)
+    : targets(_targets), count(_count) {}
+};
+
+
+class Noop : public Process
+{
+protected:
+  void operator () () {}
+};
+
+
+/* Awaits readability of 'fd', reads the timestamp a writer put on it,
+   and acknowledges on 'ack' so the writer can send the next one. */
+class Awaiter : public Process
+{
+private:
+  const int fd;
+  const int ack;
+  const int count;
+
+protected:
+  void operator () ()
+  {
+    timeval tv;
+    tv.tv_sec = 60;
+    tv.tv_usec = 0;
+
+    for (int i = 0; i < count; i++) {
+      if (!await(fd, RDONLY, tv, true))
+        fatal("await timed out");
+      double sent;
+      if (read(fd, &sent, sizeof(sent)) != sizeof(sent))
+        fatalerror("read failed");
+      latency += now() - sent;
+      char c = 0;
+      if (write(ack, &c, 1) != 1)
+        fatalerror("write failed");
+    }
+  }
+
+public:
+  Awaiter(int _fd, int _ack, int _count)
+    : fd(_fd), ack(_ack), count(_count), latency(0) {}
+
+  double latency;
+};
+
+
+void pingPong(const string &name, const PID &ponger, int count, double secs)
+{
+  Pinger pinger(ponger, count, secs);
+  double start = now();
+  Process::wait(Process::spawn(&pinger));
+  results.push_back(Result(name, count, now() - start));
+}
+
+
+void benchmarkLocalPingPong(int count)
+{
+  Ponger ponger;
+  pingPong("local_ping_pong", Process::spawn(&ponger), count, 0);
+  Process::wait(ponger.self());
+}
+
+
+void benchmarkRemotePingPong(const PID &ponger, int count)
+{
+  pingPong("remote_ping_pong", ponger, count, 0);
+}
+
+
+void benchmarkTimers(int count)
+{
+  // Every blocking receive with a timeout inserts a timer and then
+  // cancels it when the message arrives, so this is ping-pong plus
+  // two timer insert/cancel pairs per round trip.
+  Ponger ponger(60);
+  pingPong("timer_insert_cancel", Process::spawn(&ponger), count, 60);
+  Process::wait(ponger.self());
+}
+
+
+void benchmarkOneToMany(int receivers, int count)
+{
+  vector<Sink *> sinks;
+  vector<PID> pids;
+
+  double start = now();
+
+  for (int i = 0; i < receivers; i++) {
+    sinks.push_back(new Sink(count));
+    pids.push_back(Process::spawn(sinks.back()));
+  }
+
+  Source source(pids, count);
+  Process::spawn(&source);
+
+  for (int i = 0; i < receivers; i++) {
+    Process::wait(pids[i]);
+    delete sinks[i];
+  }
+
+  Process::wait(source.self());
+
+  results.push_back(Result("one_to_many", receivers * count, now() - start));
+}
+
+
+void benchmarkManyToOne(int senders, int count)
+{
+  vector<Source *> sources;
+
+  double start = now();
+
+  Sink sink(senders * count);
+  vector<PID> targets(1, Process::spawn(&sink));
+
+  for (int i = 0; i < senders; i++) {
+    sources.push_back(new Source(targets, count));
+    Process::spawn(sources.back());
+  }
+
+  Process::wait(sink.self());
+
+  for (int i = 0; i < senders; i++) {
+    Process::wait(sources[i]->self());
+    delete sources[i];
+  }
+
+  results.push_back(Result("many_to_one", senders * count, now() - start));
+}
+
+
+void benchmarkSpawnExit(int count)
+{
+  vector<Noop *> processes;
+
+  double start = now();
+
+  for (int i = 0; i < count; i++) {
+    processes.push_back(new Noop());
+    Process::spawn(processes.back());
+  }
+
+  for (int i = 0; i < count; i++) {
+    Process::wait(processes[i]->self());
+    delete processes[i];
+  }
+
+  results.push_back(Result("spawn_exit", count, now() - start));
+}
+
+
+void benchmarkAwait(int count)
+{
+  int data[2], ack[2];
+  if (pipe(data) < 0 || pipe(ack) < 0)
+    fatalerror("pipe failed");
+
+  Awaiter awaiter(data[0], ack[1], count);
+  Process::spawn(&awaiter);
+
+  for (int i = 0; i < count; i++) {
+    double sent = now();
+    if (write(data[1], &sent, sizeof(sent)) != sizeof(sent))
+      fatalerror("write failed");
+    char c;
+    if (read(ack[0], &c, 1) != 1)
+      fatalerror("read failed");
+  }
+
+  Process::wait(awaiter.self());
+
+  close(data[0]);
+  close(data[1]);
+  close(ack[0]);
+  close(ack[1]);
+
+  // Report the total wakeup latency rather than the total runtime so
+  // that the per operation time is the mean wakeup latency.
+  results.push_back(Result("await_wakeup", count, awaiter.latency));
+}
+
+
+void benchmarkSlotOfferTuples(int count)
+{
+  vector<SlaveOffer> offers;
+  map<string, PID> pids;
+  for (int i = 0; i < 10; i++) {
+    SlaveOffer offer;
+    offer.slaveId = "201007281200-0-" + string(1, 'a' + i);
+    offer.host = "host" + string(1, 'a' + i) + ".example.com";
+    offer.params["cpus"] = "4";
+    offer.params["mem"] = "8589934592";
+    offers.push_back(offer);
+    pids[offer.slaveId] = PID("1@127.0.0.1:5051");
+  }
+
+  double start = now();
+  for (int i = 0; i < count; i++) {
+    string data = pack<SLOT_OFFER>("201007281200-0-42", offers, pids);
+    unpack<SLOT_OFFER>(data);
+  }
+  results.push_back(Result("tuples_slot_offer", count, now() - start));
+}
+
+
+void benchmarkRunTaskTuples(int count)
+{
+  ExecutorInfo info;
+  info.uri = "hdfs://namenode/user/mesos/executor.tgz";
+  info.data = string(256, 'x');
+  info.params["env"] = "production";
+
+  map<string, string> params;
+  params["cpus"] = "1";
+  params["mem"] = "1073741824";
+
+  double start = now();
+  for (int i = 0; i < count; i++) {
+    string data = pack<RUN_TASK>("201007281200-0-7", i, "benchmark", "mesos",
+                                 info, "task", string(128, 'y'), params,
+                                 PID("1@127.0.0.1:5050"));
+    unpack<RUN_TASK>(data);
+  }
+  results.push_back(Result("tuples_run_task", count, now() - start));
+}
+
+
+void print()
+{
+  cout << "{" << endl;
+  cout << "  \"benchmarks\": [" << endl;
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result &result = results[i];
+    double rate = result.secs > 0 ? result.operations / result.secs : 0;
+    double usecs = result.operations > 0
+      ? result.secs * 1000000.0 / result.operations
+      : 0;
+    cout << "    {"
+         << "\"name\": \"" << result.name << "\", "
+         << "\"operations\": " << result.operations << ", "
+         << "\"seconds\": " << result.secs << ", "
+         << "\"operations_per_second\": " << rate << ", "
+         << "\"microseconds_per_operation\": " << usecs
+         << "}" << (i + 1 < results.size() ? "," : "") << endl;
+  }
+  cout << "  ]," << endl;
+  cout << "  \"proc_migrations\": " << ProcessStats::procMigrations()
+       << "," << endl;
+  cout << "  \"io_migrations\": " << ProcessStats::ioMigrations() << endl;
+  cout << "}" << endl;
+}
+
+} /* namespace benchmarks */
+
+
+using namespace benchmarks;
+
+
+int main(int argc, char **argv)
+{
+  int iterations = argc > 1 ? atoi(argv[1]) : 10000;
+
+  if (iterations <= 0) {
+    fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+    return -1;
+  }
+
+  // Fork the remote end of the remote ping-pong before libprocess
+  // gets initialized so that the child gets its own instance (and
+  // hence its own port).
+  int fds[2];
+  if (pipe(fds) < 0)
+    fatalerror("pipe failed");
+
+  pid_t child = fork();
+  if (child < 0) {
+    fatalerror("fork failed");
+  } else if (child == 0) {
+    close(fds[0]);
+    unsetenv("LIBPROCESS_PORT");
+    Ponger ponger;
+    string pid = Process::spawn(&ponger);
+    pid += "\n";
+    if (write(fds[1], pid.data(), pid.size()) != (ssize_t) pid.size())
+      fatalerror("write failed");
+    close(fds[1]);
+    Process::wait(ponger.self());
+    _exit(0);
+  }
+
+  close(fds[1]);
+  string pid;
+  char c;
+  while (read(fds[0], &c, 1) == 1 && c != '\n')
+    pid += c;
+  close(fds[0]);
+
+  benchmarkLocalPingPong(iterations);
+  benchmarkRemotePingPong(PID(pid), iterations);
+  benchmarkOneToMany(10, iterations);
+  benchmarkManyToOne(10, iterations);
+  benchmarkSpawnExit(iterations);
+  benchmarkTimers(iterations);
+  benchmarkAwait(iterations);
+  benchmarkSlotOfferTuples(iterations);
+  benchmarkRunTaskTuples(iterations);
+
+  waitpid(child, NULL, 0);
+
+  print();
+
+  return 0;
+}
@@ -0,0 +1,284 @@
+#ifndef __FUTURE_HPP__
+#define __FUTURE_HPP__
+
+#include <pthread.h>
+#include <time.h>
+
+#include <sys/time.h>
+
+#include <list>
+#include <vector>
+
+#include <tr1/functional>
+#include <tr1/memory>
+
+
+template <typename T> class Promise;
+
+
+/**
+ * A value that will become available at some point in the future
+ * (set through the corresponding Promise). Futures are cheap to copy
+ * and all copies refer to the same value.
+ *
+ * Callbacks registered with onReady are invoked (exactly once) by
+ * whichever thread sets the value, or immediately if the value is
+ * already set. When the value is set from a libprocess process (as
+ * with 'request') the callbacks run in that process, so they must not
+ * block; a common pattern is to post a message to the interested
+ * process instead. Likewise, 'get' and 'await' block the calling
+ * thread and must only be used by non-libprocess threads.
+ */
+template <typename T>
+class Future
+{
+public:
+  /* Returns true if the value has been set. */
+  bool ready() const;
+
+  /* Blocks until the value has been set and then returns it. */
+  const T & get() const;
+
+  /* Blocks at most specified seconds, returns true if the value is set. */
+  bool await(double secs) const;
+
+  /* Invokes the callback with the value once it has been set. */
+  void onReady(const std::tr1::function<void (const T &)> &callback) const;
+
+private:
+  friend class Promise<T>;
+
+  struct State
+  {
+    State() : ready(false)
+    {
+      pthread_mutex_init(&mutex, NULL);
+      pthread_cond_init(&cond, NULL);
+    }
+
+    ~State()
+    {
+      pthread_mutex_destroy(&mutex);
+      pthread_cond_destroy(&cond);
+    }
+
+    bool ready;
+    T value;
+    std::list<std::tr1::function<void (const T &)> > callbacks;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+  };
+
+  Future(const std::tr1::shared_ptr<State> &_state) : state(_state) {}
+
+  std::tr1::shared_ptr<State> state;
+};
+
+
+/**
+ * The producing side of a Future. Only the first call to 'set' has
+ * any effect.
+ */
+template <typename T>
+class Promise
+{
+public:
+  Promise() : state(new typename Future<T>::State()) {}
+
+  Future<T> future() const { return Future<T>(state); }
+
+  /* Sets the value (returns false if it was already set). */
+  bool set(const T &value) const;
+
+private:
+  std::tr1::shared_ptr<typename Future<T>::State> state;
+};
+
+
+/* Returns a future that is ready once all of the futures are ready. */
+template <typename T>
+Future<std::vector<T> > all(const std::vector<Future<T> > &futures);
+
+
+/* Returns a future that is ready once any of the futures is ready. */
+template <typename T>
+Future<T> any(const std::vector<Future<T> > &futures);
+
+
+template <typename T>
+bool Future<T>::ready() const
+{
+  pthread_mutex_lock(&state->mutex);
+  bool ready = state->ready;
+  pthread_mutex_unlock(&state->mutex);
+  return ready;
+}
+
+
+template <typename T>
+const T & Future<T>::get() const
+{
+  pthread_mutex_lock(&state->mutex);
+  while (!state->ready)
+    pthread_cond_wait(&state->cond, &state->mutex);
+  pthread_mutex_unlock(&state->mutex);
+  return state->value;
+}
+
+
+template <typename T>
+bool Future<T>::await(double secs) const
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+
+  double deadline = now.tv_sec + now.tv_usec / 1000000.0 + secs;
+
+  struct timespec ts;
+  ts.tv_sec = (time_t) deadline;
+  ts.tv_nsec = (long) ((deadline - ts.tv_sec) * 1000000000.0);
+
+  pthread_mutex_lock(&state->mutex);
+  while (!state->ready) {
+    if (pthread_cond_timedwait(&state->cond, &state->mutex, &ts) != 0)
+      break;
+  }
+  bool ready = state->ready;
+  pthread_mutex_unlock(&state->mutex);
+  return ready;
+}
+
+
+template <typename T>
+void Future<T>::onReady(
+    const std::tr1::function<void (const T &)> &callback) const
+{
+  bool ready;
+
+  pthread_mutex_lock(&state->mutex);
+  {
+    ready = state->ready;
+    if (!ready)
+      state->callbacks.push_back(callback);
+  }
+  pthread_mutex_unlock(&state->mutex);
+
+  /* The value is immutable once set, so no need to hold the lock. */
+  if (ready)
+    callback(state->value);
+}
+
+
+template <typename T>
+bool Promise<T>::set(const T &value) const
+{
+  std::list<std::tr1::function<void (const T &)> > callbacks;
+
+  pthread_mutex_lock(&state->mutex);
+  {
+    if (state->ready) {
+      pthread_mutex_unlock(&state->mutex);
+      return false;
+    }
+    state->value = value;
+    state->ready = true;
+    callbacks.swap(state->callbacks);
+    pthread_cond_broadcast(&state->cond);
+  }
+  pthread_mutex_unlock(&state->mutex);
+
+  /* Invoke callbacks outside the lock (they might use the future). */
+  typename std::list<std::tr1::function<void (const T &)> >::iterator it;
+  for (it = callbacks.begin(); it != callbacks.end(); ++it)
+    (*it)(value);
+
+  return true;
+}
+
+
+namespace detail {
+
+template <typename T>
+struct Collector
+{
+  Collector(size_t count) : values(count), remaining(count)
+  {
+    pthread_mutex_init(&mutex, NULL);
+  }
+
+  ~Collector()
+  {
+    pthread_mutex_destroy(&mutex);
+  }
+
+  std::vector<T> values;
+  size_t remaining;
+  pthread_mutex_t mutex;
+  Promise<std::vector<T> > promise;
+};
+
+
+template <typename T>
+void collect(const std::tr1::shared_ptr<Collector<T> > &collector,
+             size_t index, const T &value)
+{
+  bool done;
+
+  pthread_mutex_lock(&collector->mutex);
+  {
+    collector->values[index] = value;
+    done = --collector->remaining == 0;
+  }
+  pthread_mutex_unlock(&collector->mutex);
+
+  if (done)
+    collector->promise.set(collector->values);
+}
+
+
+template <typename T>
+void first(const Promise<T> &promise, const T &value)
+{
+  promise.set(value);
+}
+
+} /* namespace detail */
+
+
+template <typename T>
+Future<std::vector<T> > all(const std::vector<Future<T> > &futures)
+{
+  std::tr1::shared_ptr<detail::Collector<T> > collector(
+      new detail::Collector<T>(futures.size()));
+
+  Future<std::vector<T> > future = collector->promise.future();
+
+  if (futures.empty()) {
+    collector->promise.set(std::vector<T>());
+    return future;
+  }
+
+  for (size_t i = 0; i < futures.size(); i++) {
+    futures[i].onReady(std::tr1::bind(&detail::collect<T>, collector, i,
+                                      std::tr1::placeholders::_1));
+  }
+
+  return future;
+}
+
+
+template <typename T>
+Future<T> any(const std::vector<Future<T> > &futures)
+{
+  Promise<T> promise;
+
+  for (size_t i = 0; i < futures.size(); i++) {
+    futures[i].onReady(std::tr1::bind(&detail::first<T>, promise,
+                                      std::tr1::placeholders::_1));
+  }
+
+  return promise.future();
+}
+
+
+#endif /* __FUTURE_HPP__ */
@@ -5,6 +5,7 @@
 #include <limits.h>
 #include <netdb.h>
 #include <pthread.h>
+#include <sched.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -24,6 +25,7 @@
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/un.h>
 
 #include <boost/tuple/tuple.hpp>
 
@@ -59,6 +61,7 @@ using std::ostream;
 using std::queue;
 using std::set;
 using std::stack;
+using std::string;
 
 
 #define Byte (1)
@@ -230,7 +233,7 @@ public:
   void record(struct msg *msg);
   void replay();
 
-  void deliver(struct msg *msg, Process *sender = NULL);
+  bool deliver(struct msg *msg, Process *sender = NULL);
 
   void spawn(Process *process);
   void link(Process *process, const PID &to);
@@ -270,6 +273,66 @@ private:
 };
 
 
+class HttpManager
+{
+public:
+  HttpManager();
+  ~HttpManager();
+
+  void route(const string &path, const PID &pid);
+
+  void accepted(int s);
+  bool received(int s, const char *data, size_t length);
+  void stopped(int s);
+  bool write(int s);
+  bool written(int s);
+
+  void respond(uint64_t request, const string &status,
+               const string &type, const string &body);
+
+private:
+  void dispatch(uint64_t request, const string &method, const string &uri);
+  void maybe_close(int s);
+
+  /* An HTTP connection, which stays open until every request read on
+     it has been answered (and its watchers have stopped). */
+  struct connection {
+    string in;         /* Received but not yet parsed. */
+    string out;        /* Responses to write, in request order. */
+    size_t written;    /* Bytes of out already written. */
+    uint64_t requests; /* Requests read (sequence number of next). */
+    uint64_t answered; /* Responses added to out (or dropped). */
+    map<uint64_t, string> early; /* Responses to later requests. */
+    bool reading;      /* Is there a watcher reading requests? */
+    bool writing;      /* Is there a watcher writing out? */
+    bool closing;      /* Don't read any more requests? */
+    bool broken;       /* Failed to write (drop responses)? */
+  };
+
+  /* An outstanding request. */
+  struct request {
+    int s;
+    uint64_t seq;
+    bool head;         /* Don't send the body. */
+    bool close;        /* Close the connection after the response. */
+  };
+
+  /* Map from path to process (see route). */
+  map<string, PID> routes;
+
+  /* Map from socket to connection. */
+  map<int, connection> connections;
+
+  /* Map from request id to request. */
+  map<uint64_t, request> requests;
+
+  uint64_t next_request;
+
+  /* Protects instance variables. */
+  synchronizable(this);
+};
+
+
 /* Tick, tock ... manually controlled clock! */
 class InternalProcessClock
 {
@@ -348,12 +411,25 @@ static uint32_t ip = 0;
 /* Local port. */
 static uint16_t port = 0;
 
+/* Directory for Unix domain sockets (NULL if not using them). */
+static char *socket_dir = NULL;
+
+/* Local Unix domain server socket. */
+static int us = -1;
+
+/* Process that created the Unix domain socket (forked children
+   inherit our atexit handlers but must not remove it). */
+static pid_t us_owner = 0;
+
 /* Active LinkManager (eventually will probably be thread-local). */
 static LinkManager *link_manager = NULL;
 
 /* Active ProcessManager (eventually will probably be thread-local). */
 static ProcessManager *process_manager = NULL;
 
+/* Active HttpManager. */
+static HttpManager *http_manager = NULL;
+
 /* Event loop. */
 static struct ev_loop *loop = NULL;
 
@@ -366,6 +442,12 @@ static ev_timer timeouts_watcher;
 /* Server watcher for accepting connections. */
 static ev_io server_watcher;
 
+/* Server watcher for accepting Unix domain connections. */
+static ev_io unix_server_watcher;
+
+/* Watcher run on each I/O loop iteration (to sample the I/O thread's CPU). */
+static ev_check io_check_watcher;
+
 /* Queue of new I/O watchers. */
 static queue<ev_io *> *io_watchersq = new queue<ev_io *>();
 static synchronizable(io_watchersq) = SYNCHRONIZED_INITIALIZER;
@@ -390,6 +472,14 @@ static pthread_t io_thread;
 /* Processing thread. */
 static pthread_t proc_thread;
 
+/* Last CPU the I/O thread was seen on and times that changed. */
+static int io_cpu = -1;
+static volatile uint64_t io_migrations = 0;
+
+/* Last CPU the processing thread was seen on and times that changed. */
+static int proc_cpu = -1;
+static volatile uint64_t proc_migrations = 0;
+
 /* Scheduling context for processing thread. */
 static ucontext_t proc_uctx_schedule;
 
@@ -464,6 +554,132 @@ int set_nbio(int fd)
 }
 
 
+/*
+ * Processes on the same host that set LIBPROCESS_SOCKET_DIR also
+ * listen on a Unix domain socket at 'socket_dir/port' (where port is
+ * their TCP port, which is unique on a host), so a peer can find the
+ * socket from just the PID.
+ */
+bool unix_address(uint16_t port, struct sockaddr_un *addr)
+{
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  int length = snprintf(addr->sun_path, sizeof(addr->sun_path),
+                        "%s/%hu", socket_dir, port);
+  return length > 0 && length < (int) sizeof(addr->sun_path);
+}
+
+
+/*
+ * Returns a connected, non-blocking Unix domain socket for the node
+ * or -1 if the node is not on this host or is not listening on one
+ * (in which case the caller should fall back to TCP).
+ */
+int unix_connect(const node &n)
+{
+  if (socket_dir == NULL || n.ip != ip)
+    return -1;
+
+  struct sockaddr_un addr;
+  if (!unix_address(n.port, &addr))
+    return -1;
+
+  int s;
+  if ((s = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+    return -1;
+
+  if (set_nbio(s) < 0) {
+    close(s);
+    return -1;
+  }
+
+  /* Connecting a Unix domain socket either succeeds or fails now. */
+  if (connect(s, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+    close(s);
+    return -1;
+  }
+
+  return s;
+}
+
+
+void unix_cleanup()
+{
+  struct sockaddr_un addr;
+  if (getpid() == us_owner && unix_address(port, &addr))
+    unlink(addr.sun_path);
+}
+
+
+/* Records the current CPU, counting a migration if it changed. */
+void sample_cpu(int *last, volatile uint64_t *migrations)
+{
+#ifdef __linux__
+  int cpu = sched_getcpu();
+  if (cpu >= 0) {
+    if (*last >= 0 && cpu != *last)
+      (*migrations)++;
+    *last = cpu;
+  }
+#endif /* __linux__ */
+}
+
+
+/*
+ * Pins the thread to the CPUs listed (like "0-3,8") in the specified
+ * environment variable, if it is set.
+ */
+void set_affinity(pthread_t thread, const char *variable)
+{
+  const char *value = getenv(variable);
+  if (value == NULL || value[0] == '\0')
+    return;
+
+#ifdef __linux__
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+
+  const char *s = value;
+  while (*s != '\0') {
+    char *end;
+    long first = strtol(s, &end, 10);
+    long last = first;
+    if (end == s || first < 0)
+      fatal("%s=%s is not a valid list of CPUs", variable, value);
+    if (*end == '-') {
+      s = end + 1;
+      last = strtol(s, &end, 10);
+      if (end == s || last < first)
+        fatal("%s=%s is not a valid list of CPUs", variable, value);
+    }
+    if (last >= CPU_SETSIZE)
+      fatal("%s=%s is not a valid list of CPUs", variable, value);
+    for (long cpu = first; cpu <= last; cpu++)
+      CPU_SET(cpu, &cpus);
+    if (*end == ',')
+      end++;
+    else if (*end != '\0')
+      fatal("%s=%s is not a valid list of CPUs", variable, value);
+    s = end;
+  }
+
+  int result = pthread_setaffinity_np(thread, sizeof(cpus), &cpus);
+  if (result != 0)
+    fatal("failed to set affinity for %s=%s: %s",
+          variable, value, strerror(result));
+#else
+  cerr << "libprocess: ignoring " << variable
+       << " (thread affinity is not supported on this platform)" << endl;
+#endif /* __linux__ */
+}
+
+
+void handle_check(struct ev_loop *loop, ev_check *w, int revents)
+{
+  sample_cpu(&io_cpu, &io_migrations);
+}
+
+
 void handle_async(struct ev_loop *loop, ev_async *w, int revents)
 {
   synchronized(io_watchersq) {
@@ -582,13 +798,32 @@ void handle_await(struct ev_loop *loop, ev_io *w, int revents)
 /* Socket reading .... */
 void read_data(struct ev_loop *loop, ev_io *w, int revents);
 void read_msg(struct ev_loop *loop, ev_io *w, int revents);
+void read_http(struct ev_loop *loop, ev_io *w, int revents);
 
 struct read_ctx {
   int len;
   struct msg *msg;
+  bool sniff; /* Check if the first message is an HTTP request? */
 };
 
 
+/*
+ * Returns true if data starts like an HTTP request. A message from
+ * another process can't: its first 4 bytes are the pipe of the sender,
+ * and pipes are handed out sequentially from 0.
+ */
+bool http_request(const char *data, int len)
+{
+  return len >= 4 &&
+    (memcmp(data, "GET ", 4) == 0 ||
+     memcmp(data, "HEAD", 4) == 0 ||
+     memcmp(data, "POST", 4) == 0 ||
+     memcmp(data, "PUT ", 4) == 0 ||
+     memcmp(data, "DELE", 4) == 0 ||
+     memcmp(data, "OPTI", 4) == 0);
+}
+
+
 void read_data(struct ev_loop *loop, ev_io *w, int revents)
 {
   int c = w->fd;
@@ -673,6 +908,27 @@ void read_msg(struct ev_loop *loop, ev_io *w, int revents)
     fatalerror("unhandled socket error: please report (read_msg)");
   }
 
+  if (ctx->sniff && ctx->len >= 4) {
+    ctx->sniff = false;
+    if (http_request((char *) ctx->msg, ctx->len)) {
+      /* Hand the connection (and what we read so far) to HTTP. */
+      http_manager->accepted(c);
+      bool reading = http_manager->received(c, (char *) ctx->msg, ctx->len);
+      free(ctx->msg);
+      free(ctx);
+      ev_io_stop (loop, w);
+      if (reading) {
+        w->data = NULL;
+        ev_io_init (w, read_http, c, EV_READ);
+        ev_io_start (loop, w);
+      } else {
+        free(w);
+        http_manager->stopped(c);
+      }
+      return;
+    }
+  }
+
   if (ctx->len == sizeof(struct msg)) {
     /* Check and see if we need to receive data. */
     if (ctx->msg->len > 0) {
@@ -704,6 +960,37 @@ void read_msg(struct ev_loop *loop, ev_io *w, int revents)
 }
 
 
+void read_http(struct ev_loop *loop, ev_io *w, int revents)
+{
+  int c = w->fd;
+
+  char data[4096];
+
+  int len = recv(c, data, sizeof(data), 0);
+
+  if (len > 0) {
+    if (!http_manager->received(c, data, len)) {
+      /* Not reading any more requests (e.g. "Connection: close"). */
+      ev_io_stop (loop, w);
+      free(w);
+      http_manager->stopped(c);
+    }
+  } else if (len < 0 && errno == EWOULDBLOCK) {
+    return;
+  } else if (len == 0 || (len < 0 &&
+			  (errno == ECONNRESET ||
+			   errno == EBADF ||
+			   errno == EHOSTUNREACH))) {
+    /* Peer is done sending (the connection closes once answered). */
+    ev_io_stop (loop, w);
+    free(w);
+    http_manager->stopped(c);
+  } else {
+    fatalerror("unhandled socket error: please report (read_http)");
+  }
+}
+
+
 /* Socket writing .... */
 void write_data(struct ev_loop *loop, ev_io *w, int revents);
 void write_msg(struct ev_loop *loop, ev_io *w, int revents);
@@ -837,6 +1124,21 @@ void write_msg(struct ev_loop *loop, ev_io *w, int revents)
 }
 
 
+void write_http(struct ev_loop *loop, ev_io *w, int revents)
+{
+  int c = w->fd;
+
+  if (!http_manager->write(c)) {
+    /* Stop before the socket might get closed. */
+    ev_io_stop(loop, w);
+    if (http_manager->written(c))
+      ev_io_start(loop, w);
+    else
+      free(w);
+  }
+}
+
+
 void write_connect(struct ev_loop *loop, ev_io *w, int revents)
 {
   int s = w->fd;
@@ -903,6 +1205,7 @@ void link_connect(struct ev_loop *loop, ev_io *w, int revents)
 
   ctx->len = 0;
   ctx->msg = (struct msg *) malloc(sizeof(struct msg));
+  ctx->sniff = false;
 
   /* Initialize watcher for reading. */
   ev_io_init(w, read_msg, s, EV_READ);
@@ -915,7 +1218,7 @@ void do_accept(struct ev_loop *loop, ev_io *w, int revents)
 {
   int s = w->fd;
 
-  struct sockaddr_in addr;
+  struct sockaddr_storage addr;
 
   socklen_t addrlen = sizeof(addr);
 
@@ -934,7 +1237,8 @@ void do_accept(struct ev_loop *loop, ev_io *w, int revents)
 
   /* Turn off Nagle (on TCP_NODELAY) so pipelined requests don't wait. */
   int on = 1;
-  if (setsockopt(c, SOL_TCP, TCP_NODELAY, &on, sizeof(on)) < 0) {
+  if (addr.ss_family == AF_INET &&
+      setsockopt(c, SOL_TCP, TCP_NODELAY, &on, sizeof(on)) < 0) {
     close(c);
     return;
   }
@@ -949,6 +1253,7 @@ void do_accept(struct ev_loop *loop, ev_io *w, int revents)
 
   ctx->len = 0;
   ctx->msg = (struct msg *) malloc(sizeof(struct msg));
+  ctx->sniff = true;
 
   /* Initialize watcher for reading. */
   ev_io_init(io_watcher, read_msg, c, EV_READ);
@@ -1073,6 +1378,8 @@ void * schedule(void *arg)
       }
     }
 
+    sample_cpu(&proc_cpu, &proc_migrations);
+
     process->lock();
     {
       assert(process->state == Process::INIT ||
@@ -1174,11 +1481,14 @@ void initialize()
   /* Create a new ProcessManager and LinkManager. */
   process_manager = new ProcessManager();
   link_manager = new LinkManager();
+  http_manager = new HttpManager();
 
   /* Setup processing thread. */
   if (pthread_create (&proc_thread, NULL, schedule, NULL) != 0)
     fatalerror("failed to initialize (pthread_create)");
 
+  set_affinity(proc_thread, "LIBPROCESS_PROC_CPUS");
+
   ip = 0;
   port = 0;
 
@@ -1205,6 +1515,12 @@ void initialize()
     port = result;
   }
 
+  /* Check environment for a Unix domain socket directory. */
+  value = getenv("LIBPROCESS_SOCKET_DIR");
+  if (value != NULL && value[0] != '\0') {
+    socket_dir = strdup(value);
+  }
+
   /* Check environment for replay. */
   value = getenv("LIBPROCESS_REPLAY");
   replaying = value != NULL;
@@ -1299,6 +1615,32 @@ void initialize()
   if (listen(s, 500000) < 0)
     fatalerror("failed to initialize (listen)");
 
+  /* Create a Unix domain "server" socket for nodes on this host. */
+  if (socket_dir != NULL) {
+    struct sockaddr_un addr;
+    if (!unix_address(port, &addr))
+      fatal("LIBPROCESS_SOCKET_DIR=%s is too long", socket_dir);
+
+    if ((us = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+      fatalerror("failed to initialize (socket)");
+
+    if (set_nbio(us) < 0)
+      fatalerror("failed to initialize (set_nbio)");
+
+    /* Any existing socket was left behind by a process that is no
+       longer bound to our port, so it is safe to remove. */
+    unlink(addr.sun_path);
+
+    if (bind(us, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+      fatalerror("failed to initialize (bind)");
+
+    if (listen(us, 500000) < 0)
+      fatalerror("failed to initialize (listen)");
+
+    us_owner = getpid();
+    atexit(unix_cleanup);
+  }
+
   /* Setup event loop. */
 #ifdef __sun__
   loop = ev_default_loop(EVBACKEND_POLL | EVBACKEND_SELECT);
@@ -1315,6 +1657,11 @@ void initialize()
   ev_io_init(&server_watcher, do_accept, s, EV_READ);
   ev_io_start(loop, &server_watcher);
 
+  if (us != -1) {
+    ev_io_init(&unix_server_watcher, do_accept, us, EV_READ);
+    ev_io_start(loop, &unix_server_watcher);
+  }
+
 //   ev_child_init(&child_watcher, child_exited, pid, 0);
 //   ev_child_start(loop, &cw);
 
@@ -1330,9 +1677,14 @@ void initialize()
 //   sigaddset (&sa.sa_mask, w->signum);
 //   sigprocmask (SIG_UNBLOCK, &sa.sa_mask, 0);
 
+  ev_check_init(&io_check_watcher, handle_check);
+  ev_check_start(loop, &io_check_watcher);
+
   if (pthread_create(&io_thread, NULL, serve, loop) != 0)
     fatalerror("failed to initialize node (pthread_create)");
 
+  set_affinity(io_thread, "LIBPROCESS_IO_CPUS");
+
   initializing = false;
 }
 
@@ -1364,15 +1716,19 @@ void LinkManager::link(Process *process, const PID &to)
     // Check if node is remote and there isn't a persistant link.
     if ((n.ip != ip || n.port != port) &&
         persists.find(n) == persists.end()) {
-      int s;
-
-      /* Create socket for communicating with remote process. */
-      if ((s = socket(AF_INET, SOCK_STREAM, IPPROTO_IP)) < 0)
-        fatalerror("failed to link (socket)");
+      /* Prefer a Unix domain socket if the node is on this host. */
+      int s = unix_connect(n);
+      bool connected = s >= 0;
+
+      if (!connected) {
+        /* Create socket for communicating with remote process. */
+        if ((s = socket(AF_INET, SOCK_STREAM, IPPROTO_IP)) < 0)
+          fatalerror("failed to link (socket)");
     
-      /* Use non-blocking sockets. */
-      if (set_nbio(s) < 0)
-        fatalerror("failed to link (set_nbio)");
+        /* Use non-blocking sockets. */
+        if (set_nbio(s) < 0)
+          fatalerror("failed to link (set_nbio)");
+      }
 
       /* Record socket. */
       sockets[s] = n;
@@ -1383,18 +1739,24 @@ void LinkManager::link(Process *process, const PID &to)
       /* Allocate the watcher. */
       ev_io *io_watcher = (ev_io *) malloc(sizeof(ev_io));
 
-      struct sockaddr_in addr;
+      if (!connected) {
+        struct sockaddr_in addr;
       
-      memset(&addr, 0, sizeof(addr));
+        memset(&addr, 0, sizeof(addr));
       
-      addr.sin_family = PF_INET;
-      addr.sin_port = htons(to.port);
-      addr.sin_addr.s_addr = to.ip;
+        addr.sin_family = PF_INET;
+        addr.sin_port = htons(to.port);
+        addr.sin_addr.s_addr = to.ip;
 
-      if (connect(s, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
-        if (errno != EINPROGRESS)
-          fatalerror("failed to link (connect)");
+        if (connect(s, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+          if (errno != EINPROGRESS)
+            fatalerror("failed to link (connect)");
+        } else {
+          connected = true;
+        }
+      }
 
+      if (!connected) {
         /* Initialize watcher for connecting. */
         ev_io_init(io_watcher, link_connect, s, EV_WRITE);
       } else {
@@ -1406,6 +1768,7 @@ void LinkManager::link(Process *process, const PID &to)
 
         ctx->len = 0;
         ctx->msg = (struct msg *) malloc(sizeof(struct msg));
+        ctx->sniff = false;
 
         ev_io_init(io_watcher, read_msg, s, EV_READ);
       }
@@ -1468,15 +1831,19 @@ void LinkManager::send(struct msg *msg)
         outgoing[s].push(msg);
       }
     } else {
-      int s;
-
-      /* Create socket for communicating with remote process. */
-      if ((s = socket(AF_INET, SOCK_STREAM, IPPROTO_IP)) < 0)
-        fatalerror("failed to send (socket)");
+      /* Prefer a Unix domain socket if the node is on this host. */
+      int s = unix_connect(n);
+      bool connected = s >= 0;
+
+      if (!connected) {
+        /* Create socket for communicating with remote process. */
+        if ((s = socket(AF_INET, SOCK_STREAM, IPPROTO_IP)) < 0)
+          fatalerror("failed to send (socket)");
     
-      /* Use non-blocking sockets. */
-      if (set_nbio(s) < 0)
-        fatalerror("failed to send (set_nbio)");
+        /* Use non-blocking sockets. */
+        if (set_nbio(s) < 0)
+          fatalerror("failed to send (set_nbio)");
+      }
 
       /* Record socket. */
       sockets[s] = n;
@@ -1499,18 +1866,24 @@ void LinkManager::send(struct msg *msg)
       ctx->msg = msg;
       ctx->close = true;
 
-      struct sockaddr_in addr;
+      if (!connected) {
+        struct sockaddr_in addr;
 
-      memset(&addr, 0, sizeof(addr));
+        memset(&addr, 0, sizeof(addr));
       
-      addr.sin_family = PF_INET;
-      addr.sin_port = htons(msg->to.port);
-      addr.sin_addr.s_addr = msg->to.ip;
+        addr.sin_family = PF_INET;
+        addr.sin_port = htons(msg->to.port);
+        addr.sin_addr.s_addr = msg->to.ip;
     
-      if (connect(s, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
-        if (errno != EINPROGRESS)
-          fatalerror("failed to send (connect)");
+        if (connect(s, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+          if (errno != EINPROGRESS)
+            fatalerror("failed to send (connect)");
+        } else {
+          connected = true;
+        }
+      }
 
+      if (!connected) {
         /* Initialize watcher for connecting. */
         ev_io_init(io_watcher, write_connect, s, EV_WRITE);
       } else {
@@ -1677,6 +2050,295 @@ void LinkManager::exited(Process *process)
 }
 
 
+HttpManager::HttpManager() : next_request(0)
+{
+  synchronizer(this) = SYNCHRONIZED_INITIALIZER_RECURSIVE;
+}
+
+
+HttpManager::~HttpManager() {}
+
+
+void HttpManager::route(const string &path, const PID &pid)
+{
+  synchronized(this) {
+    routes[path] = pid;
+  }
+}
+
+
+void HttpManager::accepted(int s)
+{
+  synchronized(this) {
+    connection &conn = connections[s];
+    conn.written = 0;
+    conn.requests = 0;
+    conn.answered = 0;
+    conn.reading = true;
+    conn.writing = false;
+    conn.closing = false;
+    conn.broken = false;
+  }
+}
+
+
+bool HttpManager::received(int s, const char *data, size_t length)
+{
+  /* Largest request head we buffer before giving up on the peer. */
+  static const size_t MAX_HEAD = 64 * Kilobyte;
+
+  /* Largest request body we buffer (larger ones get a 413). */
+  static const size_t MAX_BODY = 64 * Kilobyte;
+
+  synchronized(this) {
+    assert(connections.count(s) > 0);
+    connection &conn = connections[s];
+
+    conn.in.append(data, length);
+
+    /* Parse every complete request (clients may pipeline them). */
+    while (!conn.closing) {
+      size_t end = conn.in.find("\r\n\r\n");
+      if (end == string::npos) {
+        if (conn.in.size() > MAX_HEAD)
+          conn.closing = true;
+        break;
+      }
+
+      std::istringstream head(conn.in.substr(0, end));
+
+      string method, uri, version;
+      head >> method >> uri >> version;
+
+      size_t body = 0;
+      string connection;
+
+      string line;
+      std::getline(head, line);
+      while (std::getline(head, line)) {
+        size_t colon = line.find(':');
+        if (colon == string::npos)
+          continue;
+        string name = line.substr(0, colon);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        size_t start = line.find_first_not_of(" \t", colon + 1);
+        string value = start == string::npos
+          ? "" : line.substr(start, line.find_last_not_of(" \t\r") + 1 - start);
+        std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+        if (name == "content-length")
+          body = strtoul(value.c_str(), NULL, 10);
+        else if (name == "connection")
+          connection = value;
+      }
+
+      /* Wait for the body (which no one looks at, yet), unless it's
+         too large, in which case we answer and close without it. */
+      bool too_large = body > MAX_BODY;
+      if (!too_large && conn.in.size() < end + 4 + body)
+        break;
+
+      conn.in.erase(0, too_large ? conn.in.size() : end + 4 + body);
+
+      request &req = requests[next_request];
+      req.s = s;
+      req.seq = conn.requests++;
+      req.head = method == "HEAD";
+      req.close = version == "HTTP/1.1"
+        ? connection == "close"
+        : connection != "keep-alive";
+
+      /* Don't read past a request after which we close. */
+      if (req.close)
+        conn.closing = true;
+
+      uint64_t id = next_request++;
+
+      if (too_large) {
+        conn.closing = true;
+        req.close = true;
+        respond(id, "413 Request Entity Too Large", "text/plain", "");
+      } else if (uri.empty() || uri[0] != '/' ||
+                 version.find("HTTP/") != 0) {
+        conn.closing = true;
+        req.close = true;
+        respond(id, "400 Bad Request", "text/plain", "");
+      } else {
+        dispatch(id, method, uri);
+      }
+    }
+
+    return !conn.closing;
+  }
+
+  return false;
+}
+
+
+void HttpManager::stopped(int s)
+{
+  synchronized(this) {
+    assert(connections.count(s) > 0);
+    connections[s].reading = false;
+    maybe_close(s);
+  }
+}
+
+
+bool HttpManager::write(int s)
+{
+  synchronized(this) {
+    assert(connections.count(s) > 0);
+    connection &conn = connections[s];
+
+    assert(conn.writing);
+
+    int len = send(s, conn.out.data() + conn.written,
+                   conn.out.size() - conn.written, MSG_NOSIGNAL);
+
+    if (len > 0) {
+      conn.written += len;
+    } else if (len < 0 && errno == EWOULDBLOCK) {
+      return true;
+    } else {
+      /* Socket has closed (drop anything else we'd write). */
+      conn.broken = true;
+      conn.written = conn.out.size();
+    }
+
+    return conn.written < conn.out.size();
+  }
+
+  return false;
+}
+
+
+bool HttpManager::written(int s)
+{
+  synchronized(this) {
+    assert(connections.count(s) > 0);
+    connection &conn = connections[s];
+
+    /* Keep writing if more responses came in meanwhile. */
+    if (conn.written < conn.out.size())
+      return true;
+
+    conn.out.clear();
+    conn.written = 0;
+    conn.writing = false;
+    maybe_close(s);
+  }
+
+  return false;
+}
+
+
+void HttpManager::respond(uint64_t id, const string &status,
+                          const string &type, const string &body)
+{
+  synchronized(this) {
+    map<uint64_t, request>::iterator it = requests.find(id);
+    if (it == requests.end())
+      return;
+
+    const request &req = it->second;
+    int s = req.s;
+    connection &conn = connections[s];
+
+    std::ostringstream out;
+    out << "HTTP/1.1 " << status << "\r\n"
+        << "Content-Type: " << type << "\r\n"
+        << "Content-Length: " << body.size() << "\r\n"
+        << (req.close ? "Connection: close\r\n" : "")
+        << "\r\n";
+    if (!req.head)
+      out << body;
+
+    conn.early[req.seq] = out.str();
+    requests.erase(it);
+
+    /* Queue up every response that is next in line. */
+    map<uint64_t, string>::iterator next;
+    while ((next = conn.early.find(conn.answered)) != conn.early.end()) {
+      if (!conn.broken)
+        conn.out += next->second;
+      conn.early.erase(next);
+      conn.answered++;
+    }
+
+    if (!conn.out.empty() && !conn.writing) {
+      conn.writing = true;
+
+      ev_io *io_watcher = (ev_io *) malloc(sizeof(ev_io));
+      io_watcher->data = NULL;
+      ev_io_init(io_watcher, write_http, s, EV_WRITE);
+
+      /* Enqueue the watcher. */
+      synchronized(io_watchersq) {
+        io_watchersq->push(io_watcher);
+      }
+
+      /* Interrupt the loop. */
+      ev_async_send(loop, &async_watcher);
+    } else {
+      maybe_close(s);
+    }
+  }
+}
+
+
+void HttpManager::dispatch(uint64_t id, const string &method,
+                           const string &uri)
+{
+  string path = uri.substr(0, uri.find('?'));
+
+  /* Find the longest routed prefix of the path, down to "/". */
+  map<string, PID>::iterator it;
+  string prefix = path;
+  while ((it = routes.find(prefix)) == routes.end() && prefix.size() > 1) {
+    size_t slash = prefix.rfind('/');
+    if (slash == string::npos)
+      break;
+    prefix = prefix.substr(0, slash > 0 ? slash : 1);
+  }
+
+  if (it != routes.end()) {
+    const PID &to = it->second;
+    const string &data = method + " " + uri;
+
+    struct msg *msg =
+      (struct msg *) malloc(sizeof(struct msg) + sizeof(id) + data.size());
+
+    msg->from.pipe = 0;
+    msg->from.ip = 0;
+    msg->from.port = 0;
+    msg->to.pipe = to.pipe;
+    msg->to.ip = to.ip;
+    msg->to.port = to.port;
+    msg->id = PROCESS_HTTP;
+    msg->len = sizeof(id) + data.size();
+
+    memcpy((char *) msg + sizeof(struct msg), &id, sizeof(id));
+    memcpy((char *) msg + sizeof(struct msg) + sizeof(id),
+           data.data(), data.size());
+
+    if (process_manager->deliver(msg))
+      return;
+  }
+
+  respond(id, "404 Not Found", "text/plain", "");
+}
+
+
+void HttpManager::maybe_close(int s)
+{
+  connection &conn = connections[s];
+  if (!conn.reading && !conn.writing && conn.answered == conn.requests) {
+    connections.erase(s);
+    close(s);
+  }
+}
+
+
 ProcessManager::ProcessManager()
 {
   synchronizer(processes) = SYNCHRONIZED_INITIALIZER;
@@ -1760,7 +2422,7 @@ void ProcessManager::replay()
 }
 
 
-void ProcessManager::deliver(struct msg *msg, Process *sender)
+bool ProcessManager::deliver(struct msg *msg, Process *sender)
 {
   assert(msg != NULL);
   assert(!replaying);
@@ -1782,8 +2444,10 @@ void ProcessManager::deliver(struct msg *msg, Process *sender)
     }
 
     receiver->enqueue(msg);
+    return true;
   } else {
     free(msg);
+    return false;
   }
 }
 
@@ -2222,6 +2886,9 @@ void ProcessManager::cleanup(Process *process)
   /* Possible gate non-libprocess threads are waiting at. */
   Gate *gate = NULL;
 
+  /* HTTP requests the process never got to. */
+  list<uint64_t> unanswered;
+
   /* Stop new process references from being created. */
   process->state = Process::EXITING;
 
@@ -2241,10 +2908,13 @@ void ProcessManager::cleanup(Process *process)
 
     process->lock();
     {
-      /* Free any pending messages. */
+      /* Free any pending messages (answering HTTP requests). */
       while (!process->msgs.empty()) {
         struct msg *msg = process->msgs.front();
         process->msgs.pop_front();
+        if (msg->id == PROCESS_HTTP)
+          unanswered.push_back(
+              HttpRequest((char *) msg + sizeof(struct msg), msg->len).id);
         free(msg);
       }
 
@@ -2280,6 +2950,10 @@ void ProcessManager::cleanup(Process *process)
   /* Inform link manager. */
   link_manager->exited(process);
 
+  /* Answer HTTP requests (outside the locks, see HttpManager::dispatch). */
+  foreach (uint64_t id, unanswered)
+    http_manager->respond(id, "503 Service Unavailable", "text/plain", "");
+
   /* Confirm process not in runq. */
   synchronized(runq) {
     assert(find(runq.begin(), runq.end(), process) == runq.end());
@@ -2375,6 +3049,18 @@ void ProcessManager::cancel_timeout(const timeout &timeout)
 }
 
 
+uint64_t ProcessStats::procMigrations()
+{
+  return proc_migrations;
+}
+
+
+uint64_t ProcessStats::ioMigrations()
+{
+  return io_migrations;
+}
+
+
 void ProcessClock::pause()
 {
   initialize();
@@ -2913,3 +3599,38 @@ void Process::filter(MessageFilter *filter)
     filterer = filter;
   }
 }
+
+
+void Process::route(const string &path, const PID &pid)
+{
+  initialize();
+  http_manager->route(path, pid);
+}
+
+
+void Process::respond(uint64_t request, const string &status,
+                      const string &type, const string &body)
+{
+  initialize();
+  http_manager->respond(request, status, type, body);
+}
+
+
+HttpRequest::HttpRequest(const char *data, size_t length) : id(0)
+{
+  if (length < sizeof(id))
+    return;
+
+  memcpy(&id, data, sizeof(id));
+
+  const string request(data + sizeof(id), length - sizeof(id));
+  size_t space = request.find(' ');
+  method = request.substr(0, space);
+  if (space != string::npos) {
+    const string uri = request.substr(space + 1);
+    size_t question = uri.find('?');
+    path = uri.substr(0, question);
+    if (question != string::npos)
+      query = uri.substr(question + 1);
+  }
+}
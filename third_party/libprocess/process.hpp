@@ -8,6 +8,7 @@
 #include <sys/time.h>
 
 #include <queue>
+#include <string>
 
 #include <tr1/functional>
 
@@ -20,7 +21,8 @@ typedef uint16_t MSGID;
 const MSGID PROCESS_ERROR = 0;
 const MSGID PROCESS_TIMEOUT = 1;
 const MSGID PROCESS_EXIT = 2;
-const MSGID PROCESS_MSGID = PROCESS_EXIT+1;
+const MSGID PROCESS_HTTP = 3;
+const MSGID PROCESS_MSGID = PROCESS_HTTP+1;
 
 
 struct msg
@@ -40,6 +42,39 @@ public:
 };
 
 
+/*
+ * Statistics about the libprocess threads. Set LIBPROCESS_PROC_CPUS
+ * and LIBPROCESS_IO_CPUS (e.g. "0-3,8") to pin the processing and I/O
+ * threads, and use these to see how often the threads still migrate.
+ */
+class ProcessStats {
+public:
+  /* Times the processing thread was seen on a different CPU. */
+  static uint64_t procMigrations();
+
+  /* Times the I/O thread was seen on a different CPU. */
+  static uint64_t ioMigrations();
+};
+
+
+/*
+ * An HTTP request received on the libprocess port. Requests for a
+ * routed path (see Process::route) are delivered to the process as
+ * PROCESS_HTTP messages; construct one of these from the body of the
+ * message and answer it with Process::respond (from any thread, in any
+ * order; responses on a connection still go out in request order).
+ */
+struct HttpRequest
+{
+  HttpRequest(const char *data, size_t length);
+
+  uint64_t id;
+  std::string method;
+  std::string path;
+  std::string query;
+};
+
+
 class MessageFilter {
 public:
   virtual bool filter(struct msg *) = 0;
@@ -69,6 +104,13 @@ public:
   /* Filter messages to be enqueued (except for timeout messages). */
   static void filter(MessageFilter *);
 
+  /* Deliver HTTP requests for path (or anything below it) to PID. */
+  static void route(const std::string &path, const PID &pid);
+
+  /* Answers an HTTP request with status (e.g. "200 OK") and body. */
+  static void respond(uint64_t request, const std::string &status,
+                      const std::string &type, const std::string &body);
+
 protected:
   Process();
   virtual ~Process();
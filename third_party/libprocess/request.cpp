@@ -0,0 +1,101 @@
+#include <pthread.h>
+
+#include "request.hpp"
+
+using std::string;
+
+
+namespace {
+
+/* Message id used to hand finished requesters to the collector. */
+const MSGID REQUEST_DONE = PROCESS_MSGID;
+
+
+/* Process that deletes finished requesters. */
+PID collector;
+
+pthread_once_t collector_once = PTHREAD_ONCE_INIT;
+
+
+/* Sends a single request and waits for a single response. */
+class Requester : public Process
+{
+public:
+  Requester(const PID &_to, MSGID _id, const char *data, size_t length,
+            double _secs)
+    : to(_to), id(_id), secs(_secs)
+  {
+    if (length > 0)
+      this->data.assign(data, length);
+  }
+
+  Future<Response> future() const { return promise.future(); }
+
+protected:
+  void operator () ()
+  {
+    send(to, id, data.data(), data.size());
+
+    Response response;
+    response.id = receive(secs);
+    response.from = from();
+
+    size_t length;
+    const char *s = body(&length);
+    if (length > 0)
+      response.body.assign(s, length);
+
+    promise.set(response);
+
+    Requester *self = this;
+    send(collector, REQUEST_DONE, (char *) &self, sizeof(self));
+  }
+
+private:
+  const PID to;
+  const MSGID id;
+  string data;
+  const double secs;
+  Promise<Response> promise;
+};
+
+
+/*
+ * Deletes finished requesters (they can't delete themselves since
+ * they are still running when they finish).
+ */
+class RequestCollector : public Process
+{
+protected:
+  void operator () ()
+  {
+    while (true) {
+      if (receive() == REQUEST_DONE) {
+        Requester *requester =
+          *reinterpret_cast<Requester * const *>(body(NULL));
+        wait(requester->self());
+        delete requester;
+      }
+    }
+  }
+};
+
+
+void spawn_collector()
+{
+  collector = Process::spawn(new RequestCollector());
+}
+
+} /* namespace { */
+
+
+Future<Response> request(const PID &to, MSGID id, const char *data,
+                         size_t length, double secs)
+{
+  pthread_once(&collector_once, spawn_collector);
+
+  Requester *requester = new Requester(to, id, data, length, secs);
+  Future<Response> future = requester->future();
+  Process::spawn(requester);
+  return future;
+}
@@ -0,0 +1,47 @@
+#ifndef __REQUEST_HPP__
+#define __REQUEST_HPP__
+
+#include <string>
+
+#include <process.hpp>
+
+#include "future.hpp"
+
+
+/* A reply to a request (id is PROCESS_TIMEOUT if none arrived in time). */
+struct Response
+{
+  Response() : id(PROCESS_ERROR) {}
+
+  MSGID id;
+  PID from;
+  std::string body;
+};
+
+
+/**
+ * Sends a message to PID and returns a future for the first message
+ * sent back, without blocking the caller. Each request is sent from
+ * its own (short lived) process, whose PID serves as the correlation
+ * id, so any number of requests can be outstanding at once and other
+ * messages to the caller are unaffected. Because of this, requests
+ * are only appropriate for protocols where the receiver replies to
+ * 'from()' and doesn't otherwise care who the sender is.
+ * @param to destination
+ * @param id message id
+ * @param data payload
+ * @param length payload length
+ * @param secs seconds to wait for a reply (0 waits indefinitely)
+ * @return future response
+ */
+Future<Response> request(const PID &to, MSGID id, const char *data,
+                         size_t length, double secs = 0);
+
+
+inline Future<Response> request(const PID &to, MSGID id, double secs = 0)
+{
+  return request(to, id, NULL, 0, secs);
+}
+
+
+#endif /* __REQUEST_HPP__ */